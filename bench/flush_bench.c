@@ -0,0 +1,335 @@
+/*
+ * Route monitor - flushed route scan benchmark
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/netlink.h>
+#include <netlink/cache.h>
+#include <netlink/route/route.h>
+#include <netlink/route/nexthop.h>
+#include <linux/perf_event.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flush.h"
+
+/*
+ * Fills a route cache with 10k to 2M IPv4 routes with one nexthop each and
+ * times flush_scan() for an interface that a given fraction of the routes
+ * go through, the walk rmon does for every link that goes down. Reports
+ * ns and cache misses per route in the cache, and the allocations the
+ * cache took per route. Results also go to a JSON Lines file, one object
+ * per size and fraction, to compare commits.
+ *
+ * Filling the cache grows with the square of its size, libnl's route hash
+ * table doesn't grow: a million routes take minutes, as they do in rmon.
+ */
+#define RUNS        5
+#define IFINDEX     2
+
+static const unsigned long default_sizes[] = { 10000, 100000, 1000000, 2000000 };
+static const double fractions[] = { 0.001, 0.01, 0.1, 0.5, 1.0 };
+
+/* Every malloc(), calloc() and realloc(), libnl's included */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+static unsigned long allocs;
+static unsigned long alloc_bytes;
+
+void *malloc(size_t size)
+{
+    allocs++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    allocs++;
+    alloc_bytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+    allocs++;
+    alloc_bytes += size;
+    return __libc_realloc(p, size);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* Cache misses of this thread in user space, -1 where perf isn't allowed */
+static int perf_open(void)
+{
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_CACHE_MISSES,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t perf_read(int fd)
+{
+    uint64_t v = 0;
+
+    if (fd >= 0 && read(fd, &v, sizeof(v)) != sizeof(v))
+        v = 0;
+    return v;
+}
+
+static struct nl_cache *build(unsigned long n, struct rtnl_nexthop **nhs)
+{
+    struct nl_addr *dst, *gw;
+    struct rtnl_route *route;
+    struct nl_cache *cache;
+    uint32_t a;
+    unsigned long i;
+
+    if (nl_cache_alloc_name("route/route", &cache) < 0)
+        return NULL;
+
+    a = htonl(0x64400002);
+    gw = nl_addr_build(AF_INET, &a, sizeof(a));
+    for (i = 0; i < n; i++) {
+        route = rtnl_route_alloc();
+        a = htonl(0x0a000000 + i);
+        dst = nl_addr_build(AF_INET, &a, sizeof(a));
+        nhs[i] = rtnl_route_nh_alloc();
+        if (!route || !dst || !gw || !nhs[i]) {
+            fprintf(stderr, "Unable to build %lu routes\n", n);
+            exit(EXIT_FAILURE);
+        }
+        rtnl_route_set_family(route, AF_INET);
+        rtnl_route_set_table(route, RT_TABLE_MAIN);
+        rtnl_route_set_type(route, RTN_UNICAST);
+        rtnl_route_set_protocol(route, RTPROT_BGP);
+        rtnl_route_set_dst(route, dst);
+        rtnl_route_nh_set_gateway(nhs[i], gw);
+        rtnl_route_add_nexthop(route, nhs[i]);
+        nl_cache_add(cache, (struct nl_object *)route);
+        rtnl_route_put(route);
+        nl_addr_put(dst);
+    }
+    nl_addr_put(gw);
+    return cache;
+}
+
+/* Scattered, so that the matches aren't predictable */
+static void spread(struct rtnl_nexthop **nhs, unsigned long n, double fraction)
+{
+    unsigned long i;
+
+    for (i = 0; i < n; i++)
+        rtnl_route_nh_set_ifindex(nhs[i], mix(i) % 1000000 < fraction * 1000000 ?
+                                  IFINDEX : IFINDEX + 1 + i % 15);
+}
+
+static void count(struct rtnl_route *route, void *arg)
+{
+    (*(unsigned long *)arg)++;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void run(unsigned long n, FILE *out, const char *rev, int perf_fd)
+{
+    struct rtnl_nexthop **nhs;
+    unsigned long matched, a0, b0, build_allocs, build_bytes, scan_allocs;
+    double t, build_s, ns[RUNS];
+    uint64_t misses, m0;
+    struct nl_cache *cache;
+    size_t f;
+    int r;
+
+    nhs = malloc(n * sizeof(*nhs));
+    if (!nhs) {
+        fprintf(stderr, "Unable to build %lu routes\n", n);
+        exit(EXIT_FAILURE);
+    }
+    a0 = allocs;
+    b0 = alloc_bytes;
+    t = now();
+    cache = build(n, nhs);
+    build_s = now() - t;
+    build_allocs = allocs - a0;
+    build_bytes = alloc_bytes - b0;
+    if (!cache) {
+        fprintf(stderr, "Unable to allocate the route cache\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (f = 0; f < sizeof(fractions) / sizeof(fractions[0]); f++) {
+        spread(nhs, n, fractions[f]);
+        misses = UINT64_MAX;
+        a0 = allocs;
+        for (r = 0; r < RUNS; r++) {
+            matched = 0;
+            if (perf_fd >= 0) {
+                ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+            m0 = perf_read(perf_fd);
+            t = now();
+            flush_scan(cache, IFINDEX, FLUSH_KEEP_LOCAL, NULL, count, &matched);
+            ns[r] = (now() - t) * 1e9 / n;
+            m0 = perf_read(perf_fd) - m0;
+            if (perf_fd >= 0)
+                ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (m0 < misses)
+                misses = m0;
+        }
+        scan_allocs = allocs - a0;
+        qsort(ns, RUNS, sizeof(ns[0]), cmp_double);
+
+        printf("%9lu %8.3f %9lu %8.2f %8.2f %8.2f ", n, fractions[f], matched, build_s,
+               ns[0], ns[RUNS / 2]);
+        if (perf_fd >= 0)
+            printf("%9.3f", (double)misses / n);
+        else
+            printf("%9s", "-");
+        printf(" %8.2f %8.1f %6lu\n", (double)build_allocs / n, (double)build_bytes / n,
+               scan_allocs);
+
+        if (!out)
+            continue;
+        fprintf(out, "{\"bench\":\"flush_scan\",\"rev\":\"%s\",\"routes\":%lu,\"fraction\":%g,"
+                "\"matched\":%lu,\"build_s\":%.3f,\"ns_per_route_min\":%.3f,"
+                "\"ns_per_route_median\":%.3f,\"cache_misses_per_route\":",
+                rev, n, fractions[f], matched, build_s, ns[0], ns[RUNS / 2]);
+        if (perf_fd >= 0)
+            fprintf(out, "%.4f", (double)misses / n);
+        else
+            fputs("null", out);
+        fprintf(out, ",\"allocs_per_route\":%.3f,\"bytes_per_route\":%.1f,\"scan_allocs\":%lu}\n",
+                (double)build_allocs / n, (double)build_bytes / n, scan_allocs);
+        fflush(out);
+    }
+
+    nl_cache_free(cache);
+    free(nhs);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Times the scan for routes flushed with an interface.\n"
+            "  -n, --routes=N[,N...]  cache sizes (default 10000,100000,1000000,2000000)\n"
+            "  -o, --output=FILE      append JSON Lines results to FILE\n"
+            "  -r, --rev=REV          revision recorded with the results\n"
+            "  -h, --help             show this help\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "routes", required_argument, NULL, 'n' },
+        { "output", required_argument, NULL, 'o' },
+        { "rev",    required_argument, NULL, 'r' },
+        { "help",   no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    unsigned long sizes[16];
+    const char *rev = "";
+    size_t nsizes = 0, i;
+    FILE *out = NULL;
+    char *p, *end;
+    int opt, perf_fd;
+
+    while ((opt = getopt_long(argc, argv, "n:o:r:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            for (p = optarg; *p && nsizes < sizeof(sizes) / sizeof(sizes[0]); p = end) {
+                sizes[nsizes] = strtoul(p, &end, 0);
+                if (end == p || !sizes[nsizes] || (*end && *end != ',')) {
+                    fprintf(stderr, "Invalid size list: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                nsizes++;
+                if (*end)
+                    end++;
+            }
+            break;
+        case 'o':
+            out = fopen(optarg, "a");
+            if (!out) {
+                perror(optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            rev = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!nsizes) {
+        memcpy(sizes, default_sizes, sizeof(default_sizes));
+        nsizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    }
+
+    /* The larger caches take minutes to fill, show each result as it comes */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    perf_fd = perf_open();
+    printf("%9s %8s %9s %8s %8s %8s %9s %8s %8s %6s\n", "routes", "fraction", "matched",
+           "build s", "ns/r min", "ns/r med", "miss/r", "allocs/r", "bytes/r", "scan a");
+    for (i = 0; i < nsizes; i++)
+        run(sizes[i], out, rev, perf_fd);
+    if (perf_fd < 0)
+        fprintf(stderr, "Cache misses not counted, perf_event_open() is not available\n");
+    if (out)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Route monitor - output format benchmark
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "format.h"
+
+/*
+ * Renders EVENTS records (default 1M) with each formatter into a 64 KiB
+ * chunk the way out.c does, cycling through a pool of generated records:
+ * mostly IPv4 routes with one nexthop, some IPv6 multipath routes, moves,
+ * links and addresses.
+ */
+#define POOL        65536
+#define REC_MAX     RMON_REC_ROUTE_LEN(4)
+#define CHUNK       (64 * 1024)
+
+static union {
+    struct rmon_rec_hdr hdr;
+    unsigned char buf[REC_MAX];
+} pool[POOL];
+
+static void gen_route(struct rmon_rec_hdr *rec, unsigned int i)
+{
+    struct rmon_rec_route *r = (struct rmon_rec_route *)(rec + 1);
+    struct rmon_rec_nh *nh = (struct rmon_rec_nh *)(r + 1);
+    int v6 = i % 10 == 7, n;
+
+    rec->type = i % 16 == 3 ? RMON_REC_ROUTE_MOVE :
+                i % 2 ? RMON_REC_ROUTE_DEL : RMON_REC_ROUTE_ADD;
+    r->family = v6 ? 10 : 2;
+    r->protocol = 4;
+    r->rtype = 1;
+    r->table = 254;
+    r->priority = i % 3 * 100;
+    r->dst_alen = v6 ? 16 : 4;
+    r->dst_len = v6 ? 64 : 24;
+    if (v6) {
+        r->dst[0] = 0x20;
+        r->dst[1] = 0x01;
+        r->dst[6] = i >> 8;
+        r->dst[7] = i;
+    } else {
+        r->dst[0] = 10;
+        r->dst[1] = i >> 16;
+        r->dst[2] = i >> 8;
+    }
+    r->nnh = v6 ? 2 : 1;
+    r->old_nnh = rec->type == RMON_REC_ROUTE_MOVE;
+    for (n = 0; n < r->nnh + r->old_nnh; n++) {
+        nh[n].ifindex = 2 + n;
+        nh[n].weight = 1;
+        nh[n].gw_len = r->dst_alen;
+        memcpy(nh[n].gw, r->dst, r->dst_alen);
+        nh[n].gw[r->dst_alen - 1] = 1 + n;
+    }
+    rec->len = RMON_REC_ROUTE_LEN(r->nnh + r->old_nnh);
+}
+
+static void gen(struct rmon_rec_hdr *rec, unsigned int i)
+{
+    rec->version = RMON_PROTO_VERSION;
+    rec->seq = i + 1;
+    rec->ts = 1750000000000000000ULL + i * 1000ULL;
+
+    if (i % 50 == 11) {
+        struct rmon_rec_link *l = (struct rmon_rec_link *)(rec + 1);
+
+        rec->type = RMON_REC_LINK_CHANGE;
+        rec->len = RMON_REC_LINK_LEN;
+        l->ifindex = 2 + i % 8;
+        l->flags = 0x1043;
+        l->mtu = 1500;
+        snprintf(l->name, sizeof(l->name), "veth%u", i % 8);
+    } else if (i % 50 == 23) {
+        struct rmon_rec_addr *a = (struct rmon_rec_addr *)(rec + 1);
+
+        rec->type = RMON_REC_ADDR_ADD;
+        rec->len = RMON_REC_ADDR_LEN;
+        a->ifindex = 2 + i % 8;
+        a->family = 2;
+        a->prefixlen = 24;
+        a->alen = 4;
+        a->local[0] = 192;
+        a->local[1] = 168;
+        a->local[2] = i;
+        a->local[3] = 1;
+    } else {
+        gen_route(rec, i);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(const char *name, int (*fmt)(const struct rmon_rec_hdr *, char *, size_t),
+                unsigned long events)
+{
+    static char chunk[CHUNK];
+    unsigned long i, bytes = 0;
+    size_t used = 0;
+    double start, t;
+    int n;
+
+    start = now();
+    for (i = 0; i < events; i++) {
+        n = fmt(&pool[i % POOL].hdr, chunk + used, CHUNK - used);
+        if ((size_t)n >= CHUNK - used) {
+            used = 0;
+            n = fmt(&pool[i % POOL].hdr, chunk, CHUNK);
+        }
+        used += n;
+        bytes += n;
+    }
+    t = now() - start;
+
+    printf("%-8s %10lu %9.3f %9.1f %9.1f %9.1f\n", name, events, t, t * 1e9 / events,
+           (double)bytes / events, bytes / t / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long events = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+    unsigned int i;
+
+    for (i = 0; i < POOL; i++)
+        gen(&pool[i].hdr, i);
+
+    printf("%-8s %10s %9s %9s %9s %9s\n", "format", "events", "seconds", "ns/event",
+           "bytes/ev", "MB/s");
+    run("text", rmon_format_text, events);
+    run("jsonl", rmon_format_jsonl, events);
+    run("binary", rmon_format_binary, events);
+    return 0;
+}
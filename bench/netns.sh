@@ -0,0 +1,195 @@
+#!/bin/bash
+#
+# Route monitor - end-to-end benchmark in a network namespace
+# Copyright (c) 2025 Denis Kirjanov
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# Runs rmon in a private network namespace against the real kernel:
+# installs routes over veth links with ip -batch, takes every link down
+# and up again and deletes the link addresses. For each phase it reports
+# how many of the expected events rmon wrote, how long after the last
+# change the last of them came out and the CPU time rmon used per event.
+# Needs root, but no network.
+
+set -e
+
+usage() {
+    cat >&2 <<EOF
+Usage: $0 [options] [RMON [RMON OPTIONS...]]
+Benchmarks rmon (./rmon by default) in a network namespace.
+  -n ROUTES   routes to install (default 100000)
+  -l LINKS    veth links the routes are spread over (default 16)
+  -t SECONDS  how long to wait for the events of a phase (default 60)
+  -h          show this help
+EOF
+}
+
+routes=100000
+links=16
+timeout=60
+while getopts n:l:t:h opt; do
+    case $opt in
+    n) routes=$OPTARG ;;
+    l) links=$OPTARG ;;
+    t) timeout=$OPTARG ;;
+    h) usage; exit 0 ;;
+    *) usage; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+rmon=$(realpath "${1:-./rmon}")
+shift || true
+
+if [ "$links" -lt 1 ] || [ "$links" -gt 4096 ] || [ "$routes" -gt 16777216 ]; then
+    echo "At most 4096 links and 16777216 routes" >&2
+    exit 1
+fi
+
+ns=rmon-bench-$$
+dir=$(mktemp -d)
+pid=
+hz=$(getconf CLK_TCK)
+cpu_ns=0
+
+cleanup() {
+    if [ -n "$pid" ] && kill "$pid" 2>/dev/null; then
+        wait "$pid" 2>/dev/null || true
+    fi
+    ip netns del "$ns" 2>/dev/null
+    rm -rf "$dir"
+}
+trap cleanup EXIT
+
+nsx() {
+    ip netns exec "$ns" "$@"
+}
+
+now() {
+    date +%s%N
+}
+
+# CPU time of rmon in ns to cpu_ns, kept once rmon has exited. Scheduler
+# statistics are exact but not every kernel keeps them, stat has ticks.
+cpu() {
+    local stat
+
+    stat=$(cat /proc/"$pid"/task/*/schedstat 2>/dev/null |
+           awk '{ t += $1 } END { printf "%.0f\n", t }')
+    if [ "${stat:-0}" -gt 0 ]; then
+        cpu_ns=$stat
+    elif stat=$(cat /proc/"$pid"/stat 2>/dev/null); then
+        set -- ${stat##*) }
+        cpu_ns=$(((${12} + ${13}) * 1000000000 / hz))
+    fi
+}
+
+# Number of EVENT records containing MATCH and the time of the last one
+scan() {
+    awk -v ev="\"event\":\"$1\"" -v m="$2" '
+        index($0, ev) && index($0, m) {
+            n++
+            if (match($0, /"ts":[0-9]+/))
+                last = substr($0, RSTART + 5, RLENGTH - 5)
+        }
+        END { printf "%d %.0f\n", n, last }' "$dir/out"
+}
+
+# phase NAME EVENT MATCH EXPECTED BATCHFILE
+phase() {
+    local name=$1 event=$2 match=$3 expected=$4 batch=$5
+    local cpu0 cpu1 t1 deadline n last
+
+    cpu
+    cpu0=$cpu_ns
+    nsx ip -force -batch "$batch"
+    t1=$(now)
+    deadline=$((t1 + timeout * 1000000000))
+    while :; do
+        read -r n last < <(scan "$event" "$match")
+        [ "$n" -ge "$expected" ] && break
+        [ "$(now)" -ge "$deadline" ] && break
+        kill -0 "$pid" 2>/dev/null || break
+        sleep 0.02
+    done
+    cpu
+    cpu1=$cpu_ns
+
+    awk -v name="$name" -v want="$expected" -v n="$n" -v last="$last" -v t1="$t1" \
+        -v cpu="$((cpu1 - cpu0))" 'BEGIN {
+        catchup = n ? (last - t1) / 1e6 : 0
+        if (catchup < 0)
+            catchup = 0
+        printf("%-8s expected: %d received: %d (%.1f%%) catch-up: %.1f ms cpu/event: %.2f us\n",
+               name, want, n, want ? 100 * n / want : 100, catchup, n ? cpu / n / 1000 : 0)
+    }'
+    [ "$n" -ge "$expected" ]
+}
+
+addr() {
+    echo "172.$((16 + $1 / 256)).$(($1 % 256)).1/24"
+}
+
+ip netns add "$ns"
+nsx sysctl -qw net.ipv6.conf.all.disable_ipv6=1 net.ipv6.conf.default.disable_ipv6=1
+nsx ip link set lo up
+
+for ((i = 0; i < links; i++)); do
+    echo "link add bench$i type veth peer name peer$i"
+    echo "link set peer$i up"
+    echo "link set bench$i up"
+    echo "addr add $(addr $i) dev bench$i"
+done > "$dir/setup"
+nsx ip -batch "$dir/setup"
+
+awk -v n="$routes" -v links="$links" 'BEGIN {
+    for (i = 0; i < n; i++)
+        printf "route add 10.%d.%d.%d/32 dev bench%d\n",
+               int(i / 65536), int(i / 256) % 256, i % 256, i % links
+}' > "$dir/routes"
+for ((i = 0; i < links; i++)); do
+    echo "link set bench$i down"
+    echo "link set bench$i up"
+done > "$dir/flap"
+for ((i = 0; i < links; i++)); do
+    echo "addr del $(addr $i) dev bench$i"
+done > "$dir/addrs"
+
+ip netns exec "$ns" "$rmon" --format=jsonl "$@" > "$dir/out" 2> "$dir/err" &
+pid=$!
+
+# Ready once a change made now shows up rather than in the initial dump
+for ((i = 0; ; i++)); do
+    if [ "$i" -ge $((timeout * 10)) ] || ! kill -0 "$pid" 2>/dev/null; then
+        echo "rmon did not start:" >&2
+        cat "$dir/err" >&2
+        exit 1
+    fi
+    nsx ip link add probe$i type veth peer name probepeer$i
+    sleep 0.1
+    read -r n last < <(scan link_add '"name":"probe')
+    [ "$n" -gt 0 ] && break
+done
+ok=0
+
+echo "Routes: $routes links: $links"
+phase install route_add '"dst":"10.' "$routes" "$dir/routes" || ok=1
+phase flap route_invalidate '"dst":"10.' "$routes" "$dir/flap" || ok=1
+phase addrdel addr_del '"local":"172.' "$links" "$dir/addrs" || ok=1
+
+if ! kill -0 "$pid" 2>/dev/null; then
+    echo "rmon exited:" >&2
+    cat "$dir/err" >&2
+    ok=1
+fi
+exit $ok
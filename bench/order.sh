@@ -0,0 +1,73 @@
+#!/bin/bash
+#
+# Route monitor - link down ordering check on a generated workload
+# Copyright (c) 2025 Denis Kirjanov
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# Writes a workload with rmon-gen in which every link goes down in the
+# same batch as a route over it was announced, replays it through
+# rmon --from-capture and fails unless each of those routes was added
+# and then invalidated by its link going down.
+# Needs neither root nor network.
+
+set -e
+
+usage() {
+    cat >&2 <<EOF
+Usage: $0 [options] [RMON [RMON-GEN]]
+Checks link down ordering with rmon and rmon-gen (./rmon, ./rmon-gen).
+  -n ROUTES  routes in the table (default 10000)
+  -l LINKS   links, each taken down once (default 16)
+  -h         show this help
+EOF
+}
+
+routes=10000
+links=16
+while getopts n:l:h opt; do
+    case $opt in
+    n) routes=$OPTARG ;;
+    l) links=$OPTARG ;;
+    h) usage; exit 0 ;;
+    *) usage; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+rmon=$(realpath "${1:-./rmon}")
+gen=$(realpath "${2:-./rmon-gen}")
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+"$gen" -n "$routes" -k "$links" -w "$links" "$dir/capture" >&2
+"$rmon" --from-capture="$dir/capture" --format=jsonl > "$dir/out" 2> "$dir/err" ||
+    { cat "$dir/err" >&2; exit 1; }
+
+awk -v links="$links" '
+    match($0, /"dst":"198\.1[89]\.[0-9.]+"/) {
+        dst = substr($0, RSTART + 7, RLENGTH - 8)
+        if (index($0, "\"event\":\"route_add\""))
+            added[dst] = 1
+        else if (index($0, "\"event\":\"route_invalidate\"") && (dst in added))
+            invalidated[dst] = 1
+    }
+    END {
+        for (dst in added) {
+            a++
+            if (dst in invalidated)
+                n++
+        }
+        printf("Links down: %d routes added: %d invalidated: %d\n", links, a, n)
+        exit !(a == links && n == links)
+    }' "$dir/out"
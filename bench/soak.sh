@@ -0,0 +1,304 @@
+#!/bin/bash
+#
+# Route monitor - link and address flap soak test in a network namespace
+# Copyright (c) 2025 Denis Kirjanov
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# Runs rmon --memstats in a private network namespace and flaps its veth
+# links one after the other. Each link has two addresses and its routes
+# use the first as source. An iteration takes a link down, waits for its
+# routes to be invalidated, brings it up and installs them again. Then it
+# deletes the first address, which invalidates the routes by their
+# source, or on every other iteration both, which invalidates them by
+# the link losing its last address, and adds the addresses and routes
+# back. After every iteration rmon's statistics report gives the route
+# cache entries and heap. Fails unless those stay where the first
+# iteration left them and the time from the link going down or the
+# address going away to the last invalidation, the flush scan, doesn't
+# grow.
+# Needs root, but no network.
+
+set -e
+
+usage() {
+    cat >&2 <<EOF
+Usage: $0 [options] [RMON [RMON OPTIONS...]]
+Flaps links under rmon (./rmon by default) in a network namespace.
+  -n ROUTES      routes to install (default 10000)
+  -l LINKS       veth links the routes are spread over (default 4)
+  -i ITERATIONS  link and address flaps (default 20)
+  -t SECONDS     how long to wait for the events of a step (default 60)
+  -g PERCENT     growth of the scan time allowed, last quarter of the
+                 iterations against the first (default 50)
+  -h             show this help
+EOF
+}
+
+routes=10000
+links=4
+iterations=20
+timeout=60
+growth=50
+while getopts n:l:i:t:g:h opt; do
+    case $opt in
+    n) routes=$OPTARG ;;
+    l) links=$OPTARG ;;
+    i) iterations=$OPTARG ;;
+    t) timeout=$OPTARG ;;
+    g) growth=$OPTARG ;;
+    h) usage; exit 0 ;;
+    *) usage; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+rmon=$(realpath "${1:-./rmon}")
+shift || true
+
+if [ "$links" -lt 1 ] || [ "$links" -gt 4096 ] || [ "$routes" -gt 16777216 ] ||
+   [ "$iterations" -lt 1 ]; then
+    echo "At least one iteration, at most 4096 links and 16777216 routes" >&2
+    exit 1
+fi
+
+ns=rmon-soak-$$
+dir=$(mktemp -d)
+pid=
+
+cleanup() {
+    if [ -n "$pid" ] && kill "$pid" 2>/dev/null; then
+        wait "$pid" 2>/dev/null || true
+    fi
+    ip netns del "$ns" 2>/dev/null
+    rm -rf "$dir"
+}
+trap cleanup EXIT
+
+nsx() {
+    ip netns exec "$ns" "$@"
+}
+
+now() {
+    date +%s%N
+}
+
+# Output written since byte offset $1
+since() {
+    tail -c +$(($1 + 1)) "$dir/out"
+}
+
+# Number of EVENT records containing MATCH after byte offset FROM
+count() {
+    since "$1" | awk -v ev="\"event\":\"$2\"" -v m="$3" '
+        index($0, ev) && index($0, m) { n++ }
+        END { print n + 0 }'
+}
+
+# Waits until COUNT of FROM EVENT MATCH reaches EXPECTED
+await() {
+    local from=$1 event=$2 match=$3 expected=$4 deadline n
+
+    deadline=$(($(now) + timeout * 1000000000))
+    while :; do
+        n=$(count "$from" "$event" "$match")
+        [ "$n" -ge "$expected" ] && return 0
+        if [ "$(now)" -ge "$deadline" ] || ! kill -0 "$pid" 2>/dev/null; then
+            echo "Timed out: $event $match: $n of $expected" >&2
+            return 1
+        fi
+        sleep 0.02
+    done
+}
+
+# Nanoseconds from the first EVENT containing MATCH to the last
+# invalidation after FROM
+scan_time() {
+    since "$1" | awk -v ev="\"event\":\"$2\"" -v m="$3" '
+        index($0, ev) && index($0, m) && !down && match($0, /"ts":[0-9]+/) {
+            down = substr($0, RSTART + 5, RLENGTH - 5)
+        }
+        index($0, "\"event\":\"route_invalidate\"") && index($0, "\"dst\":\"10.") &&
+        match($0, /"ts":[0-9]+/) {
+            last = substr($0, RSTART + 5, RLENGTH - 5)
+        }
+        END { printf "%.0f\n", (down && last > down) ? last - down : 0 }'
+}
+
+# Route cache entries and heap bytes from the next statistics report
+memstats() {
+    local reports deadline
+
+    reports=$(grep -c '^Memory routes:' "$dir/err" || true)
+    kill -USR1 "$pid"
+    deadline=$(($(now) + timeout * 1000000000))
+    while [ "$(grep -c '^Memory routes:' "$dir/err" || true)" -le "$reports" ]; do
+        if [ "$(now)" -ge "$deadline" ] || ! kill -0 "$pid" 2>/dev/null; then
+            echo "No statistics report" >&2
+            return 1
+        fi
+        sleep 0.02
+    done
+    grep '^Memory routes:' "$dir/err" | tail -n 1 |
+        awk '{ for (i = 1; i < NF; i++) {
+                   if ($i == "heap:") heap = $(i + 1)
+                   if ($i == "entries:") entries = $(i + 1)
+               }
+               print entries, heap }'
+}
+
+# The address the routes via link N use as source and the other one
+local_addr() {
+    echo "172.$((16 + $1 / 256)).$(($1 % 256)).1"
+}
+
+other_addr() {
+    echo "100.$((64 + $1 / 256)).$(($1 % 256)).1"
+}
+
+ip netns add "$ns"
+nsx sysctl -qw net.ipv6.conf.all.disable_ipv6=1 net.ipv6.conf.default.disable_ipv6=1
+nsx ip link set lo up
+
+for ((i = 0; i < links; i++)); do
+    echo "link add bench$i type veth peer name peer$i"
+    echo "link set peer$i up"
+    echo "link set bench$i up"
+    echo "addr add $(local_addr $i)/24 dev bench$i"
+    echo "addr add $(other_addr $i)/24 dev bench$i"
+done > "$dir/setup"
+nsx ip -batch "$dir/setup"
+
+for ((i = 0; i < links; i++)); do
+    awk -v n="$routes" -v links="$links" -v l="$i" -v src="$(local_addr $i)" 'BEGIN {
+        for (i = l; i < n; i += links)
+            printf "route add 10.%d.%d.%d/32 dev bench%d src %s\n",
+                   int(i / 65536), int(i / 256) % 256, i % 256, l, src
+    }' > "$dir/routes$i"
+    echo "link set bench$i down" > "$dir/down$i"
+    echo "link set bench$i up" > "$dir/up$i"
+    echo "addr del $(local_addr $i)/24 dev bench$i" > "$dir/srcdel$i"
+    echo "addr add $(local_addr $i)/24 dev bench$i" > "$dir/srcadd$i"
+    echo "addr del $(other_addr $i)/24 dev bench$i" > "$dir/lastdel$i"
+    cat "$dir/srcdel$i" >> "$dir/lastdel$i"
+    cat "$dir/srcadd$i" > "$dir/lastadd$i"
+    echo "addr add $(other_addr $i)/24 dev bench$i" >> "$dir/lastadd$i"
+done
+
+ip netns exec "$ns" "$rmon" --format=jsonl --memstats "$@" > "$dir/out" 2> "$dir/err" &
+pid=$!
+
+# Ready once a change made now shows up rather than in the initial dump
+for ((i = 0; ; i++)); do
+    if [ "$i" -ge $((timeout * 10)) ] || ! kill -0 "$pid" 2>/dev/null; then
+        echo "rmon did not start:" >&2
+        cat "$dir/err" >&2
+        exit 1
+    fi
+    nsx ip link add probe$i type veth peer name probepeer$i
+    sleep 0.1
+    [ "$(count 0 link_add '"name":"probe')" -gt 0 ] && break
+done
+
+from=$(stat -c %s "$dir/out")
+for ((i = 0; i < links; i++)); do
+    cat "$dir/routes$i"
+done > "$dir/routes"
+nsx ip -batch "$dir/routes"
+await "$from" route_add '"dst":"10.' "$routes"
+
+echo "Routes: $routes links: $links iterations: $iterations"
+ok=0
+for ((it = 0; it < iterations; it++)); do
+    l=$((it % links))
+    n=$(wc -l < "$dir/routes$l")
+
+    from=$(stat -c %s "$dir/out")
+    nsx ip -batch "$dir/down$l"
+    await "$from" route_invalidate '"dst":"10.' "$n" || { ok=1; break; }
+    link_scan=$(scan_time "$from" link_change "\"name\":\"bench$l\"")
+
+    from=$(stat -c %s "$dir/out")
+    nsx ip -batch "$dir/up$l"
+    nsx ip -batch "$dir/routes$l"
+    await "$from" route_add '"dst":"10.' "$n" || { ok=1; break; }
+
+    # By source while the other address stays, by link once it goes too
+    flush=src
+    [ $((it % 2)) -eq 1 ] && flush=last
+    from=$(stat -c %s "$dir/out")
+    nsx ip -batch "$dir/${flush}del$l"
+    await "$from" route_invalidate '"dst":"10.' "$n" || { ok=1; break; }
+    addr_scan=$(scan_time "$from" addr_del "\"local\":\"$(local_addr $l)\"")
+
+    from=$(stat -c %s "$dir/out")
+    nsx ip -batch "$dir/${flush}add$l"
+    nsx ip -batch "$dir/routes$l"
+    await "$from" route_add '"dst":"10.' "$n" || { ok=1; break; }
+
+    read -r entries heap < <(memstats) || { ok=1; break; }
+    echo "$it $link_scan $addr_scan $entries $heap" >> "$dir/iterations"
+    awk -v it="$it" -v l="$l" -v link_scan="$link_scan" -v addr_scan="$addr_scan" \
+        -v flush="$flush" -v entries="$entries" -v heap="$heap" 'BEGIN {
+        printf("flap %-4d bench%-4d scan link: %.2f ms addr (%s): %.2f ms route cache: %d entries %d bytes\n",
+               it, l, link_scan / 1e6, flush, addr_scan / 1e6, entries, heap)
+    }'
+done
+
+if [ "$ok" -eq 0 ]; then
+    awk -v growth="$growth" '
+        function grew(what, col,    i, first, last) {
+            for (i = 1; i <= q; i++) {
+                first += scan[i, col]
+                last += scan[NR - q + i, col]
+            }
+            first /= q
+            last /= q
+            printf("Scan %s: first %d flaps: %.2f ms last %d flaps: %.2f ms\n",
+                   what, q, first / 1e6, q, last / 1e6)
+            # Scans of a few hundred microseconds are left to noise
+            if (last > first * (1 + growth / 100) + 1000000) {
+                printf("Scan time grew by more than %d%%\n", growth)
+                return 1
+            }
+            return 0
+        }
+        { scan[NR, 0] = $2; scan[NR, 1] = $3; entries[NR] = $4; heap[NR] = $5 }
+        END {
+            q = int(NR / 4)
+            if (q < 1)
+                q = 1
+            for (i = 2; i <= NR; i++) {
+                if (entries[i] != entries[1]) {
+                    printf("Route cache entries went from %d to %d\n", entries[1], entries[i])
+                    fail = 1
+                    break
+                }
+                # The allocator may round, growth with every flap is a leak
+                if (heap[i] > heap[1] * 1.02) {
+                    printf("Route cache heap went from %d to %d bytes\n", heap[1], heap[i])
+                    fail = 1
+                    break
+                }
+            }
+            if (grew("link", 0) + grew("addr", 1))
+                fail = 1
+            exit fail
+        }' "$dir/iterations" || ok=1
+fi
+
+if ! kill -0 "$pid" 2>/dev/null; then
+    echo "rmon exited:" >&2
+    cat "$dir/err" >&2
+    ok=1
+fi
+exit $ok
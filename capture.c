@@ -0,0 +1,408 @@
+/*
+ * Route monitor - netlink capture
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/route/addr.h>
+#include <netlink/route/link.h>
+#include <netlink/route/route.h>
+#include <arpa/inet.h>
+#include <linux/if_arp.h>
+#include <linux/if_packet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "mem.h"
+#include "metrics.h"
+#include "rmon_pcap.h"
+
+static struct {
+    int fd;
+    const char *path;
+    unsigned char *map;
+    uint64_t map_off;           /* file offset of the mapped window */
+    size_t pos;                 /* in the window */
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t dumped;
+    uint64_t skipped;
+    uint64_t errors;
+} capture = {
+    .fd = -1,
+};
+
+/* A capture being read, mapped whole */
+static struct {
+    const unsigned char *map;
+    size_t size;
+    size_t pos;
+    size_t last;                /* start of the packet handed out last */
+    int batch_end;
+} input;
+
+static int map_window(uint64_t off)
+{
+    void *map;
+    int err;
+
+    if (capture.map) {
+        munmap(capture.map, CAPTURE_WINDOW);
+        mem_mapped(MEM_CAPTURE, -CAPTURE_WINDOW);
+    }
+    capture.map = NULL;
+
+    /* Allocate up front: running out of space later would be a SIGBUS */
+    err = posix_fallocate(capture.fd, off, CAPTURE_WINDOW);
+    if (err)
+        return -nl_syserr2nlerr(err);
+    map = mmap(NULL, CAPTURE_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, capture.fd, off);
+    if (map == MAP_FAILED)
+        return -nl_syserr2nlerr(errno);
+    capture.map = map;
+    mem_mapped(MEM_CAPTURE, CAPTURE_WINDOW);
+    capture.map_off = off;
+    capture.pos = 0;
+    return 0;
+}
+
+static int put(const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    size_t n;
+    int err;
+
+    while (len) {
+        if (capture.pos == CAPTURE_WINDOW) {
+            err = map_window(capture.map_off + CAPTURE_WINDOW);
+            if (err < 0)
+                return err;
+        }
+        n = CAPTURE_WINDOW - capture.pos;
+        if (n > len)
+            n = len;
+        memcpy(capture.map + capture.pos, p, n);
+        capture.pos += n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int capture_init(const char *path)
+{
+    struct rmon_pcap_hdr hdr = {
+        .magic = RMON_PCAP_MAGIC,
+        .version_major = RMON_PCAP_VERSION_MAJOR,
+        .version_minor = RMON_PCAP_VERSION_MINOR,
+        .snaplen = RMON_PCAP_SNAPLEN,
+        .linktype = RMON_PCAP_LINKTYPE,
+    };
+    int err;
+
+    capture.fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (capture.fd < 0)
+        return -nl_syserr2nlerr(errno);
+    capture.path = path;
+
+    err = map_window(0);
+    if (err < 0) {
+        capture_close();
+        return err;
+    }
+    return put(&hdr, sizeof(hdr));
+}
+
+/* One packet per read; the file is closed on the first error */
+void capture_packet(const void *buf, size_t len, uint64_t batch)
+{
+    struct rmon_pcap_nl nl = {
+        .pkttype = htons(PACKET_USER),
+        .hatype = htons(ARPHRD_NETLINK),
+        .family = htons(NETLINK_ROUTE),
+    };
+    struct rmon_pcap_rec rec;
+    struct timespec ts;
+    int err, i;
+
+    if (capture.fd < 0)
+        return;
+    for (i = 0; i < 8; i++)
+        nl.addr[i] = batch >> (56 - 8 * i);
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec.ts_sec = ts.tv_sec;
+    rec.ts_nsec = ts.tv_nsec;
+    rec.orig_len = sizeof(nl) + len;
+    rec.incl_len = rec.orig_len < RMON_PCAP_SNAPLEN ? rec.orig_len : RMON_PCAP_SNAPLEN;
+
+    err = put(&rec, sizeof(rec));
+    if (!err)
+        err = put(&nl, sizeof(nl));
+    if (!err)
+        err = put(buf, rec.incl_len - sizeof(nl));
+    if (err < 0) {
+        fprintf(stderr, "Unable to write capture, recording stopped: %s\n", nl_geterror(err));
+        capture.errors++;
+        capture_close();
+        return;
+    }
+    capture.packets++;
+    capture.bytes += len;
+}
+
+static void dump_msg(struct nl_msg *msg)
+{
+    struct nlmsghdr *nlh = nlmsg_hdr(msg);
+
+    nlh->nlmsg_flags = NLM_F_MULTI;
+    capture_packet(nlh, nlh->nlmsg_len, 0);
+    capture.dumped++;
+    nlmsg_free(msg);
+}
+
+/*
+ * libnl's request builder trips over link types whose details it only
+ * half parsed (a veth without its peer), and the kind specific details
+ * don't matter here, so links are described by their basic attributes.
+ */
+static struct nl_msg *link_msg(struct rtnl_link *link)
+{
+    struct ifinfomsg ifi = {
+        .ifi_family = AF_UNSPEC,
+        .ifi_type = rtnl_link_get_arptype(link),
+        .ifi_index = rtnl_link_get_ifindex(link),
+        .ifi_flags = rtnl_link_get_flags(link),
+    };
+    struct nl_addr *lladdr = rtnl_link_get_addr(link);
+    const char *name = rtnl_link_get_name(link);
+    struct nl_msg *msg;
+
+    msg = nlmsg_alloc_simple(RTM_NEWLINK, NLM_F_MULTI);
+    if (!msg)
+        return NULL;
+    if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) < 0 ||
+        (name && nla_put_string(msg, IFLA_IFNAME, name) < 0) ||
+        nla_put_u32(msg, IFLA_MTU, rtnl_link_get_mtu(link)) < 0 ||
+        nla_put_u8(msg, IFLA_OPERSTATE, rtnl_link_get_operstate(link)) < 0 ||
+        (rtnl_link_get_master(link) &&
+         nla_put_u32(msg, IFLA_MASTER, rtnl_link_get_master(link)) < 0) ||
+        (lladdr && nla_put_addr(msg, IFLA_ADDRESS, lladdr) < 0)) {
+        nlmsg_free(msg);
+        return NULL;
+    }
+    return msg;
+}
+
+/*
+ * The caches are filled over a socket of their own which isn't recorded,
+ * so their contents go in first as if dumped.
+ */
+void capture_dump(struct nl_cache *link, struct nl_cache *addr, struct nl_cache *route)
+{
+    struct {
+        struct nlmsghdr nlh;
+        int error;
+    } done = {
+        .nlh = {
+            .nlmsg_len = NLMSG_LENGTH(sizeof(int)),
+            .nlmsg_type = NLMSG_DONE,
+            .nlmsg_flags = NLM_F_MULTI,
+        },
+    };
+    struct nl_object *obj;
+    struct nl_msg *msg;
+
+    for (obj = nl_cache_get_first(link); obj; obj = nl_cache_get_next(obj)) {
+        msg = link_msg((struct rtnl_link *)obj);
+        if (!msg) {
+            capture.skipped++;
+            continue;
+        }
+        dump_msg(msg);
+    }
+    for (obj = nl_cache_get_first(addr); obj; obj = nl_cache_get_next(obj)) {
+        if (rtnl_addr_build_add_request((struct rtnl_addr *)obj, 0, &msg) < 0) {
+            capture.skipped++;
+            continue;
+        }
+        dump_msg(msg);
+    }
+    for (obj = nl_cache_get_first(route); obj; obj = nl_cache_get_next(obj)) {
+        if (rtnl_route_build_add_request((struct rtnl_route *)obj, 0, &msg) < 0) {
+            capture.skipped++;
+            continue;
+        }
+        dump_msg(msg);
+    }
+    capture_packet(&done, done.nlh.nlmsg_len, 0);
+}
+
+void capture_report(FILE *f)
+{
+    if (!capture.path)
+        return;
+    fprintf(f, "Capture: packets: %llu bytes: %llu dumped: %llu skipped: %llu errors: %llu\n",
+            (unsigned long long)capture.packets, (unsigned long long)capture.bytes,
+            (unsigned long long)capture.dumped, (unsigned long long)capture.skipped,
+            (unsigned long long)capture.errors);
+}
+
+void capture_metrics(struct metrics_writer *w, void *data)
+{
+    if (!capture.path)
+        return;
+    metrics_put(w, "rmon_capture_packets_total", "counter", "Netlink reads recorded.", NULL,
+                capture.packets);
+    metrics_put(w, "rmon_capture_bytes_total", "counter", "Netlink bytes recorded.", NULL,
+                capture.bytes);
+    metrics_put(w, "rmon_capture_errors_total", "counter", "Capture write errors.", NULL,
+                capture.errors);
+}
+
+/* Trims the file to what was written */
+void capture_close(void)
+{
+    if (capture.fd < 0)
+        return;
+    if (capture.map) {
+        munmap(capture.map, CAPTURE_WINDOW);
+        mem_mapped(MEM_CAPTURE, -CAPTURE_WINDOW);
+    }
+    if (ftruncate(capture.fd, capture.map_off + capture.pos) < 0)
+        capture.errors++;
+    close(capture.fd);
+    capture.map = NULL;
+    capture.fd = -1;
+}
+
+int capture_open(const char *path)
+{
+    struct rmon_pcap_hdr hdr;
+    struct stat st;
+    void *map;
+    int fd, err = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -nl_syserr2nlerr(errno);
+    if (fstat(fd, &st) < 0) {
+        err = -nl_syserr2nlerr(errno);
+        goto out;
+    }
+    if ((size_t)st.st_size < sizeof(hdr)) {
+        err = -NLE_INVAL;
+        goto out;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        err = -nl_syserr2nlerr(errno);
+        goto out;
+    }
+    memcpy(&hdr, map, sizeof(hdr));
+    if ((hdr.magic != RMON_PCAP_MAGIC && hdr.magic != RMON_PCAP_MAGIC_USEC) ||
+        hdr.linktype != RMON_PCAP_LINKTYPE) {
+        munmap(map, st.st_size);
+        err = -NLE_INVAL;
+        goto out;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    input.map = map;
+    mem_mapped(MEM_CAPTURE, st.st_size);
+    input.size = st.st_size;
+    input.pos = sizeof(hdr);
+out:
+    close(fd);
+    return err;
+}
+
+/*
+ * Returns the netlink bytes and batch number of the next packet, 0 at the
+ * end of the capture. Packets of other netlink families are skipped.
+ */
+size_t capture_next(const void **data, uint64_t *batch)
+{
+    struct rmon_pcap_rec rec;
+    struct rmon_pcap_nl nl;
+    int i;
+
+    while (input.pos + sizeof(rec) <= input.size) {
+        memcpy(&rec, input.map + input.pos, sizeof(rec));
+        if (rec.incl_len > input.size - input.pos - sizeof(rec))
+            break;
+        input.last = input.pos;
+        input.pos += sizeof(rec) + rec.incl_len;
+        if (rec.incl_len < sizeof(nl))
+            continue;
+        memcpy(&nl, input.map + input.last + sizeof(rec), sizeof(nl));
+        if (ntohs(nl.family) != NETLINK_ROUTE)
+            continue;
+        for (*batch = 0, i = 0; i < 8; i++)
+            *batch = *batch << 8 | nl.addr[i];
+        *data = input.map + input.last + sizeof(rec) + sizeof(nl);
+        return rec.incl_len - sizeof(nl);
+    }
+    return 0;
+}
+
+/* Steps back to the packet capture_next() returned last */
+void capture_unread(void)
+{
+    input.pos = input.last;
+}
+
+/*
+ * Source for rx_set_source(): the packets of one receive batch, then 0 as
+ * if the socket had been drained, and -1 at the end of the capture.
+ * Without batch numbers every packet is a batch of its own.
+ */
+ssize_t capture_read(const void **data)
+{
+    uint64_t batch, next;
+    const void *peek;
+    size_t len;
+
+    if (input.batch_end) {
+        input.batch_end = 0;
+        return 0;
+    }
+    len = capture_next(data, &batch);
+    if (!len)
+        return -1;
+    if (!capture_next(&peek, &next))
+        input.batch_end = 1;
+    else {
+        capture_unread();
+        input.batch_end = !batch || next != batch;
+    }
+    return len;
+}
+
+void capture_input_close(void)
+{
+    if (input.map) {
+        munmap((void *)input.map, input.size);
+        mem_mapped(MEM_CAPTURE, -(long)input.size);
+    }
+    input.map = NULL;
+}
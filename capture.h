@@ -0,0 +1,50 @@
+/*
+ * Route monitor - netlink capture
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_CAPTURE_H
+#define RMON_CAPTURE_H
+
+#include <netlink/cache.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Records the raw netlink messages rmon reads in the format described in
+ * rmon_pcap.h. The file is written through a memory-mapped window, so
+ * recording a packet is a copy, without a system call.
+ */
+#define CAPTURE_WINDOW      (16 * 1024 * 1024)
+
+struct metrics_writer;
+
+int capture_init(const char *path);
+void capture_packet(const void *buf, size_t len, uint64_t batch);
+void capture_dump(struct nl_cache *link, struct nl_cache *addr, struct nl_cache *route);
+void capture_report(FILE *f);
+void capture_metrics(struct metrics_writer *w, void *data);
+void capture_close(void);
+
+/* Reading a capture back, see --from-capture */
+int capture_open(const char *path);
+size_t capture_next(const void **data, uint64_t *batch);
+void capture_unread(void);
+ssize_t capture_read(const void **data);
+void capture_input_close(void);
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * Route monitor - route flap damping
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "damp.h"
+#include "mem.h"
+
+#define DAMP_SETS   2048
+#define DAMP_WAYS   4
+
+/* Time is kept in 1/10 s ticks since the first update */
+struct damp_entry {
+    uint64_t key;
+    float penalty;
+    uint32_t tick;
+    uint16_t events;
+    uint16_t damped;
+    struct rmon_rec_route *route;   /* while damped */
+};
+
+/* A damped entry recycled for another key, released by the next sweep */
+struct damp_evicted {
+    struct rmon_rec_route *route;
+    unsigned int events;
+};
+
+static struct {
+    struct damp_entry table[DAMP_SETS][DAMP_WAYS];
+    double half_life_ticks;
+    uint64_t start_ns;
+    uint32_t next_tick;         /* no damped entry is reusable before */
+    struct damp_evicted *evicted_routes;
+    size_t nevicted, evicted_size;
+    uint64_t damped;
+    uint64_t summarized;
+    uint64_t evicted;
+} damp;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    uint64_t ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    if (!damp.start_ns)
+        damp.start_ns = ns;
+    return ns;
+}
+
+static uint32_t now_tick(void)
+{
+    return (now_ns() - damp.start_ns) / 100000000ULL;
+}
+
+static float decayed(const struct damp_entry *e, uint32_t tick)
+{
+    if (tick == e->tick)
+        return e->penalty;
+    return e->penalty * exp2(-(double)(tick - e->tick) / damp.half_life_ticks);
+}
+
+/* First tick the penalty of e is below the reuse limit */
+static uint32_t reuse_tick(const struct damp_entry *e)
+{
+    return e->tick + (uint32_t)ceil(damp.half_life_ticks *
+                                    log2(e->penalty / DAMP_REUSE_LIMIT)) + 1;
+}
+
+/* A half life of zero disables damping */
+void damp_init(unsigned int half_life)
+{
+    if (!damp.half_life_ticks && half_life)
+        mem_mapped(MEM_DAMP, sizeof(damp.table));
+    damp.half_life_ticks = half_life * 10.0;
+    damp.next_tick = UINT32_MAX;
+}
+
+static void evict(struct damp_entry *e)
+{
+    struct damp_evicted *ev;
+
+    damp.damped--;
+    if (damp.nevicted == damp.evicted_size) {
+        size_t size = damp.evicted_size ? 2 * damp.evicted_size : 16;
+
+        ev = mem_realloc(MEM_DAMP, damp.evicted_routes, size * sizeof(*ev));
+        if (!ev) {
+            free(e->route);
+            return;
+        }
+        damp.evicted_routes = ev;
+        damp.evicted_size = size;
+    }
+    ev = &damp.evicted_routes[damp.nevicted++];
+    ev->route = e->route;
+    ev->events = e->events;
+}
+
+static struct damp_entry *lookup(uint64_t key, uint32_t tick)
+{
+    struct damp_entry *set = damp.table[(key >> 1) % DAMP_SETS];
+    struct damp_entry *victim = NULL;
+    float lowest = 0;
+    int i;
+
+    for (i = 0; i < DAMP_WAYS; i++) {
+        if (set[i].key == key)
+            return &set[i];
+    }
+
+    for (i = 0; i < DAMP_WAYS; i++) {
+        float p;
+
+        if (!set[i].key) {
+            victim = &set[i];
+            break;
+        }
+        p = decayed(&set[i], tick) + (set[i].damped ? DAMP_CEILING : 0);
+        if (!victim || p < lowest) {
+            victim = &set[i];
+            lowest = p;
+        }
+    }
+
+    if (victim->key) {
+        damp.evicted++;
+        if (victim->damped)
+            evict(victim);
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->key = key;
+    victim->tick = tick;
+    return victim;
+}
+
+enum damp_verdict damp_update(uint64_t key, unsigned int penalty,
+                              const struct rmon_rec_route *route, struct damp_info *info)
+{
+    struct damp_entry *e;
+    uint32_t tick;
+    float p;
+
+    if (!damp.half_life_ticks)
+        return DAMP_PASS;
+
+    tick = now_tick();
+    e = lookup(key, tick);
+    p = decayed(e, tick) + penalty;
+    if (p > DAMP_CEILING)
+        p = DAMP_CEILING;
+    e->penalty = p;
+    e->tick = tick;
+    info->penalty = p;
+
+    if (e->damped) {
+        if (p >= DAMP_REUSE_LIMIT) {
+            if (e->events < UINT16_MAX)
+                e->events++;
+            damp.summarized++;
+            return DAMP_SUPPRESS;
+        }
+        info->events = e->events;
+        e->damped = 0;
+        e->events = 0;
+        free(e->route);
+        e->route = NULL;
+        damp.damped--;
+        return DAMP_REUSED;
+    }
+
+    if (p >= DAMP_SUPPRESS_LIMIT) {
+        /* Without its route a key couldn't be released, so it isn't damped */
+        e->route = mem_malloc(MEM_DAMP, sizeof(*e->route));
+        if (!e->route)
+            return DAMP_PASS;
+        *e->route = *route;
+        e->damped = 1;
+        damp.damped++;
+        if (reuse_tick(e) < damp.next_tick)
+            damp.next_tick = reuse_tick(e);
+        return DAMP_DAMPED;
+    }
+    return DAMP_PASS;
+}
+
+int damp_timeout(void)
+{
+    uint64_t due_ns, ns;
+
+    if (damp.nevicted)
+        return 0;
+    if (!damp.damped)
+        return -1;
+    ns = now_ns();
+    due_ns = damp.start_ns + (uint64_t)damp.next_tick * 100000000ULL;
+    if (due_ns <= ns)
+        return 0;
+    return (due_ns - ns) / 1000000 < INT_MAX ? (int)((due_ns - ns) / 1000000 + 1) : INT_MAX;
+}
+
+/*
+ * Penalties only grow between sweeps, so next_tick may be early but is
+ * never late. The table is walked once it is due.
+ */
+void damp_sweep(void (*fn)(const struct rmon_rec_route *, unsigned int events, void *),
+                void *arg)
+{
+    struct damp_entry *e;
+    uint32_t tick, due, next = UINT32_MAX;
+    size_t i;
+    int s, w;
+
+    for (i = 0; i < damp.nevicted; i++) {
+        fn(damp.evicted_routes[i].route, damp.evicted_routes[i].events, arg);
+        free(damp.evicted_routes[i].route);
+    }
+    damp.nevicted = 0;
+
+    if (!damp.damped)
+        return;
+    tick = now_tick();
+    if (tick < damp.next_tick)
+        return;
+
+    for (s = 0; s < DAMP_SETS; s++) {
+        for (w = 0; w < DAMP_WAYS; w++) {
+            e = &damp.table[s][w];
+            if (!e->damped)
+                continue;
+            if (decayed(e, tick) >= DAMP_REUSE_LIMIT) {
+                due = reuse_tick(e);
+                if (due <= tick)
+                    due = tick + 1;
+                if (due < next)
+                    next = due;
+                continue;
+            }
+            e->penalty = decayed(e, tick);
+            e->tick = tick;
+            e->damped = 0;
+            damp.damped--;
+            fn(e->route, e->events, arg);
+            e->events = 0;
+            free(e->route);
+            e->route = NULL;
+        }
+    }
+    damp.next_tick = next;
+}
+
+void damp_report(FILE *f)
+{
+    if (!damp.half_life_ticks)
+        return;
+
+    fprintf(f, "Damping: damped routes: %llu summarized events: %llu evicted: %llu\n",
+            (unsigned long long)damp.damped, (unsigned long long)damp.summarized,
+            (unsigned long long)damp.evicted);
+}
@@ -0,0 +1,63 @@
+/*
+ * Route monitor - route flap damping
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_DAMP_H
+#define RMON_DAMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "rmon_proto.h"
+
+/*
+ * BGP-style flap damping (RFC 2439) per route key. Penalties decay
+ * exponentially and are only brought up to date when a key is touched.
+ * Keys live in a fixed-size set-associative table; when a set is full the
+ * entry with the lowest decayed penalty is recycled.
+ *
+ * A damped key keeps its route record so it can be released without
+ * another event: damp_sweep() hands over every key whose penalty has
+ * decayed below the reuse limit, and every damped key that was recycled.
+ */
+#define DAMP_PENALTY_WITHDRAW   1000
+#define DAMP_PENALTY_CHANGE     500
+#define DAMP_SUPPRESS_LIMIT     2000
+#define DAMP_REUSE_LIMIT        750
+#define DAMP_CEILING            12000
+
+enum damp_verdict {
+    DAMP_PASS,          /* report the event */
+    DAMP_REUSED,        /* report the event, the key is no longer damped */
+    DAMP_DAMPED,        /* report the event, the key is damped from now on */
+    DAMP_SUPPRESS,      /* key is damped, the event is only counted */
+};
+
+struct damp_info {
+    unsigned int penalty;
+    unsigned int events;    /* events summarized while damped */
+};
+
+void damp_init(unsigned int half_life);
+enum damp_verdict damp_update(uint64_t key, unsigned int penalty,
+                              const struct rmon_rec_route *route, struct damp_info *info);
+/* Milliseconds until damp_sweep() has keys to release, -1 if none is damped */
+int damp_timeout(void);
+void damp_sweep(void (*fn)(const struct rmon_rec_route *, unsigned int events, void *),
+                void *arg);
+void damp_report(FILE *f);
+
+#endif
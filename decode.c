@@ -0,0 +1,156 @@
+/*
+ * Route monitor - binary stream decoder
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "format.h"
+#include "rmon_reader.h"
+#include "rmon_ring.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [file]\n"
+            "Decodes an rmon binary event stream (stdin by default) into text.\n"
+            "  -r, --ring=PATH follow the shared memory ring of rmon --ring=PATH\n"
+            "  -v, --verbose   prefix every event with its sequence number and time\n"
+            "  -h, --help      show this help\n", prog);
+}
+
+static void print_rec(const struct rmon_rec_hdr *rec, int verbose)
+{
+    char line[1024];
+
+    rmon_format_text(rec, line, sizeof(line));
+    if (verbose)
+        printf("%llu %llu.%09llu ", (unsigned long long)rec->seq,
+               (unsigned long long)(rec->ts / 1000000000ULL),
+               (unsigned long long)(rec->ts % 1000000000ULL));
+    fputs(line, stdout);
+}
+
+static int follow_ring(const char *path, int verbose)
+{
+    const struct rmon_rec_hdr *rec;
+    static uint64_t copy[65536 / sizeof(uint64_t)];
+    struct rmon_ring_reader r;
+    int err;
+
+    err = rmon_ring_connect(&r, path);
+    if (err < 0) {
+        fprintf(stderr, "Unable to attach to ring %s: %s\n", path, strerror(-err));
+        return EXIT_FAILURE;
+    }
+
+    for (;;) {
+        err = rmon_ring_next(&r, &rec);
+        if (err > 0) {
+            /* Text output may block, so take the record out of the ring first */
+            memcpy(copy, rec, rec->len);
+            if (rmon_ring_intact(&r) && rmon_rec_check((void *)copy, rec->len) == 0)
+                print_rec((void *)copy, verbose);
+            continue;
+        }
+        if (err == -EOVERFLOW) {
+            fprintf(stderr, "Reader overrun, skipping to the newest event\n");
+            continue;
+        }
+
+        fflush(stdout);
+        err = rmon_ring_wait(&r, -1);
+        if (err < 0)
+            break;
+    }
+
+    fprintf(stderr, "Ring closed, overruns: %llu lost events: %llu\n",
+            (unsigned long long)r.overruns, (unsigned long long)r.lost);
+    rmon_ring_close(&r);
+    return err == -EPIPE ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "ring",    required_argument, NULL, 'r' },
+        { "verbose", no_argument, NULL, 'v' },
+        { "help",    no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    const struct rmon_rec_hdr *rec;
+    struct rmon_reader reader;
+    const char *ring_path = NULL;
+    int verbose = 0;
+    int fd = STDIN_FILENO;
+    int err, opt;
+
+    while ((opt = getopt_long(argc, argv, "r:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'r':
+            ring_path = optarg;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (ring_path)
+        return follow_ring(ring_path, verbose);
+
+    if (optind < argc) {
+        fd = open(argv[optind], O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Unable to open %s: %s\n", argv[optind], strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    err = rmon_reader_init(&reader, fd);
+    if (err < 0) {
+        fprintf(stderr, "Unable to allocate reader: %s\n", strerror(-err));
+        return EXIT_FAILURE;
+    }
+
+    while ((err = rmon_reader_next(&reader, &rec)) > 0) {
+        if (rec->type == RMON_REC_STREAM &&
+            ((const struct rmon_rec_stream *)rmon_rec_body(rec))->magic != RMON_PROTO_MAGIC) {
+            fprintf(stderr, "Stream byte order does not match this host\n");
+            err = -EPROTO;
+            break;
+        }
+        print_rec(rec, verbose);
+    }
+
+    rmon_reader_free(&reader);
+    if (err < 0) {
+        fprintf(stderr, "Decoding failed: %s\n", strerror(-err));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/*
+ * Route monitor - events
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/netlink.h>
+#include <netlink/route/nexthop.h>
+#include <string.h>
+#include <time.h>
+
+#include "event.h"
+
+static uint64_t last_seq;
+
+static void init_hdr(struct rmon_event *ev, uint8_t type, uint16_t len)
+{
+    memset(&ev->hdr, 0, sizeof(ev->hdr));
+    ev->hdr.len = len;
+    ev->hdr.version = RMON_PROTO_VERSION;
+    ev->hdr.type = type;
+}
+
+static uint8_t put_addr(uint8_t *out, struct nl_addr *addr)
+{
+    unsigned int len = addr ? nl_addr_get_len(addr) : 0;
+
+    if (len > 16)
+        return 0;
+    if (len)
+        memcpy(out, nl_addr_get_binary_addr(addr), len);
+    return len;
+}
+
+static void fill_nexthop(struct rtnl_nexthop *nh, void *arg)
+{
+    struct rmon_event *ev = arg;
+    struct rmon_rec_nh *rn;
+
+    if (ev->route.nnh >= RMON_EVENT_MAX_NH) {
+        ev->hdr.flags |= RMON_REC_F_TRUNCATED;
+        return;
+    }
+
+    rn = &ev->nh[ev->route.nnh++];
+    memset(rn, 0, sizeof(*rn));
+    rn->ifindex = rtnl_route_nh_get_ifindex(nh);
+    rn->weight = rtnl_route_nh_get_weight(nh);
+    rn->flags = rtnl_route_nh_get_flags(nh);
+    rn->gw_len = put_addr(rn->gw, rtnl_route_nh_get_gateway(nh));
+}
+
+void event_route(struct rmon_event *ev, uint8_t type, struct rtnl_route *route)
+{
+    struct rmon_rec_route *r = &ev->route;
+    struct nl_addr *dst = rtnl_route_get_dst(route);
+
+    init_hdr(ev, type, 0);
+    memset(r, 0, sizeof(*r));
+    r->family = rtnl_route_get_family(route);
+    r->tos = rtnl_route_get_tos(route);
+    r->protocol = rtnl_route_get_protocol(route);
+    r->scope = rtnl_route_get_scope(route);
+    r->rtype = rtnl_route_get_type(route);
+    r->table = rtnl_route_get_table(route);
+    r->priority = rtnl_route_get_priority(route);
+    if (dst) {
+        r->dst_len = nl_addr_get_prefixlen(dst);
+        r->dst_alen = put_addr(r->dst, dst);
+    }
+
+    rtnl_route_foreach_nexthop(route, fill_nexthop, ev);
+    ev->hdr.len = RMON_REC_ROUTE_LEN(r->nnh);
+}
+
+/* Turns a route addition into a move by appending the nexthops it replaced */
+void event_move(struct rmon_event *ev, const struct rmon_event *old)
+{
+    int room = RMON_EVENT_MAX_NH - ev->route.nnh;
+    int n = old->route.nnh;
+
+    if (n > room) {
+        n = room;
+        ev->hdr.flags |= RMON_REC_F_TRUNCATED;
+    }
+    memcpy(&ev->nh[ev->route.nnh], old->nh, n * sizeof(old->nh[0]));
+    ev->hdr.type = RMON_REC_ROUTE_MOVE;
+    ev->hdr.flags |= old->hdr.flags & RMON_REC_F_TRUNCATED;
+    ev->route.old_nnh = n;
+    ev->hdr.len = RMON_REC_ROUTE_LEN(ev->route.nnh + n);
+}
+
+/* Damped/reusable notes carry the route identity but no nexthops */
+void event_route_note(struct rmon_event *ev, const struct rmon_event *route_ev,
+                      uint8_t type, uint32_t aux)
+{
+    init_hdr(ev, type, RMON_REC_ROUTE_LEN(0));
+    ev->route = route_ev->route;
+    ev->route.nnh = 0;
+    ev->route.old_nnh = 0;
+    ev->route.aux = aux;
+}
+
+void event_link(struct rmon_event *ev, uint8_t type, struct rtnl_link *link)
+{
+    const char *name = rtnl_link_get_name(link);
+
+    init_hdr(ev, type, RMON_REC_LINK_LEN);
+    memset(&ev->link, 0, sizeof(ev->link));
+    ev->link.ifindex = rtnl_link_get_ifindex(link);
+    ev->link.flags = rtnl_link_get_flags(link);
+    ev->link.mtu = rtnl_link_get_mtu(link);
+    if (name)
+        strncpy(ev->link.name, name, sizeof(ev->link.name) - 1);
+}
+
+void event_addr(struct rmon_event *ev, uint8_t type, struct rtnl_addr *addr)
+{
+    struct nl_addr *local = rtnl_addr_get_local(addr);
+
+    init_hdr(ev, type, RMON_REC_ADDR_LEN);
+    memset(&ev->addr, 0, sizeof(ev->addr));
+    ev->addr.ifindex = rtnl_addr_get_ifindex(addr);
+    ev->addr.family = rtnl_addr_get_family(addr);
+    if (local) {
+        ev->addr.prefixlen = nl_addr_get_prefixlen(local);
+        ev->addr.alen = put_addr(ev->addr.local, local);
+    }
+}
+
+void event_stream(struct rmon_event *ev)
+{
+    struct timespec ts;
+
+    init_hdr(ev, RMON_REC_STREAM, RMON_REC_STREAM_LEN);
+    memset(&ev->stream, 0, sizeof(ev->stream));
+    ev->stream.magic = RMON_PROTO_MAGIC;
+    ev->stream.hdr_len = sizeof(struct rmon_rec_hdr);
+    ev->stream.start_seq = last_seq + 1;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ev->hdr.ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Not an event itself, so it carries no sequence number */
+void event_dropped(struct rmon_event *ev, uint64_t events, uint64_t first_seq)
+{
+    struct timespec ts;
+
+    init_hdr(ev, RMON_REC_DROPPED, RMON_REC_DROPPED_LEN);
+    ev->dropped.events = events;
+    ev->dropped.first_seq = first_seq;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ev->hdr.ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void event_snapshot(struct rmon_event *ev, uint8_t type, uint64_t seq, uint64_t records)
+{
+    struct timespec ts;
+
+    init_hdr(ev, type, RMON_REC_SNAPSHOT_LEN);
+    ev->hdr.seq = seq;
+    ev->snapshot.seq = seq;
+    ev->snapshot.records = records;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ev->hdr.ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void event_startup(struct rmon_event *ev, const struct rmon_rec_startup *startup)
+{
+    init_hdr(ev, RMON_REC_STARTUP, RMON_REC_STARTUP_LEN);
+    ev->startup = *startup;
+}
+
+/* Marks an event as current state, consistent with the last stamped event */
+void event_snapshot_state(struct rmon_event *ev, uint64_t ts)
+{
+    ev->hdr.flags |= RMON_REC_F_SNAPSHOT;
+    ev->hdr.seq = last_seq;
+    ev->hdr.ts = ts;
+}
+
+/* Assigns the next stream sequence number and the emission time */
+void event_stamp(struct rmon_event *ev)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ev->hdr.seq = ++last_seq;
+    ev->hdr.ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t event_last_seq(void)
+{
+    return last_seq;
+}
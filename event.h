@@ -0,0 +1,65 @@
+/*
+ * Route monitor - events
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_EVENT_H
+#define RMON_EVENT_H
+
+#include <netlink/route/route.h>
+#include <netlink/route/link.h>
+#include <netlink/route/addr.h>
+
+#include "rmon_proto.h"
+
+#define RMON_EVENT_MAX_NH   16
+
+/*
+ * An event is built directly in its binary record layout, so the binary
+ * output is a plain copy and every other format reads the same fields.
+ */
+struct rmon_event {
+    struct rmon_rec_hdr hdr;
+    union {
+        struct {
+            struct rmon_rec_route route;
+            struct rmon_rec_nh nh[RMON_EVENT_MAX_NH];
+        };
+        struct rmon_rec_link link;
+        struct rmon_rec_addr addr;
+        struct rmon_rec_stream stream;
+        struct rmon_rec_dropped dropped;
+        struct rmon_rec_snapshot snapshot;
+        struct rmon_rec_startup startup;
+    };
+    struct rmon_rec_latency latency_room;   /* trailer of a full route record */
+};
+
+void event_route(struct rmon_event *ev, uint8_t type, struct rtnl_route *route);
+void event_move(struct rmon_event *ev, const struct rmon_event *old);
+void event_route_note(struct rmon_event *ev, const struct rmon_event *route_ev,
+                      uint8_t type, uint32_t aux);
+void event_link(struct rmon_event *ev, uint8_t type, struct rtnl_link *link);
+void event_addr(struct rmon_event *ev, uint8_t type, struct rtnl_addr *addr);
+void event_stream(struct rmon_event *ev);
+void event_dropped(struct rmon_event *ev, uint64_t events, uint64_t first_seq);
+void event_snapshot(struct rmon_event *ev, uint8_t type, uint64_t seq, uint64_t records);
+void event_snapshot_state(struct rmon_event *ev, uint64_t ts);
+void event_startup(struct rmon_event *ev, const struct rmon_rec_startup *startup);
+
+void event_stamp(struct rmon_event *ev);
+uint64_t event_last_seq(void);
+
+#endif
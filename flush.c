@@ -0,0 +1,73 @@
+/*
+ * Route monitor - routes the kernel flushes silently
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/route/nexthop.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "flush.h"
+
+struct nh_match {
+    int ifindex;
+    int total;
+    int matched;
+};
+
+static void match_nexthop(struct rtnl_nexthop *nh, void *arg)
+{
+    struct nh_match *m = arg;
+
+    m->total++;
+    if (rtnl_route_nh_get_ifindex(nh) == m->ifindex)
+        m->matched++;
+}
+
+static int same_addr(struct nl_addr *a, struct nl_addr *b)
+{
+    return a && b && nl_addr_get_len(a) == nl_addr_get_len(b) &&
+           !memcmp(nl_addr_get_binary_addr(a), nl_addr_get_binary_addr(b), nl_addr_get_len(a));
+}
+
+void flush_scan(struct nl_cache *route_cache, int ifindex, int flags, struct nl_addr *prefsrc,
+                void (*fn)(struct rtnl_route *, void *), void *arg)
+{
+    struct nl_object *obj, *next;
+    struct rtnl_route *route;
+    struct nh_match m;
+
+    for (obj = nl_cache_get_first(route_cache); obj; obj = next) {
+        next = nl_cache_get_next(obj);
+        route = (struct rtnl_route *)obj;
+
+        if (rtnl_route_get_family(route) != AF_INET)
+            continue;
+
+        m.ifindex = ifindex;
+        m.total = m.matched = 0;
+        rtnl_route_foreach_nexthop(route, match_nexthop, &m);
+
+        if (!same_addr(prefsrc, rtnl_route_get_pref_src(route))) {
+            if (!m.matched)
+                continue;
+            if (!(flags & FLUSH_ANY_NH) && m.matched != m.total)
+                continue;
+            if ((flags & FLUSH_KEEP_LOCAL) && rtnl_route_get_type(route) == RTN_LOCAL)
+                continue;
+        }
+        fn(route, arg);
+    }
+}
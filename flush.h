@@ -0,0 +1,36 @@
+/*
+ * Route monitor - routes the kernel flushes silently
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_FLUSH_H
+#define RMON_FLUSH_H
+
+#include <netlink/cache.h>
+#include <netlink/route/route.h>
+
+/* Which routes through an interface the kernel flushes, see fib_sync_down_dev() */
+#define FLUSH_ANY_NH        0x1     /* a nexthop via the interface is enough */
+#define FLUSH_KEEP_LOCAL    0x2     /* local routes survive (link down) */
+
+/*
+ * Calls fn for every IPv4 route of the cache the kernel flushed when
+ * ifindex went down or lost its last address, or for which prefsrc was
+ * the preferred source. fn may remove the route from the cache.
+ */
+void flush_scan(struct nl_cache *route_cache, int ifindex, int flags, struct nl_addr *prefsrc,
+                void (*fn)(struct rtnl_route *, void *), void *arg);
+
+#endif
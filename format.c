@@ -0,0 +1,234 @@
+/*
+ * Route monitor - event formatting
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "format.h"
+
+#define ADDR_STRLEN     (INET6_ADDRSTRLEN + 5)
+
+static const char *route_verbs[RMON_REC_MAX] = {
+    [RMON_REC_ROUTE_ADD] = "added",
+    [RMON_REC_ROUTE_DEL] = "deleted",
+    [RMON_REC_ROUTE_CHANGE] = "changed",
+    [RMON_REC_ROUTE_INVALIDATE] = "invalidated",
+};
+
+static const char *link_verbs[RMON_REC_MAX] = {
+    [RMON_REC_LINK_ADD] = "added",
+    [RMON_REC_LINK_DEL] = "deleted",
+    [RMON_REC_LINK_CHANGE] = "changed",
+};
+
+static const char *type_names[RMON_REC_MAX] = {
+    [RMON_REC_STREAM] = "stream",
+    [RMON_REC_ROUTE_ADD] = "route_add",
+    [RMON_REC_ROUTE_DEL] = "route_del",
+    [RMON_REC_ROUTE_CHANGE] = "route_change",
+    [RMON_REC_ROUTE_MOVE] = "route_move",
+    [RMON_REC_ROUTE_INVALIDATE] = "route_invalidate",
+    [RMON_REC_ROUTE_DAMPED] = "route_damped",
+    [RMON_REC_ROUTE_REUSABLE] = "route_reusable",
+    [RMON_REC_LINK_ADD] = "link_add",
+    [RMON_REC_LINK_DEL] = "link_del",
+    [RMON_REC_LINK_CHANGE] = "link_change",
+    [RMON_REC_ADDR_DEL] = "addr_del",
+    [RMON_REC_DROPPED] = "dropped",
+    [RMON_REC_ADDR_ADD] = "addr_add",
+    [RMON_REC_SNAPSHOT_BEGIN] = "snapshot_begin",
+    [RMON_REC_SNAPSHOT_END] = "snapshot_end",
+    [RMON_REC_STARTUP] = "startup",
+};
+
+static const char *phase_names[RMON_STARTUP_PHASES] = {
+    [RMON_STARTUP_SOCKET] = "socket",
+    [RMON_STARTUP_ROUTE_DUMP] = "route_dump",
+    [RMON_STARTUP_INDEX] = "index",
+    [RMON_STARTUP_LINK_DUMP] = "link_dump",
+    [RMON_STARTUP_ADDR_DUMP] = "addr_dump",
+    [RMON_STARTUP_FIRST_EVENT] = "first_event",
+};
+
+/* Short snake_case name of a record type, NULL if unknown */
+const char *rmon_rec_type_name(unsigned int type)
+{
+    return type < RMON_REC_MAX ? type_names[type] : NULL;
+}
+
+const char *rmon_startup_phase_name(unsigned int phase)
+{
+    return phase < RMON_STARTUP_PHASES ? phase_names[phase] : NULL;
+}
+
+/* Same rendering as nl_addr2str(): "none" without address, no full-length prefix */
+char *rmon_format_addr(char *buf, size_t len, uint8_t family, const uint8_t *addr,
+                       uint8_t alen, unsigned int prefixlen)
+{
+    size_t n;
+
+    if (!alen) {
+        if (prefixlen)
+            snprintf(buf, len, "none/%u", prefixlen);
+        else
+            snprintf(buf, len, "none");
+        return buf;
+    }
+
+    if (!inet_ntop(alen == 16 ? AF_INET6 : AF_INET, addr, buf, len))
+        snprintf(buf, len, "invalid");
+    if (prefixlen != alen * 8u) {
+        n = strlen(buf);
+        snprintf(buf + n, len - n, "/%u", prefixlen);
+    }
+    return buf;
+}
+
+static void nexthop_str(const struct rmon_rec_route *r, const struct rmon_rec_nh *nh,
+                        int *ifindex, char *gw)
+{
+    *ifindex = -1;
+    strcpy(gw, "none");
+    if (nh) {
+        *ifindex = nh->ifindex;
+        if (nh->gw_len)
+            rmon_format_addr(gw, ADDR_STRLEN, r->family, nh->gw, nh->gw_len, nh->gw_len * 8);
+    }
+}
+
+static int format_route(const struct rmon_rec_hdr *rec, char *buf, size_t len)
+{
+    const struct rmon_rec_route *r = rmon_rec_body(rec);
+    const struct rmon_rec_nh *nh = rmon_rec_nexthops(rec);
+    char dst[ADDR_STRLEN], gw[ADDR_STRLEN], old_gw[ADDR_STRLEN];
+    int ifindex, old_ifindex;
+
+    rmon_format_addr(dst, sizeof(dst), r->family, r->dst, r->dst_alen, r->dst_len);
+
+    switch (rec->type) {
+    case RMON_REC_ROUTE_DAMPED:
+        return snprintf(buf, len, "Route damped: destination: %s penalty: %u\n", dst, r->aux);
+    case RMON_REC_ROUTE_REUSABLE:
+        return snprintf(buf, len, "Route reusable: destination: %s suppressed events: %u\n",
+                        dst, r->aux);
+    case RMON_REC_ROUTE_MOVE:
+        nexthop_str(r, r->nnh ? &nh[0] : NULL, &ifindex, gw);
+        nexthop_str(r, r->old_nnh ? &nh[r->nnh] : NULL, &old_ifindex, old_gw);
+        return snprintf(buf, len,
+                        "Route moved: destination: %s oif: %d -> %d gateway: %s -> %s metric: %d\n",
+                        dst, old_ifindex, ifindex, old_gw, gw, (int)r->priority);
+    default:
+        nexthop_str(r, r->nnh ? &nh[0] : NULL, &ifindex, gw);
+        return snprintf(buf, len, "Route %s: destination: %s oif: %d gateway: %s metric: %d\n",
+                        rec->flags & RMON_REC_F_SNAPSHOT ? "present" : route_verbs[rec->type],
+                        dst, ifindex, gw, (int)r->priority);
+    }
+}
+
+static int format_startup(const struct rmon_rec_hdr *rec, char *buf, size_t len)
+{
+    const struct rmon_rec_startup *s = rmon_rec_body(rec);
+    const struct rmon_rec_startup_phase *p = s->phase;
+
+    return snprintf(buf, len,
+                    "Startup: ready in %.3f ms socket: %.3f ms route dump: %.3f ms routes: %llu "
+                    "index: %.3f ms link dump: %.3f ms links: %llu addr dump: %.3f ms "
+                    "addresses: %llu first event after %.3f ms\n",
+                    s->ready_ns / 1e6, p[RMON_STARTUP_SOCKET].ns / 1e6,
+                    p[RMON_STARTUP_ROUTE_DUMP].ns / 1e6,
+                    (unsigned long long)p[RMON_STARTUP_ROUTE_DUMP].objects,
+                    p[RMON_STARTUP_INDEX].ns / 1e6, p[RMON_STARTUP_LINK_DUMP].ns / 1e6,
+                    (unsigned long long)p[RMON_STARTUP_LINK_DUMP].objects,
+                    p[RMON_STARTUP_ADDR_DUMP].ns / 1e6,
+                    (unsigned long long)p[RMON_STARTUP_ADDR_DUMP].objects,
+                    p[RMON_STARTUP_FIRST_EVENT].ns / 1e6);
+}
+
+static int format_text(const struct rmon_rec_hdr *rec, char *buf, size_t len)
+{
+    char local[ADDR_STRLEN];
+
+    if (rmon_rec_is_route(rec))
+        return format_route(rec, buf, len);
+
+    if (rmon_rec_is_link(rec)) {
+        const struct rmon_rec_link *l = rmon_rec_body(rec);
+
+        return snprintf(buf, len, "Link %s, index: %d\n",
+                        rec->flags & RMON_REC_F_SNAPSHOT ? "present" : link_verbs[rec->type],
+                        l->ifindex);
+    }
+
+    if (rmon_rec_is_addr(rec)) {
+        const struct rmon_rec_addr *a = rmon_rec_body(rec);
+
+        rmon_format_addr(local, sizeof(local), a->family, a->local, a->alen, a->prefixlen);
+        return snprintf(buf, len, "Address %s: %s on interface %d\n",
+                        rec->flags & RMON_REC_F_SNAPSHOT ? "present" :
+                        rec->type == RMON_REC_ADDR_ADD ? "added" : "deleted", local, a->ifindex);
+    }
+
+    if (rec->type == RMON_REC_SNAPSHOT_BEGIN || rec->type == RMON_REC_SNAPSHOT_END) {
+        const struct rmon_rec_snapshot *snap = rmon_rec_body(rec);
+
+        if (rec->type == RMON_REC_SNAPSHOT_BEGIN)
+            return snprintf(buf, len, "Snapshot begin, sequence %llu\n",
+                            (unsigned long long)snap->seq);
+        return snprintf(buf, len, "Snapshot end, sequence %llu records: %llu\n",
+                        (unsigned long long)snap->seq, (unsigned long long)snap->records);
+    }
+
+    if (rec->type == RMON_REC_STREAM)
+        return snprintf(buf, len, "Stream version %u, first sequence %llu\n", rec->version,
+                        (unsigned long long)((const struct rmon_rec_stream *)rmon_rec_body(rec))->start_seq);
+
+    if (rec->type == RMON_REC_DROPPED) {
+        const struct rmon_rec_dropped *d = rmon_rec_body(rec);
+
+        return snprintf(buf, len, "Dropped %llu events, first sequence %llu\n",
+                        (unsigned long long)d->events, (unsigned long long)d->first_seq);
+    }
+
+    if (rec->type == RMON_REC_STARTUP)
+        return format_startup(rec, buf, len);
+
+    return snprintf(buf, len, "Unknown record type %u\n", rec->type);
+}
+
+int rmon_format_text(const struct rmon_rec_hdr *rec, char *buf, size_t len)
+{
+    const struct rmon_rec_latency *lat = rmon_rec_latency(rec);
+    int n = format_text(rec, buf, len);
+    int m;
+
+    if (!lat || n <= 0)
+        return n;
+
+    /* Goes in place of the newline */
+    n--;
+    m = snprintf((size_t)n < len ? buf + n : NULL, (size_t)n < len ? len - n : 0,
+                 " latency: %.1f us\n", lat->total_ns / 1e3);
+    return m < 0 ? m : n + m;
+}
+
+int rmon_format_binary(const struct rmon_rec_hdr *rec, char *buf, size_t len)
+{
+    if (rec->len <= len)
+        memcpy(buf, rec, rec->len);
+    return rec->len;
+}
@@ -0,0 +1,38 @@
+/*
+ * Route monitor - event formatting
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_FORMAT_H
+#define RMON_FORMAT_H
+
+#include <stddef.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Formatters render one record into buf and follow snprintf() semantics:
+ * they return the length the full output needs, which may exceed len.
+ */
+int rmon_format_text(const struct rmon_rec_hdr *rec, char *buf, size_t len);
+int rmon_format_binary(const struct rmon_rec_hdr *rec, char *buf, size_t len);
+int rmon_format_jsonl(const struct rmon_rec_hdr *rec, char *buf, size_t len);
+
+const char *rmon_rec_type_name(unsigned int type);
+const char *rmon_startup_phase_name(unsigned int phase);
+char *rmon_format_addr(char *buf, size_t len, uint8_t family, const uint8_t *addr,
+                       uint8_t alen, unsigned int prefixlen);
+
+#endif
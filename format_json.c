@@ -0,0 +1,290 @@
+/*
+ * Route monitor - JSON Lines formatting
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "format.h"
+
+/*
+ * Writes straight into the caller's buffer. Once something doesn't fit,
+ * only the length is counted, like snprintf() does.
+ */
+struct jw {
+    char *p;
+    char *end;
+    size_t n;
+};
+
+static void jw_mem(struct jw *w, const char *s, size_t len)
+{
+    if ((size_t)(w->end - w->p) >= len) {
+        memcpy(w->p, s, len);
+        w->p += len;
+    } else {
+        w->p = w->end;
+    }
+    w->n += len;
+}
+
+#define jw_lit(w, s)    jw_mem(w, s, sizeof(s) - 1)
+
+/* Two digits at a time, timestamps have 19 of them */
+static void jw_u64(struct jw *w, uint64_t v)
+{
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[20], *p = tmp + sizeof(tmp);
+
+    while (v >= 100) {
+        p -= 2;
+        memcpy(p, pairs + v % 100 * 2, 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, pairs + v * 2, 2);
+    } else {
+        *--p = '0' + v;
+    }
+    jw_mem(w, p, tmp + sizeof(tmp) - p);
+}
+
+static void jw_i64(struct jw *w, int64_t v)
+{
+    if (v < 0) {
+        jw_lit(w, "-");
+        jw_u64(w, -(uint64_t)v);
+    } else {
+        jw_u64(w, v);
+    }
+}
+
+/* Keys are literals that never need escaping */
+#define jw_key(w, key)  jw_lit(w, ",\"" key "\":")
+
+#define jw_key_u64(w, key, v) \
+    do { \
+        jw_key(w, key); \
+        jw_u64(w, v); \
+    } while (0)
+
+static void jw_str(struct jw *w, const char *s, size_t max)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *start;
+    char esc[6];
+    size_t i;
+
+    jw_lit(w, "\"");
+    for (i = 0, start = s; i < max && s[i]; i++) {
+        unsigned char c = s[i];
+
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        jw_mem(w, start, s + i - start);
+        start = s + i + 1;
+        esc[0] = '\\';
+        if (c == '"' || c == '\\') {
+            esc[1] = c;
+            jw_mem(w, esc, 2);
+        } else {
+            memcpy(esc + 1, "u00", 3);
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xf];
+            jw_mem(w, esc, 6);
+        }
+    }
+    jw_mem(w, start, s + i - start);
+    jw_lit(w, "\"");
+}
+
+/* A quoted address, or null without one */
+static void jw_addr(struct jw *w, const uint8_t *addr, uint8_t alen)
+{
+    char buf[INET6_ADDRSTRLEN + 2], *p = buf;
+    int i;
+
+    if (alen == 4) {
+        *p++ = '"';
+        for (i = 0; i < 4; i++) {
+            if (addr[i] >= 100)
+                *p++ = '0' + addr[i] / 100;
+            if (addr[i] >= 10)
+                *p++ = '0' + addr[i] / 10 % 10;
+            *p++ = '0' + addr[i] % 10;
+            *p++ = i < 3 ? '.' : '"';
+        }
+        jw_mem(w, buf, p - buf);
+    } else if (alen == 16 && inet_ntop(AF_INET6, addr, buf + 1, sizeof(buf) - 2)) {
+        buf[0] = '"';
+        p = buf + strlen(buf);
+        *p++ = '"';
+        jw_mem(w, buf, p - buf);
+    } else {
+        jw_lit(w, "null");
+    }
+}
+
+static void jw_nexthops(struct jw *w, const struct rmon_rec_nh *nh, int n)
+{
+    int i;
+
+    jw_lit(w, "[");
+    for (i = 0; i < n; i++) {
+        if (i)
+            jw_lit(w, ",");
+        jw_lit(w, "{\"ifindex\":");
+        jw_i64(w, nh[i].ifindex);
+        jw_key(w, "gateway");
+        jw_addr(w, nh[i].gw, nh[i].gw_len);
+        jw_key_u64(w, "weight", nh[i].weight);
+        jw_key_u64(w, "flags", nh[i].flags);
+        jw_lit(w, "}");
+    }
+    jw_lit(w, "]");
+}
+
+static void json_route(struct jw *w, const struct rmon_rec_hdr *rec)
+{
+    const struct rmon_rec_route *r = rmon_rec_body(rec);
+    const struct rmon_rec_nh *nh = rmon_rec_nexthops(rec);
+
+    jw_key_u64(w, "family", r->family);
+    jw_key(w, "dst");
+    jw_addr(w, r->dst, r->dst_alen);
+    jw_key_u64(w, "dst_len", r->dst_len);
+    jw_key_u64(w, "tos", r->tos);
+    jw_key_u64(w, "table", r->table);
+    jw_key_u64(w, "protocol", r->protocol);
+    jw_key_u64(w, "scope", r->scope);
+    jw_key_u64(w, "rtype", r->rtype);
+    jw_key_u64(w, "metric", r->priority);
+    jw_key(w, "nexthops");
+    jw_nexthops(w, nh, r->nnh);
+    if (rec->type == RMON_REC_ROUTE_MOVE) {
+        jw_key(w, "old_nexthops");
+        jw_nexthops(w, nh + r->nnh, r->old_nnh);
+    } else if (rec->type == RMON_REC_ROUTE_DAMPED) {
+        jw_key_u64(w, "penalty", r->aux);
+    } else if (rec->type == RMON_REC_ROUTE_REUSABLE) {
+        jw_key_u64(w, "suppressed", r->aux);
+    }
+}
+
+/*
+ * One object per line: seq, ts (CLOCK_REALTIME ns) and event name, then
+ * the fields of the record. Records are assumed to be checked already.
+ */
+int rmon_format_jsonl(const struct rmon_rec_hdr *rec, char *buf, size_t len)
+{
+    struct jw w = { buf, buf + len, 0 };
+    const struct rmon_rec_latency *lat;
+    const char *name;
+    int i;
+
+    jw_lit(&w, "{\"seq\":");
+    jw_u64(&w, rec->seq);
+    jw_key_u64(&w, "ts", rec->ts);
+    jw_key(&w, "event");
+    name = rmon_rec_type_name(rec->type);
+    if (name) {
+        jw_lit(&w, "\"");
+        jw_mem(&w, name, strlen(name));
+        jw_lit(&w, "\"");
+    } else {
+        jw_lit(&w, "null");
+        jw_key_u64(&w, "type", rec->type);
+    }
+    if (rec->flags & RMON_REC_F_SNAPSHOT)
+        jw_lit(&w, ",\"snapshot\":true");
+    if (rec->flags & RMON_REC_F_TRUNCATED)
+        jw_lit(&w, ",\"truncated\":true");
+
+    if (rmon_rec_is_route(rec)) {
+        json_route(&w, rec);
+    } else if (rmon_rec_is_link(rec)) {
+        const struct rmon_rec_link *l = rmon_rec_body(rec);
+
+        jw_key(&w, "ifindex");
+        jw_i64(&w, l->ifindex);
+        jw_key(&w, "name");
+        jw_str(&w, l->name, sizeof(l->name));
+        jw_key_u64(&w, "flags", l->flags);
+        jw_key_u64(&w, "mtu", l->mtu);
+    } else if (rmon_rec_is_addr(rec)) {
+        const struct rmon_rec_addr *a = rmon_rec_body(rec);
+
+        jw_key(&w, "ifindex");
+        jw_i64(&w, a->ifindex);
+        jw_key_u64(&w, "family", a->family);
+        jw_key(&w, "local");
+        jw_addr(&w, a->local, a->alen);
+        jw_key_u64(&w, "prefixlen", a->prefixlen);
+    } else if (rec->type == RMON_REC_SNAPSHOT_BEGIN || rec->type == RMON_REC_SNAPSHOT_END) {
+        const struct rmon_rec_snapshot *snap = rmon_rec_body(rec);
+
+        jw_key_u64(&w, "snapshot_seq", snap->seq);
+        if (rec->type == RMON_REC_SNAPSHOT_END)
+            jw_key_u64(&w, "records", snap->records);
+    } else if (rec->type == RMON_REC_STREAM) {
+        const struct rmon_rec_stream *s = rmon_rec_body(rec);
+
+        jw_key_u64(&w, "version", rec->version);
+        jw_key_u64(&w, "start_seq", s->start_seq);
+    } else if (rec->type == RMON_REC_DROPPED) {
+        const struct rmon_rec_dropped *d = rmon_rec_body(rec);
+
+        jw_key_u64(&w, "events", d->events);
+        jw_key_u64(&w, "first_seq", d->first_seq);
+    } else if (rec->type == RMON_REC_STARTUP) {
+        const struct rmon_rec_startup *s = rmon_rec_body(rec);
+
+        jw_key_u64(&w, "ready_ns", s->ready_ns);
+        jw_lit(&w, ",\"phases\":{");
+        for (i = 0; i < RMON_STARTUP_PHASES; i++) {
+            name = rmon_startup_phase_name(i);
+            if (i)
+                jw_lit(&w, ",");
+            jw_lit(&w, "\"");
+            jw_mem(&w, name, strlen(name));
+            jw_lit(&w, "\":{\"ns\":");
+            jw_u64(&w, s->phase[i].ns);
+            jw_key_u64(&w, "objects", s->phase[i].objects);
+            jw_lit(&w, "}");
+        }
+        jw_lit(&w, "}");
+    }
+    lat = rmon_rec_latency(rec);
+    if (lat) {
+        jw_lit(&w, ",\"latency\":{\"total_ns\":");
+        jw_u64(&w, lat->total_ns);
+        jw_key_u64(&w, "lane_ns", lat->lane_ns);
+        jw_key_u64(&w, "parse_ns", lat->parse_ns);
+        jw_key_u64(&w, "handle_ns", lat->handle_ns);
+        jw_lit(&w, "}");
+    }
+    jw_lit(&w, "}\n");
+
+    if (w.n < len)
+        buf[w.n] = '\0';
+    else if (len)
+        buf[len - 1] = '\0';
+    return w.n;
+}
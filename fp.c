@@ -0,0 +1,204 @@
+/*
+ * Route monitor - route fingerprints
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/netlink.h>
+#include <netlink/route/route.h>
+#include <netlink/route/nexthop.h>
+#include <stdlib.h>
+
+#include "fp.h"
+#include "hash.h"
+#include "mem.h"
+
+struct fp_entry {
+    uint64_t key;
+    uint64_t fp;
+};
+
+static struct {
+    struct fp_entry *slots;
+    size_t cap;
+    size_t used;
+    uint64_t suppressed;
+} fp;
+
+static uint64_t hash_addr(uint64_t h, struct nl_addr *addr)
+{
+    unsigned int prefixlen;
+
+    if (!addr)
+        return hash_bytes(h, "", 1);
+
+    prefixlen = nl_addr_get_prefixlen(addr);
+    h = hash_bytes(h, &prefixlen, sizeof(prefixlen));
+    return hash_bytes(h, nl_addr_get_binary_addr(addr), nl_addr_get_len(addr));
+}
+
+uint64_t fp_route_key(struct rtnl_route *route)
+{
+    struct nl_addr *dst = rtnl_route_get_dst(route);
+
+    return hash_route_key(rtnl_route_get_family(route), rtnl_route_get_tos(route),
+                          rtnl_route_get_table(route),
+                          dst ? nl_addr_get_prefixlen(dst) : 0,
+                          dst ? nl_addr_get_binary_addr(dst) : NULL,
+                          dst ? nl_addr_get_len(dst) : 0,
+                          rtnl_route_get_priority(route));
+}
+
+static void hash_nexthop(struct rtnl_nexthop *nh, void *arg)
+{
+    uint64_t *h = arg;
+    int ifindex = rtnl_route_nh_get_ifindex(nh);
+    unsigned int flags = rtnl_route_nh_get_flags(nh);
+    uint8_t weight = rtnl_route_nh_get_weight(nh);
+
+    *h = hash_bytes(*h, &ifindex, sizeof(ifindex));
+    *h = hash_bytes(*h, &flags, sizeof(flags));
+    *h = hash_bytes(*h, &weight, sizeof(weight));
+    *h = hash_addr(*h, rtnl_route_nh_get_gateway(nh));
+}
+
+uint64_t fp_route_fingerprint(struct rtnl_route *route)
+{
+    uint64_t h = HASH_INIT;
+    uint8_t type = rtnl_route_get_type(route);
+    uint8_t protocol = rtnl_route_get_protocol(route);
+    uint8_t scope = rtnl_route_get_scope(route);
+    uint32_t flags = rtnl_route_get_flags(route);
+
+    h = hash_bytes(h, &type, sizeof(type));
+    h = hash_bytes(h, &protocol, sizeof(protocol));
+    h = hash_bytes(h, &scope, sizeof(scope));
+    h = hash_bytes(h, &flags, sizeof(flags));
+    h = hash_addr(h, rtnl_route_get_pref_src(route));
+    rtnl_route_foreach_nexthop(route, hash_nexthop, &h);
+    return h;
+}
+
+/* Linear probing, key 0 marks an empty slot (route keys always have bit 0 set) */
+static struct fp_entry *slot(uint64_t key)
+{
+    size_t mask = fp.cap - 1;
+    size_t i = key & mask;
+
+    while (fp.slots[i].key && fp.slots[i].key != key)
+        i = (i + 1) & mask;
+    return &fp.slots[i];
+}
+
+static int resize(size_t cap)
+{
+    struct fp_entry *old = fp.slots;
+    size_t old_cap = fp.cap;
+    size_t i;
+
+    fp.slots = mem_calloc(MEM_FP, cap, sizeof(*fp.slots));
+    if (!fp.slots) {
+        fp.slots = old;
+        return -NLE_NOMEM;
+    }
+    fp.cap = cap;
+    for (i = 0; i < old_cap; i++)
+        if (old[i].key)
+            *slot(old[i].key) = old[i];
+    free(old);
+    return 0;
+}
+
+/* Returns 1 if the stored fingerprint already matched, 0 if it was updated */
+int fp_update(uint64_t key, uint64_t fingerprint)
+{
+    struct fp_entry *e;
+
+    if (2 * (fp.used + 1) > fp.cap && resize(fp.cap ? 2 * fp.cap : 1024) < 0)
+        return 0;
+
+    e = slot(key);
+    if (e->key) {
+        if (e->fp == fingerprint)
+            return 1;
+    } else {
+        e->key = key;
+        fp.used++;
+    }
+    e->fp = fingerprint;
+    return 0;
+}
+
+void fp_forget(uint64_t key)
+{
+    size_t mask = fp.cap - 1;
+    size_t i, j, home;
+
+    if (!fp.cap)
+        return;
+
+    i = slot(key) - fp.slots;
+    if (!fp.slots[i].key)
+        return;
+
+    /* Backward shift deletion keeps probe chains intact without tombstones */
+    for (j = (i + 1) & mask; fp.slots[j].key; j = (j + 1) & mask) {
+        home = fp.slots[j].key & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            fp.slots[i] = fp.slots[j];
+            i = j;
+        }
+    }
+    fp.slots[i].key = 0;
+    fp.used--;
+}
+
+void fp_seed(struct nl_cache *route_cache)
+{
+    struct nl_object *obj;
+
+    for (obj = nl_cache_get_first(route_cache); obj; obj = nl_cache_get_next(obj)) {
+        struct rtnl_route *route = (struct rtnl_route *)obj;
+
+        if (rtnl_route_get_family(route) != AF_INET)
+            continue;
+        fp_update(fp_route_key(route), fp_route_fingerprint(route));
+    }
+}
+
+size_t fp_count(void)
+{
+    return fp.used;
+}
+
+/* The table fp_update() grows to for n routes */
+size_t fp_table_bytes(size_t n)
+{
+    size_t cap = 1024;
+
+    while (2 * n > cap)
+        cap *= 2;
+    return cap * sizeof(struct fp_entry);
+}
+
+void fp_suppressed(void)
+{
+    fp.suppressed++;
+}
+
+void fp_report(FILE *f)
+{
+    fprintf(f, "Route fingerprints: %zu suppressed changes: %llu\n",
+            fp.used, (unsigned long long)fp.suppressed);
+}
@@ -0,0 +1,42 @@
+/*
+ * Route monitor - route fingerprints
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_FP_H
+#define RMON_FP_H
+
+#include <netlink/route/route.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Every known route is remembered as a 64-bit key (the route identity) and
+ * a 64-bit fingerprint of the attributes rmon reports on. A change whose
+ * fingerprint matches the stored one is a no-op replacement.
+ */
+uint64_t fp_route_key(struct rtnl_route *route);
+uint64_t fp_route_fingerprint(struct rtnl_route *route);
+
+int fp_update(uint64_t key, uint64_t fp);
+void fp_forget(uint64_t key);
+void fp_seed(struct nl_cache *route_cache);
+size_t fp_count(void);
+size_t fp_table_bytes(size_t n);
+
+void fp_suppressed(void);
+void fp_report(FILE *f);
+
+#endif
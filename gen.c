@@ -0,0 +1,177 @@
+/*
+ * Route monitor - synthetic workload generator
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <linux/if_arp.h>
+#include <linux/if_packet.h>
+#include <linux/netlink.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rmon_pcap.h"
+#include "workload.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] FILE\n"
+            "Writes a synthetic rtnetlink workload as a capture for rmon --from-capture.\n"
+            "  -n, --routes=N         IPv4 routes in the table (default 10000)\n"
+            "  -k, --links=N          links, each with an address (default 16)\n"
+            "  -e, --ecmp=N           nexthops per route (default 1)\n"
+            "  -f, --flap-rate=N      route withdrawals per second (default 0)\n"
+            "  -g, --flap-gap=MS      until a withdrawn route is announced again\n"
+            "                         over the next link (default 100)\n"
+            "  -d, --duration=MS      time the flaps and reloads are spread over\n"
+            "                         (default 10000)\n"
+            "  -r, --reloads=N        full table reloads (default 0)\n"
+            "  -w, --link-downs=N     links taken down at the end, each right after\n"
+            "                         a route over it is announced (default 0)\n"
+            "  -x, --link-deletes=N   links deleted at the end (default 0)\n"
+            "  -b, --batch=N          most notifications read at once (default 64)\n"
+            "  -s, --seed=N           random seed (default 1)\n"
+            "  -h, --help             show this help\n"
+            "FILE - writes to standard output.\n", prog);
+}
+
+static int write_packet(void *arg, const void *buf, size_t len, uint64_t ts, uint64_t batch)
+{
+    struct rmon_pcap_nl nl = {
+        .pkttype = htons(PACKET_USER),
+        .hatype = htons(ARPHRD_NETLINK),
+        .family = htons(NETLINK_ROUTE),
+    };
+    struct rmon_pcap_rec rec = {
+        .ts_sec = ts / 1000000000ULL,
+        .ts_nsec = ts % 1000000000ULL,
+        .incl_len = sizeof(nl) + len,
+        .orig_len = sizeof(nl) + len,
+    };
+    FILE *f = arg;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        nl.addr[i] = batch >> (56 - 8 * i);
+    if (fwrite(&rec, sizeof(rec), 1, f) != 1 || fwrite(&nl, sizeof(nl), 1, f) != 1 ||
+        fwrite(buf, len, 1, f) != 1)
+        return -errno;
+    return 0;
+}
+
+static int parse_u32(const char *s, uint32_t *v)
+{
+    unsigned long long n;
+    char *end;
+
+    errno = 0;
+    n = strtoull(s, &end, 0);
+    if (errno || *end || end == s || n > UINT32_MAX)
+        return -1;
+    *v = n;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "routes",       required_argument, NULL, 'n' },
+        { "links",        required_argument, NULL, 'k' },
+        { "ecmp",         required_argument, NULL, 'e' },
+        { "flap-rate",    required_argument, NULL, 'f' },
+        { "flap-gap",     required_argument, NULL, 'g' },
+        { "duration",     required_argument, NULL, 'd' },
+        { "reloads",      required_argument, NULL, 'r' },
+        { "link-downs",   required_argument, NULL, 'w' },
+        { "link-deletes", required_argument, NULL, 'x' },
+        { "batch",        required_argument, NULL, 'b' },
+        { "seed",         required_argument, NULL, 's' },
+        { "help",         no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct rmon_pcap_hdr hdr = {
+        .magic = RMON_PCAP_MAGIC,
+        .version_major = RMON_PCAP_VERSION_MAJOR,
+        .version_minor = RMON_PCAP_VERSION_MINOR,
+        .snaplen = RMON_PCAP_SNAPLEN,
+        .linktype = RMON_PCAP_LINKTYPE,
+    };
+    struct workload_stats stats;
+    struct workload w;
+    struct timespec now;
+    uint32_t *field;
+    FILE *f;
+    int err, opt;
+
+    workload_defaults(&w);
+    while ((opt = getopt_long(argc, argv, "n:k:e:f:g:d:r:w:x:b:s:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'n': field = &w.routes; break;
+        case 'k': field = &w.links; break;
+        case 'e': field = &w.ecmp; break;
+        case 'f': field = &w.flap_rate; break;
+        case 'g': field = &w.flap_gap_ms; break;
+        case 'd': field = &w.duration_ms; break;
+        case 'r': field = &w.reloads; break;
+        case 'w': field = &w.link_downs; break;
+        case 'x': field = &w.link_deletes; break;
+        case 'b': field = &w.batch; break;
+        case 's':
+            w.seed = strtoull(optarg, NULL, 0);
+            continue;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (parse_u32(optarg, field) < 0) {
+            fprintf(stderr, "Invalid number: %s\n", optarg);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    f = strcmp(argv[optind], "-") ? fopen(argv[optind], "w") : stdout;
+    if (!f) {
+        fprintf(stderr, "Unable to open %s: %s\n", argv[optind], strerror(errno));
+        return EXIT_FAILURE;
+    }
+    clock_gettime(CLOCK_REALTIME, &now);
+    w.start_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+    err = fwrite(&hdr, sizeof(hdr), 1, f) == 1 ? 0 : -errno;
+    if (!err)
+        err = workload_run(&w, write_packet, f, &stats);
+    if (fclose(f) && !err)
+        err = -errno;
+    if (err < 0) {
+        fprintf(stderr, "Unable to generate workload: %s\n", strerror(-err));
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "Workload: packets: %llu messages: %llu bytes: %llu batches: %llu\n",
+            (unsigned long long)stats.packets, (unsigned long long)stats.messages,
+            (unsigned long long)stats.bytes, (unsigned long long)stats.batches);
+    return EXIT_SUCCESS;
+}
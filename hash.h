@@ -0,0 +1,57 @@
+/*
+ * Route monitor - hashing helpers
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_HASH_H
+#define RMON_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 64-bit FNV-1a, used for route keys and attribute fingerprints */
+#define HASH_INIT   0xcbf29ce484222325ULL
+
+static inline uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/*
+ * Route identity as libnl sees it: family, tos, table, dst and priority.
+ * Computed the same way from raw messages and from cache objects.
+ */
+static inline uint64_t hash_route_key(uint8_t family, uint8_t tos, uint32_t table,
+                                      uint32_t prefixlen, const void *dst,
+                                      size_t dst_len, uint32_t priority)
+{
+    uint64_t h = HASH_INIT;
+
+    h = hash_bytes(h, &family, sizeof(family));
+    h = hash_bytes(h, &tos, sizeof(tos));
+    h = hash_bytes(h, &table, sizeof(table));
+    h = hash_bytes(h, &prefixlen, sizeof(prefixlen));
+    h = hash_bytes(h, dst, dst_len);
+    h = hash_bytes(h, &priority, sizeof(priority));
+    return h | 1;
+}
+
+#endif
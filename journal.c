@@ -0,0 +1,359 @@
+/*
+ * Route monitor - event journal
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/errno.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "journal_codec.h"
+#include "mem.h"
+#include "metrics.h"
+#include "rmon_journal.h"
+
+static struct {
+    const char *dir;
+    size_t segment_size;
+    unsigned int keep;
+    uint64_t run;
+    int fd;
+    char path[4096];
+    struct rmon_journal_hdr *hdr;
+    unsigned char *data;
+    size_t map_size;
+    uint64_t next_index;
+    struct jc_enc enc;
+    int block_open;
+    uint64_t block_start;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t raw_bytes;
+    uint64_t blocks;
+    uint64_t segments;
+    uint64_t removed;
+    uint64_t errors;
+} journal = {
+    .fd = -1,
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int journal_init(const char *dir, size_t segment_size, unsigned int keep)
+{
+    DIR *d = opendir(dir);
+
+    if (!d)
+        return -nl_syserr2nlerr(errno);
+    closedir(d);
+
+    /* Room for a full block plus the largest record that may overflow it */
+    journal.enc.cap = RMON_JOURNAL_BLOCK_SIZE + 64 * 1024;
+    journal.enc.buf = mem_malloc(MEM_JOURNAL, journal.enc.cap);
+    if (!journal.enc.buf)
+        return -NLE_NOMEM;
+
+    journal.dir = dir;
+    journal.segment_size = segment_size < 1024 * 1024 ? 1024 * 1024 : segment_size;
+    journal.keep = keep;
+    journal.run = now_ns();
+    return 0;
+}
+
+/* Trims the segment to its data, it is not written any more after this */
+static void close_segment(void)
+{
+    uint64_t end;
+
+    if (!journal.hdr)
+        return;
+    end = journal.hdr->data_offset + atomic_load(&journal.hdr->data_end);
+    atomic_store(&journal.hdr->closed, 1);
+    munmap(journal.hdr, journal.map_size);
+    mem_mapped(MEM_JOURNAL, -(long)journal.map_size);
+    if (ftruncate(journal.fd, end) < 0)
+        journal.errors++;
+    close(journal.fd);
+    journal.hdr = NULL;
+    journal.fd = -1;
+}
+
+static int cmp_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * Removes the oldest segments beyond the configured number. Names sort
+ * by creation time. Nothing is removed unless every name was collected.
+ */
+static void expire_segments(void)
+{
+    char **names = NULL, **tmp;
+    struct dirent *de;
+    char path[4096];
+    size_t n = 0, cap = 0, i, len;
+    int failed = 0;
+    DIR *d;
+
+    if (!journal.keep)
+        return;
+    d = opendir(journal.dir);
+    if (!d)
+        return;
+    while ((de = readdir(d))) {
+        len = strlen(de->d_name);
+        if (strncmp(de->d_name, "rmon-", 5) || len < 10 || strcmp(de->d_name + len - 4, ".jnl"))
+            continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            tmp = mem_realloc(MEM_JOURNAL, names, cap * sizeof(*names));
+            if (!tmp) {
+                failed = 1;
+                break;
+            }
+            names = tmp;
+        }
+        names[n] = strdup(de->d_name);
+        if (!names[n]) {
+            failed = 1;
+            break;
+        }
+        n++;
+    }
+    closedir(d);
+
+    if (failed) {
+        journal.errors++;
+    } else if (n > journal.keep) {
+        qsort(names, n, sizeof(*names), cmp_names);
+        for (i = 0; i < n - journal.keep; i++) {
+            snprintf(path, sizeof(path), "%s/%s", journal.dir, names[i]);
+            if (unlink(path) == 0)
+                journal.removed++;
+        }
+    }
+    for (i = 0; i < n; i++)
+        free(names[i]);
+    free(names);
+}
+
+static int open_segment(const struct rmon_journal_block *first)
+{
+    size_t index_cap = journal.segment_size / RMON_JOURNAL_INDEX_STRIDE + 1;
+    size_t data_offset;
+    void *map;
+    int err;
+
+    data_offset = sizeof(struct rmon_journal_hdr) + index_cap * sizeof(struct rmon_journal_index);
+    data_offset = (data_offset + 4095) & ~(size_t)4095;
+    journal.map_size = data_offset + journal.segment_size;
+
+    snprintf(journal.path, sizeof(journal.path), "%s/rmon-%020llu.jnl", journal.dir,
+             (unsigned long long)now_ns());
+    journal.fd = open(journal.path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (journal.fd < 0)
+        return -errno;
+
+    /* Allocate up front: running out of space later would be a SIGBUS */
+    err = posix_fallocate(journal.fd, 0, journal.map_size);
+    if (err)
+        goto err;
+    map = mmap(NULL, journal.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, journal.fd, 0);
+    if (map == MAP_FAILED) {
+        err = errno;
+        goto err;
+    }
+
+    journal.hdr = map;
+    mem_mapped(MEM_JOURNAL, journal.map_size);
+    journal.data = (unsigned char *)map + data_offset;
+    journal.hdr->magic = RMON_JOURNAL_MAGIC;
+    journal.hdr->version = RMON_JOURNAL_VERSION;
+    journal.hdr->hdr_len = sizeof(*journal.hdr);
+    journal.hdr->run = journal.run;
+    journal.hdr->data_offset = data_offset;
+    journal.hdr->data_size = journal.segment_size;
+    journal.hdr->first_seq = first->first_seq;
+    journal.hdr->first_ts = first->first_ts;
+    journal.hdr->index_cap = index_cap;
+    journal.next_index = 0;
+    journal.segments++;
+
+    expire_segments();
+    return 0;
+
+err:
+    close(journal.fd);
+    unlink(journal.path);
+    journal.fd = -1;
+    return -err;
+}
+
+/* Moves the encoded block into the segment, starting a new segment if needed */
+static void write_block(void)
+{
+    struct rmon_journal_block *blk = &journal.enc.blk;
+    size_t span = RMON_JOURNAL_BLOCK_SPAN(blk);
+    struct rmon_journal_index *idx;
+    unsigned char *p;
+    uint64_t end;
+    uint32_t n;
+    int err;
+
+    journal.block_open = 0;
+    if (journal.hdr && atomic_load_explicit(&journal.hdr->data_end, memory_order_relaxed) +
+                       span > journal.hdr->data_size)
+        close_segment();
+    if (!journal.hdr) {
+        err = open_segment(blk);
+        if (err < 0) {
+            fprintf(stderr, "Unable to create journal segment, journal disabled: %s\n",
+                    strerror(-err));
+            journal.errors++;
+            journal.dir = NULL;
+            return;
+        }
+    }
+
+    end = atomic_load_explicit(&journal.hdr->data_end, memory_order_relaxed);
+    p = journal.data + end;
+    memcpy(p, blk, sizeof(*blk));
+    memcpy(p + sizeof(*blk), journal.enc.buf, blk->len);
+    memset(p + sizeof(*blk) + blk->len, 0, span - sizeof(*blk) - blk->len);
+    atomic_store_explicit(&journal.hdr->last_ts, blk->last_ts, memory_order_relaxed);
+    atomic_store_explicit(&journal.hdr->data_end, end + span, memory_order_release);
+    journal.bytes += span;
+    journal.raw_bytes += blk->raw_len;
+    journal.blocks++;
+
+    /* Index entries only ever point at published blocks */
+    if (end >= journal.next_index) {
+        n = atomic_load_explicit(&journal.hdr->index_len, memory_order_relaxed);
+        if (n < journal.hdr->index_cap) {
+            idx = &rmon_journal_index(journal.hdr)[n];
+            idx->ts = blk->first_ts;
+            idx->seq = blk->first_seq;
+            idx->offset = end;
+            atomic_store_explicit(&journal.hdr->index_len, n + 1, memory_order_release);
+        }
+        journal.next_index = (end / RMON_JOURNAL_INDEX_STRIDE + 1) * RMON_JOURNAL_INDEX_STRIDE;
+    }
+}
+
+void journal_append(const struct rmon_rec_hdr *rec)
+{
+    if (!journal.dir)
+        return;
+
+    if (journal.block_open && jc_enc_add(&journal.enc, rec) == 0)
+        goto added;
+    if (journal.block_open)
+        write_block();
+    if (!journal.dir)
+        return;
+
+    jc_enc_reset(&journal.enc, rec);
+    journal.block_open = 1;
+    journal.block_start = mono_ns();
+    jc_enc_add(&journal.enc, rec);
+
+added:
+    journal.records++;
+    if (journal.enc.blk.len >= RMON_JOURNAL_BLOCK_SIZE)
+        write_block();
+}
+
+/* Milliseconds until the open block is due to be written, -1 if none is open */
+int journal_timeout(void)
+{
+    uint64_t now, due;
+
+    if (!journal.block_open)
+        return -1;
+    now = mono_ns();
+    due = journal.block_start + RMON_JOURNAL_BLOCK_AGE * 1000000ULL;
+    if (now >= due)
+        return 0;
+    return (due - now + 999999) / 1000000;
+}
+
+void journal_batch_end(void)
+{
+    if (journal.block_open && !journal_timeout())
+        write_block();
+}
+
+void journal_report(FILE *f)
+{
+    if (!journal.dir)
+        return;
+    fprintf(f, "Journal: records: %llu blocks: %llu bytes: %llu raw bytes: %llu ratio: %.2f "
+            "segments: %llu removed: %llu errors: %llu\n",
+            (unsigned long long)journal.records, (unsigned long long)journal.blocks,
+            (unsigned long long)journal.bytes, (unsigned long long)journal.raw_bytes,
+            journal.bytes ? (double)journal.raw_bytes / journal.bytes : 0.0,
+            (unsigned long long)journal.segments, (unsigned long long)journal.removed,
+            (unsigned long long)journal.errors);
+}
+
+void journal_metrics(struct metrics_writer *w, void *data)
+{
+    if (!journal.dir)
+        return;
+    metrics_put(w, "rmon_journal_records_total", "counter", "Records journaled.", NULL,
+                journal.records);
+    metrics_put(w, "rmon_journal_bytes_total", "counter", "Encoded journal bytes written.",
+                NULL, journal.bytes);
+    metrics_put(w, "rmon_journal_raw_bytes_total", "counter",
+                "Journaled bytes before encoding.", NULL, journal.raw_bytes);
+    metrics_put(w, "rmon_journal_segments_total", "counter", "Journal segments started.",
+                NULL, journal.segments);
+    metrics_put(w, "rmon_journal_errors_total", "counter", "Journal errors.", NULL,
+                journal.errors);
+}
+
+void journal_close(void)
+{
+    if (journal.dir && journal.block_open)
+        write_block();
+    close_segment();
+    free(journal.enc.buf);
+    journal.enc.buf = NULL;
+    journal.dir = NULL;
+}
@@ -0,0 +1,38 @@
+/*
+ * Route monitor - event journal
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_JOURNAL_WRITER_H
+#define RMON_JOURNAL_WRITER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "rmon_proto.h"
+
+#define JOURNAL_DEFAULT_SEGMENT (64 * 1024 * 1024)
+
+struct metrics_writer;
+
+int journal_init(const char *dir, size_t segment_size, unsigned int keep);
+void journal_append(const struct rmon_rec_hdr *rec);
+int journal_timeout(void);
+void journal_batch_end(void);
+void journal_report(FILE *f);
+void journal_metrics(struct metrics_writer *w, void *data);
+void journal_close(void);
+
+#endif
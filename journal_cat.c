@@ -0,0 +1,155 @@
+/*
+ * Route monitor - journal query tool
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "format.h"
+#include "rmon_journal.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] DIR\n"
+            "Prints the events of an rmon journal directory as text.\n"
+            "  -f, --from=TIME   start at the first event at or after TIME\n"
+            "  -t, --to=TIME     stop before the first event after TIME\n"
+            "  -s, --seq=SEQ     start at sequence number SEQ of the latest run\n"
+            "  -v, --verbose     prefix every event with its sequence number and time,\n"
+            "                    report the number of records looked at\n"
+            "  -h, --help        show this help\n"
+            "TIME is @SECONDS since the epoch or a local 'YYYY-MM-DD HH:MM[:SS]',\n"
+            "'HH:MM[:SS]' means today.\n", prog);
+}
+
+static int parse_time(const char *s, uint64_t *ns)
+{
+    static const char *formats[] = {
+        "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M", "%H:%M:%S", "%H:%M",
+    };
+    time_t now = time(NULL);
+    struct tm tm;
+    const char *end;
+    char *num_end;
+    double secs;
+    size_t i;
+
+    if (s[0] == '@') {
+        secs = strtod(s + 1, &num_end);
+        if (*num_end || num_end == s + 1 || secs < 0)
+            return -1;
+        *ns = secs * 1e9;
+        return 0;
+    }
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        localtime_r(&now, &tm);
+        tm.tm_sec = 0;
+        end = strptime(s, formats[i], &tm);
+        if (end && !*end) {
+            tm.tm_isdst = -1;
+            *ns = (uint64_t)mktime(&tm) * 1000000000ULL;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "from",    required_argument, NULL, 'f' },
+        { "to",      required_argument, NULL, 't' },
+        { "seq",     required_argument, NULL, 's' },
+        { "verbose", no_argument,       NULL, 'v' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    const struct rmon_rec_hdr *rec;
+    uint64_t from = 0, to = UINT64_MAX, seq = 0;
+    struct rmon_journal j;
+    uint64_t printed = 0;
+    char line[1024];
+    int verbose = 0;
+    int err, opt;
+
+    while ((opt = getopt_long(argc, argv, "f:t:s:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'f':
+        case 't':
+            if (parse_time(optarg, opt == 'f' ? &from : &to) < 0) {
+                fprintf(stderr, "Invalid time: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            seq = strtoull(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    err = rmon_journal_open(&j, argv[optind]);
+    if (err < 0) {
+        fprintf(stderr, "Unable to open journal %s: %s\n", argv[optind], strerror(-err));
+        return EXIT_FAILURE;
+    }
+
+    if (seq)
+        rmon_journal_seek_seq(&j, seq);
+    else if (from)
+        rmon_journal_seek_time(&j, from);
+
+    while (rmon_journal_next(&j, &rec) > 0) {
+        if (rec->ts > to)
+            break;
+        if (rec->ts < from)
+            continue;
+        rmon_format_text(rec, line, sizeof(line));
+        if (verbose)
+            printf("%llu %llu.%09llu ", (unsigned long long)rec->seq,
+                   (unsigned long long)(rec->ts / 1000000000ULL),
+                   (unsigned long long)(rec->ts % 1000000000ULL));
+        fputs(line, stdout);
+        printed++;
+    }
+
+    if (verbose)
+        fprintf(stderr, "Segments: %d records printed: %llu looked at: %llu blocks decoded: %llu\n",
+                j.nsegs, (unsigned long long)printed, (unsigned long long)j.scanned,
+                (unsigned long long)j.blocks);
+    rmon_journal_close(&j);
+    return EXIT_SUCCESS;
+}
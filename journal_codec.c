@@ -0,0 +1,721 @@
+/*
+ * Route monitor - journal block encoding
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "hash.h"
+#include "journal_codec.h"
+
+#define JC_MAX_NH       32
+/* Worst case growth of a record in the encoding, on top of its own length */
+#define JC_SLACK        (32 + 16 * JC_MAX_NH)
+
+static unsigned char *put_varint(unsigned char *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static size_t varint_len(uint64_t v)
+{
+    size_t n = 1;
+
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static int all_zero(const uint8_t *p, size_t len)
+{
+    while (len--) {
+        if (*p++)
+            return 0;
+    }
+    return 1;
+}
+
+void jc_enc_reset(struct jc_enc *e, const struct rmon_rec_hdr *first)
+{
+    memset(&e->blk, 0, sizeof(e->blk));
+    e->blk.magic = RMON_JOURNAL_BLOCK_MAGIC;
+    e->blk.first_seq = first->seq;
+    e->blk.first_ts = first->ts;
+    e->prev_seq = first->seq - 1;
+    e->prev_ts = first->ts;
+    memset(e->prev_dst, 0, sizeof(e->prev_dst));
+    e->nshapes = 0;
+    e->keys_len = 0;
+    e->nroutes = 0;
+    e->ndsts = 0;
+    e->dst_dist = 0;
+    e->attrs.n = 0;
+    memset(e->attrs.slots, 0, sizeof(e->attrs.slots));
+    e->nexthops.n = 0;
+    memset(e->nexthops.slots, 0, sizeof(e->nexthops.slots));
+    e->ifindexes.n = 0;
+    memset(e->ifindexes.slots, 0, sizeof(e->ifindexes.slots));
+    e->gateways.n = 0;
+    memset(e->gateways.slots, 0, sizeof(e->gateways.slots));
+    memset(e->slots, 0, sizeof(e->slots));
+    memset(e->dsts, 0, sizeof(e->dsts));
+}
+
+/* The slot holding val, or the empty one where it would go */
+static struct jc_value_slot *find_value(struct jc_value_slot *slots, size_t nslots,
+                                        const void *val, size_t len, uint64_t *hash)
+{
+    uint64_t h = hash_bytes(HASH_INIT, val, len) | 1;
+    size_t i;
+
+    for (i = h % nslots; slots[i].hash; i = (i + 1) % nslots) {
+        if (slots[i].hash == h && slots[i].len == len && !memcmp(slots[i].val, val, len))
+            break;
+    }
+    *hash = h;
+    return &slots[i];
+}
+
+/* The code of val in d, d->n while it is new to the block */
+static uint32_t dict_code(struct jc_dict *d, const void *val, size_t len)
+{
+    struct jc_value_slot *slot;
+    uint64_t h;
+
+    slot = find_value(d->slots, JC_DICT_SLOTS, val, len, &h);
+    return slot->hash ? slot->idx : d->n;
+}
+
+/* Writes the code of val in d, returns 1 when the value itself must follow */
+static int put_code(struct jc_dict *d, unsigned char **p, const void *val, size_t len)
+{
+    struct jc_value_slot *slot;
+    uint64_t h;
+
+    slot = find_value(d->slots, JC_DICT_SLOTS, val, len, &h);
+    if (slot->hash) {
+        *p = put_varint(*p, slot->idx);
+        return 0;
+    }
+    *p = put_varint(*p, d->n);
+    /* As with shapes, later values just stay literal */
+    if (d->n < JC_DICT_SLOTS / 2) {
+        slot->hash = h;
+        slot->idx = d->n;
+        slot->len = len;
+        memcpy(slot->val, val, len);
+    }
+    d->n++;
+    return 1;
+}
+
+/*
+ * Shape: everything of a route record but the destination and aux. With
+ * an encoder the attributes and nexthops are coded against its
+ * dictionaries, without one this is the key shapes are looked up by.
+ * Nexthops are looked up by the codes of their ifindex and gateway.
+ */
+static unsigned char *put_shape(struct jc_enc *e, unsigned char *p, const struct rmon_rec_hdr *rec)
+{
+    const struct rmon_rec_route *r = rmon_rec_body(rec);
+    const struct rmon_rec_nh *nh = rmon_rec_nexthops(rec);
+    uint8_t key[14];
+    uint32_t code;
+    int i;
+
+    key[0] = r->family;
+    key[1] = r->tos;
+    key[2] = r->protocol;
+    key[3] = r->scope;
+    key[4] = r->rtype;
+    key[5] = r->dst_alen;
+    memcpy(key + 6, &r->table, sizeof(r->table));
+    memcpy(key + 10, &r->priority, sizeof(r->priority));
+    if (!e || put_code(&e->attrs, &p, key, sizeof(key))) {
+        memcpy(p, key, 6);
+        p += 6;
+        p = put_varint(p, r->table);
+        p = put_varint(p, r->priority);
+    }
+    *p++ = r->dst_len;
+    p = put_varint(p, r->nnh * (JC_MAX_NH + 1) + r->old_nnh);
+    for (i = 0; i < r->nnh + r->old_nnh; i++) {
+        if (!e) {
+            p = put_varint(p, zigzag(nh[i].ifindex));
+            *p++ = nh[i].gw_len;
+            memcpy(p, nh[i].gw, nh[i].gw_len);
+            p += nh[i].gw_len;
+            *p++ = nh[i].weight;
+            *p++ = nh[i].flags;
+            continue;
+        }
+        code = dict_code(&e->ifindexes, &nh[i].ifindex, sizeof(nh[i].ifindex));
+        memcpy(key, &code, sizeof(code));
+        code = dict_code(&e->gateways, nh[i].gw, nh[i].gw_len);
+        memcpy(key + 4, &code, sizeof(code));
+        key[8] = nh[i].weight;
+        key[9] = nh[i].flags;
+        if (!put_code(&e->nexthops, &p, key, sizeof(key)))
+            continue;
+        if (put_code(&e->ifindexes, &p, &nh[i].ifindex, sizeof(nh[i].ifindex)))
+            p = put_varint(p, zigzag(nh[i].ifindex));
+        if (put_code(&e->gateways, &p, nh[i].gw, nh[i].gw_len)) {
+            *p++ = nh[i].gw_len;
+            memcpy(p, nh[i].gw, nh[i].gw_len);
+            p += nh[i].gw_len;
+        }
+        *p++ = nh[i].weight;
+        *p++ = nh[i].flags;
+    }
+    return p;
+}
+
+/* Whether every field of a route record survives the encoding */
+static int route_encodable(const struct rmon_rec_hdr *rec)
+{
+    const struct rmon_rec_route *r = rmon_rec_body(rec);
+    const struct rmon_rec_nh *nh = rmon_rec_nexthops(rec);
+    int i;
+
+    if (r->nnh + r->old_nnh > JC_MAX_NH || rec->len != RMON_REC_ROUTE_LEN(r->nnh + r->old_nnh) ||
+        r->dst_alen > 16 ||
+        !all_zero(r->reserved, sizeof(r->reserved)) ||
+        !all_zero(r->dst + r->dst_alen, sizeof(r->dst) - r->dst_alen))
+        return 0;
+    if (r->aux && rec->type != RMON_REC_ROUTE_DAMPED && rec->type != RMON_REC_ROUTE_REUSABLE)
+        return 0;
+    for (i = 0; i < r->nnh + r->old_nnh; i++) {
+        if (nh[i].reserved || nh[i].gw_len > 16 ||
+            !all_zero(nh[i].gw + nh[i].gw_len, sizeof(nh[i].gw) - nh[i].gw_len))
+            return 0;
+    }
+    return 1;
+}
+
+static unsigned char *put_route(struct jc_enc *e, unsigned char *tag, unsigned char *p,
+                                const struct rmon_rec_hdr *rec)
+{
+    const struct rmon_rec_route *r = rmon_rec_body(rec);
+    unsigned char shape[16 + 2 * 10 + JC_MAX_NH * (10 + 3 + 16)];
+    struct jc_shape_slot *slot;
+    struct jc_value_slot *dst;
+    unsigned int shared, sig, whole;
+    uint32_t dist = 0;
+    size_t len, lit, i;
+    uint64_t h;
+
+    len = put_shape(NULL, shape, rec) - shape;
+    h = hash_bytes(HASH_INIT, shape, len) | 1;
+    for (i = h % JC_SHAPE_SLOTS; e->slots[i].hash; i = (i + 1) % JC_SHAPE_SLOTS) {
+        if (e->slots[i].hash == h && e->slots[i].len == len &&
+            !memcmp(e->keys + e->slots[i].off, shape, len))
+            break;
+    }
+    slot = &e->slots[i];
+
+    if (slot->hash) {
+        p = put_varint(p, slot->idx);
+    } else {
+        p = put_varint(p, e->nshapes);
+        /* Keep the table at most half full, later shapes just stay literal */
+        if (e->nshapes < JC_SHAPE_SLOTS / 2 && e->keys_len + len <= sizeof(e->keys)) {
+            slot->hash = h;
+            slot->off = e->keys_len;
+            slot->len = len;
+            slot->idx = e->nshapes;
+            memcpy(e->keys + e->keys_len, shape, len);
+            e->keys_len += len;
+        }
+        e->nshapes++;
+        p = put_shape(e, p, rec);
+    }
+
+    /* A back reference or the bytes covering the prefix where shorter */
+    for (sig = r->dst_alen; sig && !r->dst[sig - 1]; sig--)
+        ;
+    for (shared = 0; shared < sig && r->dst[shared] == e->prev_dst[shared]; shared++)
+        ;
+    lit = varint_len(2 + shared * 17 + sig) + sig - shared;
+    whole = (r->dst_len + 7) / 8;
+    if (whole > r->dst_alen || sig > whole || whole >= lit)
+        whole = 0;
+    dst = find_value(e->dsts, JC_DST_SLOTS, r->dst, r->dst_alen, &h);
+    if (dst->hash && e->nroutes - dst->idx <= JC_DST_HISTORY)
+        dist = e->nroutes - dst->idx;
+    if (dist && dist == e->dst_dist) {
+        *p++ = 0;
+    } else if (dist && 1 + varint_len(dist) < (whole ? whole : lit)) {
+        *p++ = 1;
+        p = put_varint(p, dist);
+        e->dst_dist = dist;
+    } else if (whole) {
+        *tag |= JC_TAG_DST;
+        memcpy(p, r->dst, whole);
+        p += whole;
+    } else {
+        p = put_varint(p, 2 + shared * 17 + sig);
+        memcpy(p, r->dst + shared, sig - shared);
+        p += sig - shared;
+    }
+    memcpy(e->prev_dst, r->dst, sizeof(e->prev_dst));
+    if (dst->hash) {
+        dst->idx = e->nroutes;
+    } else if (e->ndsts < JC_DST_SLOTS / 2) {
+        dst->hash = h;
+        dst->idx = e->nroutes;
+        dst->len = r->dst_alen;
+        memcpy(dst->val, r->dst, r->dst_alen);
+        e->ndsts++;
+    }
+    e->nroutes++;
+
+    if (rec->type == RMON_REC_ROUTE_DAMPED || rec->type == RMON_REC_ROUTE_REUSABLE)
+        p = put_varint(p, r->aux);
+    return p;
+}
+
+/* Returns -ENOSPC when the block is full, the caller starts a new one */
+int jc_enc_add(struct jc_enc *e, const struct rmon_rec_hdr *rec)
+{
+    const struct rmon_rec_link *l = rmon_rec_body(rec);
+    const struct rmon_rec_addr *a = rmon_rec_body(rec);
+    unsigned char *start = e->buf + e->blk.len;
+    unsigned char *p = start;
+    size_t name_len = 0;
+    uint8_t tag;
+    int raw;
+
+    if (e->blk.len + rec->len + JC_SLACK > e->cap)
+        return -ENOSPC;
+
+    /* Time going backwards, after a clock step, is left to raw records */
+    if (rec->version != RMON_PROTO_VERSION || rec->type >= JC_TAG_TYPE || rec->ts < e->prev_ts)
+        raw = 1;
+    else if (rmon_rec_is_route(rec))
+        raw = !route_encodable(rec);
+    else if (rmon_rec_is_link(rec))
+        raw = rec->len != RMON_REC_LINK_LEN || l->reserved ||
+              (name_len = strnlen(l->name, sizeof(l->name))) == sizeof(l->name) ||
+              !all_zero((const uint8_t *)l->name + name_len, sizeof(l->name) - name_len);
+    else if (rmon_rec_is_addr(rec))
+        raw = rec->len != RMON_REC_ADDR_LEN || a->reserved || a->alen > 16 ||
+              !all_zero(a->local + a->alen, sizeof(a->local) - a->alen);
+    else
+        raw = 1;
+
+    if (raw) {
+        *p++ = JC_RAW;
+        p = put_varint(p, rec->len);
+        memcpy(p, rec, rec->len);
+        p += rec->len;
+        goto done;
+    }
+
+    tag = rec->type;
+    if (rec->seq == e->prev_seq + 1)
+        tag |= JC_TAG_SEQ1;
+    if (rec->flags)
+        tag |= JC_TAG_FLAGS;
+    *p++ = tag;
+    if (rec->flags)
+        p = put_varint(p, rec->flags);
+    if (!(tag & JC_TAG_SEQ1))
+        p = put_varint(p, zigzag(rec->seq - e->prev_seq));
+    p = put_varint(p, rec->ts - e->prev_ts);
+
+    if (rmon_rec_is_route(rec)) {
+        p = put_route(e, start, p, rec);
+    } else if (rmon_rec_is_link(rec)) {
+        p = put_varint(p, zigzag(l->ifindex));
+        p = put_varint(p, l->flags);
+        p = put_varint(p, l->mtu);
+        *p++ = name_len;
+        memcpy(p, l->name, name_len);
+        p += name_len;
+    } else {
+        p = put_varint(p, zigzag(a->ifindex));
+        *p++ = a->family;
+        *p++ = a->prefixlen;
+        *p++ = a->alen;
+        memcpy(p, a->local, a->alen);
+        p += a->alen;
+    }
+
+done:
+    e->prev_seq = rec->seq;
+    e->prev_ts = rec->ts;
+    e->blk.len += p - start;
+    e->blk.records++;
+    e->blk.raw_len += rec->len;
+    e->blk.last_seq = rec->seq;
+    e->blk.last_ts = rec->ts;
+    return 0;
+}
+
+struct jc_in {
+    const unsigned char *p;
+    const unsigned char *end;
+    int err;
+};
+
+static uint64_t get_varint(struct jc_in *in)
+{
+    uint64_t v = 0;
+    int shift;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        if (in->p >= in->end) {
+            in->err = 1;
+            return 0;
+        }
+        v |= (uint64_t)(*in->p & 0x7f) << shift;
+        if (!(*in->p++ & 0x80))
+            return v;
+    }
+    in->err = 1;
+    return 0;
+}
+
+static uint8_t get_byte(struct jc_in *in)
+{
+    if (in->p >= in->end) {
+        in->err = 1;
+        return 0;
+    }
+    return *in->p++;
+}
+
+static void get_bytes(struct jc_in *in, void *out, size_t len)
+{
+    if ((size_t)(in->end - in->p) < len) {
+        in->err = 1;
+        return;
+    }
+    memcpy(out, in->p, len);
+    in->p += len;
+}
+
+/* What a block has defined so far, for the codes referring to it */
+struct jc_dec {
+    unsigned char *out;
+    uint32_t nshapes;
+    uint32_t nattrs;
+    uint32_t nnexthops;
+    uint32_t nifindexes;
+    uint32_t ngateways;
+    uint32_t nroutes;
+    uint32_t dst_dist;
+    uint32_t shapes[JC_SHAPE_SLOTS / 2];        /* offsets of the records */
+    uint32_t attrs[JC_DICT_SLOTS / 2];          /* of the route bodies */
+    uint32_t nexthops[JC_DICT_SLOTS / 2];       /* and of the nexthops */
+    int32_t ifindexes[JC_DICT_SLOTS / 2];
+    const unsigned char *gateways[JC_DICT_SLOTS / 2];
+    uint32_t routes[JC_DST_HISTORY];            /* offsets of the records */
+};
+
+/* Fills in a nexthop from a shape literal */
+static int get_nh(struct jc_in *in, struct jc_dec *d, struct rmon_rec_nh *nh)
+{
+    const unsigned char *gw;
+    uint32_t code;
+
+    code = get_varint(in);
+    if (code < d->nnexthops && code < JC_DICT_SLOTS / 2) {
+        memcpy(nh, d->out + d->nexthops[code], sizeof(*nh));
+        return in->err ? -1 : 0;
+    }
+    if (code != d->nnexthops)
+        return -1;
+    if (d->nnexthops < JC_DICT_SLOTS / 2)
+        d->nexthops[code] = (unsigned char *)nh - d->out;
+    d->nnexthops++;
+
+    memset(nh, 0, sizeof(*nh));
+    code = get_varint(in);
+    if (code == d->nifindexes) {
+        nh->ifindex = unzigzag(get_varint(in));
+        if (d->nifindexes < JC_DICT_SLOTS / 2)
+            d->ifindexes[code] = nh->ifindex;
+        d->nifindexes++;
+    } else if (code < d->nifindexes && code < JC_DICT_SLOTS / 2) {
+        nh->ifindex = d->ifindexes[code];
+    } else {
+        return -1;
+    }
+
+    code = get_varint(in);
+    if (code == d->ngateways) {
+        gw = in->p;
+        if (d->ngateways < JC_DICT_SLOTS / 2)
+            d->gateways[code] = gw;
+        d->ngateways++;
+        nh->gw_len = get_byte(in);
+        if (nh->gw_len > 16)
+            return -1;
+        get_bytes(in, nh->gw, nh->gw_len);
+    } else if (code < d->ngateways && code < JC_DICT_SLOTS / 2) {
+        gw = d->gateways[code];
+        nh->gw_len = gw[0];
+        memcpy(nh->gw, gw + 1, nh->gw_len);
+    } else {
+        return -1;
+    }
+
+    nh->weight = get_byte(in);
+    nh->flags = get_byte(in);
+    return in->err ? -1 : 0;
+}
+
+/* Fills in a route record from a shape literal, returns its length or 0 */
+static size_t get_shape(struct jc_in *in, struct jc_dec *d, struct rmon_rec_hdr *rec, size_t room)
+{
+    struct rmon_rec_route *r = (struct rmon_rec_route *)(rec + 1);
+    struct rmon_rec_nh *nh = (struct rmon_rec_nh *)(r + 1);
+    const struct rmon_rec_route *from;
+    uint32_t code;
+    size_t len;
+    int i;
+
+    if (room < RMON_REC_ROUTE_LEN(0))
+        return 0;
+    memset(r, 0, sizeof(*r));
+    code = get_varint(in);
+    if (code < d->nattrs && code < JC_DICT_SLOTS / 2) {
+        from = (const struct rmon_rec_route *)(d->out + d->attrs[code]);
+        r->family = from->family;
+        r->tos = from->tos;
+        r->protocol = from->protocol;
+        r->scope = from->scope;
+        r->rtype = from->rtype;
+        r->dst_alen = from->dst_alen;
+        r->table = from->table;
+        r->priority = from->priority;
+    } else if (code == d->nattrs) {
+        if (d->nattrs < JC_DICT_SLOTS / 2)
+            d->attrs[code] = (unsigned char *)r - d->out;
+        d->nattrs++;
+        r->family = get_byte(in);
+        r->tos = get_byte(in);
+        r->protocol = get_byte(in);
+        r->scope = get_byte(in);
+        r->rtype = get_byte(in);
+        r->dst_alen = get_byte(in);
+        r->table = get_varint(in);
+        r->priority = get_varint(in);
+    } else {
+        return 0;
+    }
+    r->dst_len = get_byte(in);
+    code = get_varint(in);
+    if (code >= (JC_MAX_NH + 1) * (JC_MAX_NH + 1))
+        return 0;
+    r->nnh = code / (JC_MAX_NH + 1);
+    r->old_nnh = code % (JC_MAX_NH + 1);
+
+    len = RMON_REC_ROUTE_LEN(r->nnh + r->old_nnh);
+    if (in->err || len > room || r->dst_alen > 16)
+        return 0;
+    for (i = 0; i < r->nnh + r->old_nnh; i++) {
+        if (get_nh(in, d, &nh[i]) < 0)
+            return 0;
+    }
+    return len;
+}
+
+/* Fills in the shape and destination of a route record, returns its length or 0 */
+static size_t get_route(struct jc_in *in, struct jc_dec *d, uint8_t tag, unsigned char *out,
+                        size_t pos, size_t room, uint8_t *prev_dst)
+{
+    struct rmon_rec_hdr *rec = (struct rmon_rec_hdr *)(out + pos);
+    struct rmon_rec_route *r = (struct rmon_rec_route *)(rec + 1);
+    const struct rmon_rec_hdr *from;
+    const struct rmon_rec_route *fr;
+    unsigned int code, shared, sig;
+    uint32_t idx;
+    size_t len;
+
+    idx = get_varint(in);
+    if (in->err || idx > d->nshapes)
+        return 0;
+    if (idx == d->nshapes) {
+        if (d->nshapes < JC_SHAPE_SLOTS / 2)
+            d->shapes[idx] = pos;
+        d->nshapes++;
+        len = get_shape(in, d, rec, room);
+        if (!len)
+            return 0;
+    } else {
+        /* A copy of the record that introduced the shape */
+        if (idx >= JC_SHAPE_SLOTS / 2)
+            return 0;
+        from = (const struct rmon_rec_hdr *)(out + d->shapes[idx]);
+        len = from->len;
+        if (len > room)
+            return 0;
+        memcpy(r, from + 1, len - sizeof(*rec));
+        memset(r->dst, 0, sizeof(r->dst));
+        r->aux = 0;
+    }
+
+    if (tag & JC_TAG_DST) {
+        sig = (r->dst_len + 7) / 8;
+        if (sig > r->dst_alen)
+            return 0;
+        memset(prev_dst, 0, 16);
+        get_bytes(in, prev_dst, sig);
+    } else if ((code = get_varint(in)) < 2) {
+        if (code == 1)
+            d->dst_dist = get_varint(in);
+        if (in->err || !d->dst_dist || d->dst_dist > d->nroutes || d->dst_dist > JC_DST_HISTORY)
+            return 0;
+        from = (const struct rmon_rec_hdr *)
+            (out + d->routes[(d->nroutes - d->dst_dist) % JC_DST_HISTORY]);
+        fr = (const struct rmon_rec_route *)(from + 1);
+        if (fr->dst_alen != r->dst_alen)
+            return 0;
+        memcpy(prev_dst, fr->dst, 16);
+    } else {
+        shared = (code - 2) / 17;
+        sig = (code - 2) % 17;
+        if (shared > sig || sig > r->dst_alen)
+            return 0;
+        memset(prev_dst + shared, 0, 16 - shared);
+        get_bytes(in, prev_dst + shared, sig - shared);
+    }
+    memcpy(r->dst, prev_dst, r->dst_alen);
+    d->routes[d->nroutes % JC_DST_HISTORY] = pos;
+    d->nroutes++;
+
+    if (rec->type == RMON_REC_ROUTE_DAMPED || rec->type == RMON_REC_ROUTE_REUSABLE)
+        r->aux = get_varint(in);
+    return in->err ? 0 : len;
+}
+
+/*
+ * Decodes a whole block into out, which must hold blk->raw_len bytes.
+ * Returns the number of records or -EPROTO.
+ */
+int jc_decode(const struct rmon_journal_block *blk, unsigned char *out, size_t len)
+{
+    const unsigned char *data = (const unsigned char *)(blk + 1);
+    struct jc_in in = { .p = data, .end = data + blk->len };
+    uint64_t seq = blk->first_seq - 1, ts = blk->first_ts;
+    struct rmon_rec_hdr *rec;
+    struct jc_dec d;
+    uint8_t dst[16] = { 0 };
+    unsigned int sig;
+    size_t pos = 0, n;
+    uint32_t i;
+    uint8_t tag;
+
+    d.out = out;
+    d.nshapes = 0;
+    d.nattrs = 0;
+    d.nnexthops = 0;
+    d.nifindexes = 0;
+    d.ngateways = 0;
+    d.nroutes = 0;
+    d.dst_dist = 0;
+
+    for (i = 0; i < blk->records; i++) {
+        rec = (struct rmon_rec_hdr *)(out + pos);
+        tag = get_byte(&in);
+
+        if (tag == JC_RAW) {
+            n = get_varint(&in);
+            if (in.err || n < sizeof(*rec) || n % 8 || n > len - pos)
+                return -EPROTO;
+            get_bytes(&in, rec, n);
+            seq = rec->seq;
+            ts = rec->ts;
+            pos += n;
+            continue;
+        }
+
+        if (len - pos < sizeof(*rec))
+            return -EPROTO;
+        memset(rec, 0, sizeof(*rec));
+        rec->version = RMON_PROTO_VERSION;
+        rec->type = tag & JC_TAG_TYPE;
+        if (tag & JC_TAG_FLAGS)
+            rec->flags = get_varint(&in);
+        seq += tag & JC_TAG_SEQ1 ? 1 : unzigzag(get_varint(&in));
+        ts += get_varint(&in);
+        rec->seq = seq;
+        rec->ts = ts;
+
+        if (rmon_rec_is_route(rec)) {
+            n = get_route(&in, &d, tag, out, pos, len - pos, dst);
+            if (!n)
+                return -EPROTO;
+        } else if (tag & JC_TAG_DST) {
+            return -EPROTO;
+        } else if (rmon_rec_is_link(rec)) {
+            struct rmon_rec_link *l = (struct rmon_rec_link *)(rec + 1);
+
+            n = RMON_REC_LINK_LEN;
+            if (n > len - pos)
+                return -EPROTO;
+            memset(l, 0, sizeof(*l));
+            l->ifindex = unzigzag(get_varint(&in));
+            l->flags = get_varint(&in);
+            l->mtu = get_varint(&in);
+            sig = get_byte(&in);
+            if (sig >= sizeof(l->name))
+                return -EPROTO;
+            get_bytes(&in, l->name, sig);
+        } else if (rmon_rec_is_addr(rec)) {
+            struct rmon_rec_addr *a = (struct rmon_rec_addr *)(rec + 1);
+
+            n = RMON_REC_ADDR_LEN;
+            if (n > len - pos)
+                return -EPROTO;
+            memset(a, 0, sizeof(*a));
+            a->ifindex = unzigzag(get_varint(&in));
+            a->family = get_byte(&in);
+            a->prefixlen = get_byte(&in);
+            a->alen = get_byte(&in);
+            if (a->alen > 16)
+                return -EPROTO;
+            get_bytes(&in, a->local, a->alen);
+        } else {
+            return -EPROTO;
+        }
+
+        if (in.err)
+            return -EPROTO;
+        rec->len = n;
+        pos += n;
+    }
+    return pos == blk->raw_len ? (int)blk->records : -EPROTO;
+}
@@ -0,0 +1,113 @@
+/*
+ * Route monitor - journal block encoding
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_JOURNAL_CODEC_H
+#define RMON_JOURNAL_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rmon_journal.h"
+
+/*
+ * Journal blocks hold records in a compact encoding. Every record starts
+ * with a tag byte: the record type plus JC_TAG_SEQ1 when its sequence
+ * number follows the previous one (otherwise a zigzag delta follows),
+ * JC_TAG_FLAGS when a flags varint follows and, for routes, JC_TAG_DST
+ * when the destination is just the bytes covering its prefix. Then comes
+ * the timestamp delta and a type specific body:
+ *
+ *   route  shape index; index == shapes so far introduces a new shape
+ *          (all fields but dst and aux, nexthops included) as a literal,
+ *          then the destination and aux for damped/reusable records
+ *   link   ifindex, flags, mtu, name
+ *   addr   ifindex, family, prefixlen, local address
+ *
+ * A shape literal gives the route attributes but the prefix length and
+ * the nexthops as codes into dictionaries of the block, as are the
+ * ifindex and gateway of a new nexthop; there too code == values so far
+ * introduces a new value, which follows. Other destinations are a varint:
+ *
+ *   0      same as that of the route record as far back as the last
+ *          back reference went
+ *   1      same as that of the route record a varint distance back
+ *   2 + shared * 17 + significant bytes, followed by the bytes that
+ *          differ from the previous destination
+ *
+ * Anything else, or anything with fields the encoding would lose, is
+ * stored raw after a JC_RAW tag. Shapes, dictionaries and destinations
+ * are per block, so every block decodes on its own.
+ */
+#define JC_TAG_TYPE     0x1f
+#define JC_TAG_DST      0x20
+#define JC_TAG_SEQ1     0x40
+#define JC_TAG_FLAGS    0x80
+#define JC_RAW          0x3f
+
+#define JC_SHAPE_SLOTS  4096
+#define JC_SHAPE_KEYS   (64 * 1024)
+#define JC_DICT_SLOTS   1024
+#define JC_DST_SLOTS    8192
+#define JC_DST_HISTORY  (JC_DST_SLOTS / 2)
+
+struct jc_shape_slot {
+    uint64_t hash;
+    uint32_t off;           /* of the shape in keys */
+    uint32_t len;
+    uint32_t idx;
+};
+
+/* A dictionary value, or a destination and the route record it was last in */
+struct jc_value_slot {
+    uint64_t hash;
+    uint32_t idx;
+    uint8_t len;
+    uint8_t val[16];
+};
+
+struct jc_dict {
+    uint32_t n;
+    struct jc_value_slot slots[JC_DICT_SLOTS];
+};
+
+struct jc_enc {
+    unsigned char *buf;
+    size_t cap;
+    struct rmon_journal_block blk;
+    uint64_t prev_seq;
+    uint64_t prev_ts;
+    uint8_t prev_dst[16];
+    uint32_t nshapes;
+    uint32_t keys_len;
+    uint32_t nroutes;       /* route records so far */
+    uint32_t ndsts;
+    uint32_t dst_dist;      /* of the last back reference */
+    struct jc_dict attrs;
+    struct jc_dict nexthops;
+    struct jc_dict ifindexes;
+    struct jc_dict gateways;
+    struct jc_shape_slot slots[JC_SHAPE_SLOTS];
+    struct jc_value_slot dsts[JC_DST_SLOTS];
+    unsigned char keys[JC_SHAPE_KEYS];
+};
+
+void jc_enc_reset(struct jc_enc *e, const struct rmon_rec_hdr *first);
+int jc_enc_add(struct jc_enc *e, const struct rmon_rec_hdr *rec);
+
+int jc_decode(const struct rmon_journal_block *blk, unsigned char *out, size_t len);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Route monitor - event journal reader
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "journal_codec.h"
+#include "rmon_journal.h"
+#include "rmon_reader.h"
+
+static int is_segment(const char *name)
+{
+    size_t len = strlen(name);
+
+    return !strncmp(name, "rmon-", 5) && len > 9 && !strcmp(name + len - 4, ".jnl");
+}
+
+static int cmp_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int map_segment(struct rmon_journal_seg *seg)
+{
+    const struct rmon_journal_hdr *hdr;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(seg->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*hdr)) {
+        close(fd);
+        return -EPROTO;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -errno;
+
+    hdr = map;
+    if (hdr->magic != RMON_JOURNAL_MAGIC || hdr->version != RMON_JOURNAL_VERSION ||
+        hdr->data_offset > (uint64_t)st.st_size ||
+        hdr->data_offset < sizeof(*hdr) + hdr->index_cap * sizeof(struct rmon_journal_index)) {
+        munmap(map, st.st_size);
+        return -EPROTO;
+    }
+
+    seg->hdr = hdr;
+    seg->data = (const unsigned char *)map + hdr->data_offset;
+    seg->map_size = st.st_size;
+    return 0;
+}
+
+/* Segments that are not (yet) valid are left out */
+int rmon_journal_open(struct rmon_journal *j, const char *dir)
+{
+    struct dirent *de;
+    char **names = NULL, **tmp;
+    int n = 0, cap = 0, i;
+    DIR *d;
+
+    memset(j, 0, sizeof(*j));
+    d = opendir(dir);
+    if (!d)
+        return -errno;
+
+    while ((de = readdir(d))) {
+        if (!is_segment(de->d_name))
+            continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            tmp = realloc(names, cap * sizeof(*names));
+            if (!tmp)
+                goto nomem;
+            names = tmp;
+        }
+        if (asprintf(&names[n], "%s/%s", dir, de->d_name) < 0)
+            goto nomem;
+        n++;
+    }
+    closedir(d);
+    d = NULL;
+
+    qsort(names, n, sizeof(*names), cmp_names);
+    j->segs = calloc(n ? n : 1, sizeof(*j->segs));
+    if (!j->segs)
+        goto nomem;
+
+    for (i = 0; i < n; i++) {
+        j->segs[j->nsegs].path = names[i];
+        if (map_segment(&j->segs[j->nsegs]) == 0)
+            j->nsegs++;
+        else
+            free(names[i]);
+    }
+    free(names);
+    return 0;
+
+nomem:
+    if (d)
+        closedir(d);
+    for (i = 0; i < n; i++)
+        free(names[i]);
+    free(names);
+    return -ENOMEM;
+}
+
+/* The block at the current offset, moving on to later segments as needed */
+static const struct rmon_journal_block *block_at(struct rmon_journal *j)
+{
+    const struct rmon_journal_block *blk;
+    struct rmon_journal_seg *seg;
+    uint64_t end;
+
+    for (; j->cur < j->nsegs; j->cur++, j->off = 0) {
+        seg = &j->segs[j->cur];
+        end = atomic_load_explicit(&((struct rmon_journal_hdr *)seg->hdr)->data_end,
+                                   memory_order_acquire);
+        if (end > seg->hdr->data_size || j->off + sizeof(*blk) > end)
+            continue;
+        blk = (const struct rmon_journal_block *)(seg->data + j->off);
+        if (blk->magic != RMON_JOURNAL_BLOCK_MAGIC || j->off + RMON_JOURNAL_BLOCK_SPAN(blk) > end)
+            continue;
+        return blk;
+    }
+    return NULL;
+}
+
+static int load_block(struct rmon_journal *j, const struct rmon_journal_block *blk)
+{
+    unsigned char *buf;
+    int n;
+
+    if (blk->raw_len > j->cap) {
+        buf = realloc(j->buf, blk->raw_len);
+        if (!buf)
+            return -ENOMEM;
+        j->buf = buf;
+        j->cap = blk->raw_len;
+    }
+    n = jc_decode(blk, j->buf, blk->raw_len);
+    if (n < 0 || (uint32_t)n != blk->records)
+        return -EPROTO;
+    j->len = blk->raw_len;
+    j->pos = 0;
+    j->next = j->off + RMON_JOURNAL_BLOCK_SPAN(blk);
+    j->loaded = 1;
+    j->blocks++;
+    return 0;
+}
+
+/* The record at the current position, decoding the next block as needed */
+static const struct rmon_rec_hdr *peek(struct rmon_journal *j)
+{
+    const struct rmon_journal_block *blk;
+    const struct rmon_rec_hdr *rec;
+
+    for (;;) {
+        if (j->loaded) {
+            rec = (const struct rmon_rec_hdr *)(j->buf + j->pos);
+            if (j->pos < j->len && rmon_rec_check(rec, j->len - j->pos) == 0)
+                return rec;
+            j->off = j->next;
+            j->loaded = 0;
+        }
+        blk = block_at(j);
+        if (!blk)
+            return NULL;
+        if (load_block(j, blk) < 0)
+            j->off += RMON_JOURNAL_BLOCK_SPAN(blk);
+    }
+}
+
+/* Returns 1 with a record, 0 at the end of the journal */
+int rmon_journal_next(struct rmon_journal *j, const struct rmon_rec_hdr **rec)
+{
+    const struct rmon_rec_hdr *r = peek(j);
+
+    if (!r)
+        return 0;
+    j->pos += r->len;
+    j->scanned++;
+    *rec = r;
+    return 1;
+}
+
+/* Offset of the last index entry whose key is <= key */
+static uint64_t index_lookup(const struct rmon_journal_hdr *hdr, uint64_t key, int by_seq)
+{
+    const struct rmon_journal_index *idx = rmon_journal_index(hdr);
+    uint32_t lo = 0, hi, mid;
+
+    hi = atomic_load_explicit(&((struct rmon_journal_hdr *)hdr)->index_len, memory_order_acquire);
+    if (hi > hdr->index_cap)
+        hi = hdr->index_cap;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((by_seq ? idx[mid].seq : idx[mid].ts) <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo ? idx[lo - 1].offset : 0;
+}
+
+/* Whole blocks are skipped by their last record, only the last one is decoded */
+static void skip_before(struct rmon_journal *j, uint64_t key, int by_seq)
+{
+    const struct rmon_journal_block *blk;
+    const struct rmon_rec_hdr *rec;
+
+    j->loaded = 0;
+    while ((blk = block_at(j)) && (by_seq ? blk->last_seq : blk->last_ts) < key)
+        j->off += RMON_JOURNAL_BLOCK_SPAN(blk);
+    while ((rec = peek(j)) && (by_seq ? rec->seq : rec->ts) < key) {
+        j->pos += rec->len;
+        j->scanned++;
+    }
+}
+
+/*
+ * Positions the journal at the first record at or after ts: the segment
+ * by its start time, the block by the index, the record by a short scan.
+ */
+int rmon_journal_seek_time(struct rmon_journal *j, uint64_t ts)
+{
+    int lo = 0, hi = j->nsegs, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (j->segs[mid].hdr->first_ts <= ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    j->cur = lo ? lo - 1 : 0;
+    j->off = j->cur < j->nsegs ? index_lookup(j->segs[j->cur].hdr, ts, 0) : 0;
+    skip_before(j, ts, 0);
+    return 0;
+}
+
+/* Sequence numbers are looked up in the most recent run */
+int rmon_journal_seek_seq(struct rmon_journal *j, uint64_t seq)
+{
+    uint64_t run;
+    int i, first;
+
+    if (!j->nsegs)
+        return -ENOENT;
+
+    run = j->segs[j->nsegs - 1].hdr->run;
+    for (first = j->nsegs - 1; first > 0 && j->segs[first - 1].hdr->run == run; first--)
+        ;
+    for (i = j->nsegs - 1; i > first && j->segs[i].hdr->first_seq > seq; i--)
+        ;
+
+    j->cur = i;
+    j->off = index_lookup(j->segs[i].hdr, seq, 1);
+    skip_before(j, seq, 1);
+    return 0;
+}
+
+void rmon_journal_close(struct rmon_journal *j)
+{
+    int i;
+
+    for (i = 0; i < j->nsegs; i++) {
+        munmap((void *)j->segs[i].hdr, j->segs[i].map_size);
+        free(j->segs[i].path);
+    }
+    free(j->segs);
+    free(j->buf);
+    memset(j, 0, sizeof(*j));
+}
@@ -0,0 +1,158 @@
+/*
+ * Route monitor - latency histograms
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdatomic.h>
+
+#include "latency.h"
+#include "metrics.h"
+
+/*
+ * Values below LAT_SUB get a bucket each, every power of two above that
+ * is split into LAT_SUB / 2 buckets. Anything beyond 2^LAT_RANGE_BITS ns
+ * (about 68 s) lands in the last bucket.
+ */
+#define LAT_SUB_BITS    6
+#define LAT_SUB         (1 << LAT_SUB_BITS)
+#define LAT_RANGE_BITS  36
+#define LAT_BUCKETS     (LAT_SUB + (LAT_RANGE_BITS - LAT_SUB_BITS) * LAT_SUB / 2)
+
+struct lat_hist {
+    _Atomic uint64_t buckets[LAT_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+};
+
+static struct lat_hist hists[LAT_MAX];
+
+static const char *stage_names[LAT_MAX] = {
+    [LAT_LANE] = "lane",
+    [LAT_PARSE] = "parse",
+    [LAT_HANDLE] = "handle",
+    [LAT_TOTAL] = "total",
+    [LAT_OUTPUT] = "output",
+};
+
+static unsigned int bucket(uint64_t v)
+{
+    int e;
+
+    if (v < LAT_SUB)
+        return v;
+    if (v >> LAT_RANGE_BITS)
+        return LAT_BUCKETS - 1;
+    e = 63 - __builtin_clzll(v);
+    return LAT_SUB + (e - LAT_SUB_BITS) * LAT_SUB / 2 +
+           (v >> (e - LAT_SUB_BITS + 1)) - LAT_SUB / 2;
+}
+
+/* Middle of a bucket */
+static uint64_t bucket_value(unsigned int b)
+{
+    unsigned int e, m;
+
+    if (b < LAT_SUB)
+        return b;
+    e = (b - LAT_SUB) / (LAT_SUB / 2) + LAT_SUB_BITS;
+    m = (b - LAT_SUB) % (LAT_SUB / 2) + LAT_SUB / 2;
+    return ((uint64_t)m << (e - LAT_SUB_BITS + 1)) + (1ULL << (e - LAT_SUB_BITS)) - 1;
+}
+
+/* Single writer per histogram, see lat_stage */
+static void inc(_Atomic uint64_t *v, uint64_t n)
+{
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+void lat_record(enum lat_stage stage, uint64_t ns)
+{
+    struct lat_hist *h = &hists[stage];
+
+    /* Clock steps can make realtime differences negative */
+    if ((int64_t)ns < 0)
+        ns = 0;
+    inc(&h->buckets[bucket(ns)], 1);
+    inc(&h->count, 1);
+    inc(&h->sum, ns);
+    if (ns > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+}
+
+uint64_t lat_quantile(enum lat_stage stage, double q)
+{
+    struct lat_hist *h = &hists[stage];
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    uint64_t rank, seen = 0, max;
+    unsigned int b;
+
+    if (!count)
+        return 0;
+    rank = q * count;
+    if (rank >= count)
+        rank = count - 1;
+    max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (b = 0; b < LAT_BUCKETS; b++) {
+        seen += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+        if (seen > rank)
+            return bucket_value(b) < max ? bucket_value(b) : max;
+    }
+    return max;
+}
+
+void lat_report(FILE *f)
+{
+    struct lat_hist *h;
+    int i;
+
+    for (i = 0; i < LAT_MAX; i++) {
+        h = &hists[i];
+        fprintf(f, "Latency %s: samples: %llu p50: %.1f us p99: %.1f us p999: %.1f us "
+                "max: %.1f us\n", stage_names[i], (unsigned long long)atomic_load(&h->count),
+                lat_quantile(i, 0.5) / 1e3, lat_quantile(i, 0.99) / 1e3,
+                lat_quantile(i, 0.999) / 1e3, atomic_load(&h->max) / 1e3);
+    }
+}
+
+void lat_metrics(struct metrics_writer *w, void *data)
+{
+    static const struct {
+        double q;
+        const char *label;
+    } quantiles[] = {
+        { 0.5, "0.5" },
+        { 0.99, "0.99" },
+        { 0.999, "0.999" },
+    };
+    char labels[64];
+    unsigned int i, j;
+
+    for (i = 0; i < LAT_MAX; i++) {
+        for (j = 0; j < sizeof(quantiles) / sizeof(quantiles[0]); j++) {
+            snprintf(labels, sizeof(labels), "stage=\"%s\",quantile=\"%s\"", stage_names[i],
+                     quantiles[j].label);
+            metrics_put(w, "rmon_latency_seconds", "summary",
+                        "Event latency by stage, from reading the netlink message.", labels,
+                        lat_quantile(i, quantiles[j].q) / 1e9);
+        }
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", stage_names[i]);
+        metrics_put(w, "rmon_latency_seconds_sum", NULL, NULL, labels,
+                    atomic_load(&hists[i].sum) / 1e9);
+        metrics_put(w, "rmon_latency_seconds_count", NULL, NULL, labels,
+                    atomic_load(&hists[i].count));
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ * Route monitor - latency histograms
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_LATENCY_H
+#define RMON_LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Where the time between reading a netlink message and writing out the
+ * events it caused goes. Each stage has its own log-linear histogram
+ * (values within about 3%), written by one thread only: LAT_OUTPUT by the
+ * emitter, the rest by the main thread.
+ */
+enum lat_stage {
+    LAT_LANE,       /* read off the socket until handed to libnl */
+    LAT_PARSE,      /* libnl parsing and cache update until the callback */
+    LAT_HANDLE,     /* callback, including invalidation, until the event */
+    LAT_TOTAL,      /* read off the socket until the event */
+    LAT_OUTPUT,     /* event until written out */
+    LAT_MAX
+};
+
+struct metrics_writer;
+
+void lat_record(enum lat_stage stage, uint64_t ns);
+uint64_t lat_quantile(enum lat_stage stage, double q);
+void lat_report(FILE *f);
+void lat_metrics(struct metrics_writer *w, void *data);
+
+#endif
@@ -0,0 +1,426 @@
+/*
+ * Route monitor - memory accounting
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/errno.h>
+#include <linux/rtnetlink.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "mem.h"
+
+#define MEM_TABLE_BITS  16
+
+/* glibc's allocator under the hooks, it has no other way in since 2.34 */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+struct mem_block {
+    uintptr_t ptr;              /* 0 marks an empty slot */
+    size_t size;
+    enum mem_domain domain;
+};
+
+struct mem_stats {
+    size_t bytes;
+    size_t blocks;
+    long mapped;
+    size_t (*count)(void *);
+    void *arg;
+};
+
+static struct {
+    int on;
+    pthread_mutex_t lock;
+    struct mem_block *blocks;   /* open addressing, mmap()ed so not tracked itself */
+    unsigned int bits;
+    size_t used;
+    struct mem_stats dom[MEM_MAX];
+} mem = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static __thread enum mem_domain mem_cur;
+
+static const char *domain_names[MEM_MAX] = {
+    [MEM_OTHER] = "other",
+    [MEM_ROUTES] = "routes",
+    [MEM_LINKS] = "links",
+    [MEM_ADDRS] = "addrs",
+    [MEM_FP] = "fingerprints",
+    [MEM_MOVES] = "moves",
+    [MEM_DAMP] = "damp",
+    [MEM_RX] = "rx",
+    [MEM_OUT] = "out",
+    [MEM_RING] = "ring",
+    [MEM_SUB] = "sub",
+    [MEM_JOURNAL] = "journal",
+    [MEM_CAPTURE] = "capture",
+    [MEM_METRICS] = "metrics",
+    [MEM_SELF] = "memstats",
+};
+
+static size_t home(uintptr_t ptr, unsigned int bits)
+{
+    return ((uint64_t)(ptr >> 4) * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+}
+
+static struct mem_block *table_alloc(unsigned int bits)
+{
+    void *p = mmap(NULL, sizeof(struct mem_block) << bits, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static struct mem_block *slot(struct mem_block *blocks, unsigned int bits, uintptr_t ptr)
+{
+    size_t mask = ((size_t)1 << bits) - 1;
+    size_t i = home(ptr, bits);
+
+    while (blocks[i].ptr && blocks[i].ptr != ptr)
+        i = (i + 1) & mask;
+    return &blocks[i];
+}
+
+static int grow(void)
+{
+    struct mem_block *blocks = table_alloc(mem.bits + 1);
+    size_t i, old = (size_t)1 << mem.bits;
+
+    if (!blocks)
+        return -1;
+    for (i = 0; i < old; i++)
+        if (mem.blocks[i].ptr)
+            *slot(blocks, mem.bits + 1, mem.blocks[i].ptr) = mem.blocks[i];
+    munmap(mem.blocks, sizeof(*blocks) * old);
+    mem.blocks = blocks;
+    mem.bits++;
+    mem.dom[MEM_SELF].mapped += sizeof(*blocks) * old;
+    return 0;
+}
+
+/* Called with the lock held. A block the table can't take goes untracked. */
+static void track(void *p, enum mem_domain d)
+{
+    struct mem_block *b;
+
+    if (2 * (mem.used + 1) > (size_t)1 << mem.bits && grow() < 0)
+        return;
+    b = slot(mem.blocks, mem.bits, (uintptr_t)p);
+    if (b->ptr) {
+        mem.dom[b->domain].bytes -= b->size;
+        mem.dom[b->domain].blocks--;
+    } else {
+        mem.used++;
+    }
+    b->ptr = (uintptr_t)p;
+    b->size = malloc_usable_size(p);
+    b->domain = d;
+    mem.dom[d].bytes += b->size;
+    mem.dom[d].blocks++;
+}
+
+/* Called with the lock held, returns the domain of p or -1 if not tracked */
+static int untrack(void *p)
+{
+    size_t mask = ((size_t)1 << mem.bits) - 1;
+    struct mem_block *b = slot(mem.blocks, mem.bits, (uintptr_t)p);
+    size_t i, j, h;
+    int d;
+
+    if (!b->ptr)
+        return -1;
+    d = b->domain;
+    mem.dom[d].bytes -= b->size;
+    mem.dom[d].blocks--;
+    mem.used--;
+
+    i = b - mem.blocks;
+    for (j = (i + 1) & mask; mem.blocks[j].ptr; j = (j + 1) & mask) {
+        h = home(mem.blocks[j].ptr, mem.bits);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            mem.blocks[i] = mem.blocks[j];
+            i = j;
+        }
+    }
+    mem.blocks[i].ptr = 0;
+    return d;
+}
+
+static void *track_new(void *p)
+{
+    if (mem.on && p) {
+        pthread_mutex_lock(&mem.lock);
+        track(p, mem_cur);
+        pthread_mutex_unlock(&mem.lock);
+    }
+    return p;
+}
+
+void *malloc(size_t size)
+{
+    return track_new(__libc_malloc(size));
+}
+
+void *calloc(size_t n, size_t size)
+{
+    return track_new(__libc_calloc(n, size));
+}
+
+/*
+ * The old block leaves the table before glibc may hand its address to
+ * another thread. A moved block stays in the domain it was allocated in.
+ */
+void *realloc(void *p, size_t size)
+{
+    int d = -1;
+    void *q;
+
+    if (!mem.on)
+        return __libc_realloc(p, size);
+
+    if (p) {
+        pthread_mutex_lock(&mem.lock);
+        d = untrack(p);
+        pthread_mutex_unlock(&mem.lock);
+    }
+    q = __libc_realloc(p, size);
+    if (q || (p && size)) {
+        pthread_mutex_lock(&mem.lock);
+        if (q)
+            track(q, d < 0 ? mem_cur : (enum mem_domain)d);
+        else if (d >= 0)
+            track(p, d);
+        pthread_mutex_unlock(&mem.lock);
+    }
+    return q;
+}
+
+/* aligned_alloc() and posix_memalign() reject alignments memalign() rounds up */
+void *memalign(size_t align, size_t size)
+{
+    return track_new(__libc_memalign(align, size));
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    if (!align || (align & (align - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return track_new(__libc_memalign(align, size));
+}
+
+int posix_memalign(void **out, size_t align, size_t size)
+{
+    void *p;
+
+    if (align % sizeof(void *) || (align & (align - 1)))
+        return EINVAL;
+    p = track_new(__libc_memalign(align, size));
+    if (!p)
+        return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void *valloc(size_t size)
+{
+    return track_new(__libc_valloc(size));
+}
+
+void *pvalloc(size_t size)
+{
+    return track_new(__libc_pvalloc(size));
+}
+
+void free(void *p)
+{
+    if (mem.on && p) {
+        pthread_mutex_lock(&mem.lock);
+        untrack(p);
+        pthread_mutex_unlock(&mem.lock);
+    }
+    __libc_free(p);
+}
+
+/* Blocks allocated before this aren't tracked, their free() is ignored */
+int mem_enable(void)
+{
+    if (mem.on)
+        return 0;
+    mem.blocks = table_alloc(MEM_TABLE_BITS);
+    if (!mem.blocks)
+        return -NLE_NOMEM;
+    mem.bits = MEM_TABLE_BITS;
+    mem.dom[MEM_SELF].mapped = sizeof(*mem.blocks) << mem.bits;
+    mem.on = 1;
+    return 0;
+}
+
+int mem_enabled(void)
+{
+    return mem.on;
+}
+
+enum mem_domain mem_domain(enum mem_domain d)
+{
+    enum mem_domain prev = mem_cur;
+
+    mem_cur = d;
+    return prev;
+}
+
+enum mem_domain mem_msg_domain(int type)
+{
+    switch (type) {
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+        return MEM_ROUTES;
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+        return MEM_LINKS;
+    case RTM_NEWADDR:
+    case RTM_DELADDR:
+        return MEM_ADDRS;
+    default:
+        return MEM_OTHER;
+    }
+}
+
+void *mem_malloc(enum mem_domain d, size_t size)
+{
+    enum mem_domain prev = mem_domain(d);
+    void *p = malloc(size);
+
+    mem_domain(prev);
+    return p;
+}
+
+void *mem_calloc(enum mem_domain d, size_t n, size_t size)
+{
+    enum mem_domain prev = mem_domain(d);
+    void *p = calloc(n, size);
+
+    mem_domain(prev);
+    return p;
+}
+
+void *mem_realloc(enum mem_domain d, void *p, size_t size)
+{
+    enum mem_domain prev = mem_domain(d);
+    void *q = realloc(p, size);
+
+    mem_domain(prev);
+    return q;
+}
+
+void mem_mapped(enum mem_domain d, long bytes)
+{
+    pthread_mutex_lock(&mem.lock);
+    mem.dom[d].mapped += bytes;
+    pthread_mutex_unlock(&mem.lock);
+}
+
+void mem_entries(enum mem_domain d, size_t (*count)(void *), void *arg)
+{
+    mem.dom[d].count = count;
+    mem.dom[d].arg = arg;
+}
+
+void mem_usage(enum mem_domain d, struct mem_usage *u)
+{
+    pthread_mutex_lock(&mem.lock);
+    u->bytes = mem.dom[d].bytes;
+    u->blocks = mem.dom[d].blocks;
+    u->mapped = mem.dom[d].mapped;
+    pthread_mutex_unlock(&mem.lock);
+}
+
+const char *mem_domain_name(enum mem_domain d)
+{
+    return domain_names[d];
+}
+
+void mem_report(FILE *f)
+{
+    size_t heap = 0, mapped = 0, entries;
+    struct mem_usage u;
+    int d;
+
+    if (!mem.on)
+        return;
+    for (d = 0; d < MEM_MAX; d++) {
+        mem_usage(d, &u);
+        heap += u.bytes;
+        mapped += u.mapped;
+        if (!u.bytes && !u.mapped)
+            continue;
+        fprintf(f, "Memory %s: heap: %zu bytes in %zu blocks mapped: %zu bytes",
+                domain_names[d], u.bytes, u.blocks, u.mapped);
+        if (mem.dom[d].count) {
+            entries = mem.dom[d].count(mem.dom[d].arg);
+            fprintf(f, " entries: %zu per entry: %.1f bytes", entries,
+                    entries ? (double)(u.bytes + u.mapped) / entries : 0.0);
+        }
+        fputc('\n', f);
+    }
+    fprintf(f, "Memory total: heap: %zu bytes mapped: %zu bytes\n", heap, mapped);
+}
+
+void mem_metrics(struct metrics_writer *w, void *data)
+{
+    struct mem_usage u[MEM_MAX];
+    char labels[32];
+    int d;
+
+    for (d = 0; d < MEM_MAX; d++)
+        mem_usage(d, &u[d]);
+    for (d = 0; d < MEM_MAX; d++) {
+        snprintf(labels, sizeof(labels), "domain=\"%s\"", domain_names[d]);
+        metrics_put(w, "rmon_memory_heap_bytes", "gauge",
+                    "Heap memory held, by what holds it.", labels, u[d].bytes);
+    }
+    for (d = 0; d < MEM_MAX; d++) {
+        snprintf(labels, sizeof(labels), "domain=\"%s\"", domain_names[d]);
+        metrics_put(w, "rmon_memory_heap_blocks", "gauge",
+                    "Heap blocks held, by what holds them.", labels, u[d].blocks);
+    }
+    for (d = 0; d < MEM_MAX; d++) {
+        snprintf(labels, sizeof(labels), "domain=\"%s\"", domain_names[d]);
+        metrics_put(w, "rmon_memory_mapped_bytes", "gauge",
+                    "Mapped and static memory, by what holds it.", labels, u[d].mapped);
+    }
+    for (d = 0; d < MEM_MAX; d++) {
+        if (!mem.dom[d].count)
+            continue;
+        snprintf(labels, sizeof(labels), "domain=\"%s\"", domain_names[d]);
+        metrics_put(w, "rmon_memory_entries", "gauge",
+                    "Objects the memory of a domain is held for.", labels,
+                    mem.dom[d].count(mem.dom[d].arg));
+    }
+}
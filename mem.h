@@ -0,0 +1,85 @@
+/*
+ * Route monitor - memory accounting
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_MEM_H
+#define RMON_MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "metrics.h"
+
+/*
+ * With --memstats every malloc(), calloc(), realloc(), aligned allocation
+ * and free(), libnl's included, is tracked: each live block is charged to
+ * the domain its thread was in when it was allocated. libnl objects are
+ * charged to the cache of the message being parsed, rmon's own tables and
+ * buffers to the module holding them. Mappings are charged where they are
+ * made.
+ *
+ * Without --memstats the hooks only pass the calls on.
+ */
+enum mem_domain {
+    MEM_OTHER,
+    MEM_ROUTES,
+    MEM_LINKS,
+    MEM_ADDRS,
+    MEM_FP,
+    MEM_MOVES,
+    MEM_DAMP,
+    MEM_RX,
+    MEM_OUT,
+    MEM_RING,
+    MEM_SUB,
+    MEM_JOURNAL,
+    MEM_CAPTURE,
+    MEM_METRICS,
+    MEM_SELF,                   /* the block table of the accounting itself */
+    MEM_MAX
+};
+
+int mem_enable(void);
+int mem_enabled(void);
+
+/* Switches the calling thread to domain d, returns the one it was in */
+enum mem_domain mem_domain(enum mem_domain d);
+/* The cache the objects parsed out of an rtnetlink message go to */
+enum mem_domain mem_msg_domain(int type);
+
+void *mem_malloc(enum mem_domain d, size_t size);
+void *mem_calloc(enum mem_domain d, size_t n, size_t size);
+void *mem_realloc(enum mem_domain d, void *p, size_t size);
+
+/* Memory that isn't from malloc(): mappings and static tables */
+void mem_mapped(enum mem_domain d, long bytes);
+
+/* Objects held in domain d, for the bytes per entry */
+void mem_entries(enum mem_domain d, size_t (*count)(void *), void *arg);
+
+struct mem_usage {
+    size_t bytes;
+    size_t blocks;
+    size_t mapped;
+};
+
+void mem_usage(enum mem_domain d, struct mem_usage *u);
+const char *mem_domain_name(enum mem_domain d);
+
+void mem_report(FILE *f);
+void mem_metrics(struct metrics_writer *w, void *data);
+
+#endif
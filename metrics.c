@@ -0,0 +1,432 @@
+/*
+ * Route monitor - metrics
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "format.h"
+#include "mem.h"
+#include "metrics.h"
+
+#define METRICS_PAGE_SIZE   (64 * 1024)
+#define METRICS_PAGE_MAX    (16 * 1024 * 1024)
+#define METRICS_HEAD_MAX    160     /* HTTP response head, ahead of the page */
+#define METRICS_TIMEOUT     5000    /* ms a client has to ask and read */
+#define METRICS_COLLECTORS  16
+
+__thread struct metrics_shard *metrics_self;
+
+struct metrics_client {
+    int fd;
+    uint64_t deadline;
+    char *out;          /* response being sent, from outoff to outlen */
+    size_t outoff;
+    size_t outlen;
+    size_t inlen;
+    char in[256];
+};
+
+static struct {
+    _Atomic(struct metrics_shard *) shards;
+    struct {
+        metrics_collect_fn fn;
+        void *data;
+    } collectors[METRICS_COLLECTORS];
+    int ncollectors;
+    int listen_fd;
+    const char *path;
+    struct metrics_client clients[METRICS_MAX_CLIENTS];
+    uint64_t scrapes;
+    uint64_t dropped;
+    uint64_t timeouts;
+} metrics = {
+    .listen_fd = -1,
+};
+
+static const char *cb_names[METRIC_CB_MAX] = {
+    [METRIC_CB_ROUTE] = "route",
+    [METRIC_CB_LINK] = "link",
+    [METRIC_CB_ADDR] = "addr",
+};
+
+/* Gives the calling thread its shard; shards stay around until exit */
+int metrics_thread(const char *name)
+{
+    struct metrics_shard *s = mem_calloc(MEM_METRICS, 1, sizeof(*s));
+
+    if (!s)
+        return -NLE_NOMEM;
+    s->thread = name;
+    s->next = atomic_load(&metrics.shards);
+    while (!atomic_compare_exchange_weak(&metrics.shards, &s->next, s))
+        ;
+    metrics_self = s;
+    return 0;
+}
+
+int metrics_collector(metrics_collect_fn fn, void *data)
+{
+    if (metrics.ncollectors == METRICS_COLLECTORS)
+        return -NLE_RANGE;
+    metrics.collectors[metrics.ncollectors].fn = fn;
+    metrics.collectors[metrics.ncollectors++].data = data;
+    return 0;
+}
+
+/* Appends to the page, doubling it up to METRICS_PAGE_MAX */
+static int put_line(struct metrics_writer *w, const char *fmt, ...)
+{
+    va_list ap;
+    size_t cap;
+    char *buf;
+    int n;
+
+    for (;;) {
+        va_start(ap, fmt);
+        n = w->buf ? vsnprintf(w->buf + w->len, w->cap - w->len, fmt, ap) : 0;
+        va_end(ap);
+        if (n < 0)
+            return -NLE_INVAL;
+        if (w->buf && (size_t)n < w->cap - w->len)
+            break;
+
+        cap = w->cap ? 2 * w->cap : METRICS_PAGE_SIZE;
+        if (cap > METRICS_PAGE_MAX)
+            return -NLE_NOMEM;
+        buf = mem_realloc(MEM_METRICS, w->buf, cap);
+        if (!buf)
+            return -NLE_NOMEM;
+        w->buf = buf;
+        w->cap = cap;
+    }
+    w->len += n;
+    return 0;
+}
+
+/* A sample that doesn't fit is counted, and takes its HELP and TYPE along */
+void metrics_put(struct metrics_writer *w, const char *name, const char *type,
+                 const char *help, const char *labels, double value)
+{
+    const char *last = w->last;
+    size_t len = w->len;
+
+    if (help && (!w->last || strcmp(w->last, name))) {
+        if (put_line(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type) < 0)
+            goto drop;
+        w->last = name;
+    }
+    if ((labels ? put_line(w, "%s{%s} %.15g\n", name, labels, value) :
+         put_line(w, "%s %.15g\n", name, value)) < 0)
+        goto drop;
+    return;
+
+drop:
+    w->len = len;
+    w->last = last;
+    w->dropped++;
+}
+
+static uint64_t sum(unsigned int m)
+{
+    struct metrics_shard *s;
+    uint64_t v = 0;
+
+    for (s = atomic_load(&metrics.shards); s; s = s->next)
+        v += atomic_load_explicit(&s->v[m], memory_order_relaxed);
+    return v;
+}
+
+static void put_rss(struct metrics_writer *w)
+{
+    unsigned long size, rss;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (!f)
+        return;
+    if (fscanf(f, "%lu %lu", &size, &rss) == 2)
+        metrics_put(w, "rmon_resident_bytes", "gauge", "Resident set size.", NULL,
+                    (double)rss * sysconf(_SC_PAGESIZE));
+    fclose(f);
+}
+
+/* Renders the page after what the writer holds already */
+static void render(struct metrics_writer *w)
+{
+    char labels[64];
+    const char *name;
+    int i;
+
+    for (i = 1; i < RMON_REC_MAX; i++) {
+        name = rmon_rec_type_name(i);
+        if (!name || i == RMON_REC_STREAM)
+            continue;
+        snprintf(labels, sizeof(labels), "type=\"%s\"", name);
+        metrics_put(w, "rmon_events_total", "counter", "Events emitted by type.", labels,
+                    sum(METRIC_EVENTS + i));
+    }
+    for (i = 0; i < METRIC_CB_MAX; i++) {
+        snprintf(labels, sizeof(labels), "callback=\"%s\"", cb_names[i]);
+        metrics_put(w, "rmon_callback_calls_total", "counter",
+                    "Cache change callbacks run.", labels, sum(METRIC_CB_CALLS + i));
+    }
+    for (i = 0; i < METRIC_CB_MAX; i++) {
+        snprintf(labels, sizeof(labels), "callback=\"%s\"", cb_names[i]);
+        metrics_put(w, "rmon_callback_seconds_total", "counter",
+                    "Time spent in cache change callbacks.", labels,
+                    sum(METRIC_CB_NS + i) / 1e9);
+    }
+    metrics_put(w, "rmon_output_writes_total", "counter", "Output writes.", NULL,
+                sum(METRIC_OUT_WRITES));
+    metrics_put(w, "rmon_output_bytes_total", "counter", "Output bytes written.", NULL,
+                sum(METRIC_OUT_BYTES));
+    metrics_put(w, "rmon_output_write_seconds_total", "counter",
+                "Time spent in output writes.", NULL, sum(METRIC_OUT_WRITE_NS) / 1e9);
+    put_rss(w);
+    metrics_put(w, "rmon_metrics_scrapes_total", "counter", "Metrics scrapes served.", NULL,
+                metrics.scrapes);
+
+    /* Early on, so it still fits on a page that doesn't */
+    metrics_put(w, "rmon_metrics_dropped_samples_total", "counter",
+                "Samples left out of earlier scrapes for lack of memory.", NULL,
+                metrics.dropped);
+    metrics_put(w, "rmon_metrics_client_timeouts_total", "counter",
+                "Metrics clients dropped for taking too long.", NULL, metrics.timeouts);
+
+    for (i = 0; i < metrics.ncollectors; i++)
+        metrics.collectors[i].fn(w, metrics.collectors[i].data);
+}
+
+int metrics_init(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int i, err;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -NLE_INVAL;
+    strcpy(addr.sun_path, path);
+
+    metrics.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (metrics.listen_fd < 0)
+        return -nl_syserr2nlerr(errno);
+
+    unlink(path);
+    if (bind(metrics.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(metrics.listen_fd, 16) < 0) {
+        err = errno;
+        close(metrics.listen_fd);
+        metrics.listen_fd = -1;
+        return -nl_syserr2nlerr(err);
+    }
+
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++)
+        metrics.clients[i].fd = -1;
+    metrics.path = path;
+    return 0;
+}
+
+static void drop_client(struct metrics_client *c)
+{
+    close(c->fd);
+    free(c->out);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static void send_page(struct metrics_client *c)
+{
+    ssize_t n;
+
+    while (c->outoff < c->outlen) {
+        n = send(c->fd, c->out + c->outoff, c->outlen - c->outoff,
+                 MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                drop_client(c);
+            return;
+        }
+        c->outoff += n;
+    }
+    drop_client(c);
+}
+
+/* One page per connection, sent as the socket takes it */
+static void respond(struct metrics_client *c, int http)
+{
+    struct metrics_writer w = { .len = METRICS_HEAD_MAX };
+    size_t len;
+    int n = 0;
+
+    render(&w);
+    metrics.dropped += w.dropped;
+    metrics.scrapes++;
+    if (!w.buf) {
+        drop_client(c);
+        return;
+    }
+
+    len = w.len - METRICS_HEAD_MAX;
+    if (http)
+        n = snprintf(w.buf, METRICS_HEAD_MAX, "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+    memmove(w.buf + METRICS_HEAD_MAX - n, w.buf, n);
+    c->out = w.buf;
+    c->outoff = METRICS_HEAD_MAX - n;
+    c->outlen = w.len;
+    send_page(c);
+}
+
+/* HTTP clients get their answer after the request head, others at EOF */
+static void read_request(struct metrics_client *c)
+{
+    ssize_t n;
+
+    n = recv(c->fd, c->in + c->inlen, sizeof(c->in) - 1 - c->inlen, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n < 0) {
+        drop_client(c);
+        return;
+    }
+    if (n == 0) {
+        respond(c, 0);
+        return;
+    }
+    c->inlen += n;
+    c->in[c->inlen] = '\0';
+    if (strncmp(c->in, "GET ", c->inlen < 4 ? c->inlen : 4))
+        respond(c, 0);
+    else if (strstr(c->in, "\r\n\r\n") || strstr(c->in, "\n\n") ||
+             c->inlen == sizeof(c->in) - 1)
+        respond(c, 1);
+}
+
+static void accept_client(void)
+{
+    int fd, i;
+
+    fd = accept4(metrics.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metrics.clients[i].fd < 0) {
+            metrics.clients[i].fd = fd;
+            metrics.clients[i].deadline = metrics_now() + METRICS_TIMEOUT * 1000000ULL;
+            return;
+        }
+    }
+    close(fd);
+}
+
+/* Milliseconds until the next client runs out of time, -1 without clients */
+int metrics_timeout(void)
+{
+    uint64_t now, due = 0;
+    int i;
+
+    if (metrics.listen_fd < 0)
+        return -1;
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metrics.clients[i].fd >= 0 && (!due || metrics.clients[i].deadline < due))
+            due = metrics.clients[i].deadline;
+    }
+    if (!due)
+        return -1;
+    now = metrics_now();
+    if (now >= due)
+        return 0;
+    return (due - now + 999999) / 1000000;
+}
+
+/* Slots go back to the pool once a client has had its time */
+static void expire_clients(void)
+{
+    uint64_t now = metrics_now();
+    int i;
+
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metrics.clients[i].fd >= 0 && now >= metrics.clients[i].deadline) {
+            metrics.timeouts++;
+            drop_client(&metrics.clients[i]);
+        }
+    }
+}
+
+int metrics_pollfds(struct pollfd *pfd)
+{
+    int i, n = 0;
+
+    if (metrics.listen_fd < 0)
+        return 0;
+
+    pfd[n].fd = metrics.listen_fd;
+    pfd[n].events = POLLIN;
+    pfd[n++].revents = 0;
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        pfd[n].fd = metrics.clients[i].fd;
+        pfd[n].events = metrics.clients[i].out ? POLLOUT : POLLIN;
+        pfd[n++].revents = 0;
+    }
+    return n;
+}
+
+void metrics_handle(const struct pollfd *pfd, int n)
+{
+    struct metrics_client *c;
+    int i;
+
+    if (!n)
+        return;
+    for (i = 1; i < n; i++) {
+        c = &metrics.clients[i - 1];
+        if (pfd[i].fd < 0 || c->fd != pfd[i].fd)
+            continue;
+        if (c->out && (pfd[i].revents & (POLLHUP | POLLERR)))
+            drop_client(c);
+        else if (c->out && (pfd[i].revents & POLLOUT))
+            send_page(c);
+        else if (!c->out && (pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            read_request(c);
+    }
+    expire_clients();
+    if (pfd[0].revents & POLLIN)
+        accept_client();
+}
+
+void metrics_close(void)
+{
+    int i;
+
+    if (metrics.listen_fd < 0)
+        return;
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++)
+        if (metrics.clients[i].fd >= 0)
+            drop_client(&metrics.clients[i]);
+    close(metrics.listen_fd);
+    unlink(metrics.path);
+    metrics.listen_fd = -1;
+}
@@ -0,0 +1,118 @@
+/*
+ * Route monitor - metrics
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_METRICS_H
+#define RMON_METRICS_H
+
+#include <poll.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Counters live in per-thread shards, so updating one is a plain add on
+ * memory only the calling thread writes. A scrape sums the shards and
+ * asks the registered collectors for everything else (gauges and the
+ * modules' own statistics).
+ *
+ * --metrics=PATH serves the Prometheus text format on a Unix stream
+ * socket, to an HTTP GET (curl --unix-socket PATH http://localhost/metrics)
+ * as well as to a client that just closes its side. A client has a few
+ * seconds to ask and read the page before its slot is taken back.
+ */
+enum metric_cb {
+    METRIC_CB_ROUTE,
+    METRIC_CB_LINK,
+    METRIC_CB_ADDR,
+    METRIC_CB_MAX
+};
+
+enum metric {
+    METRIC_EVENTS,                                              /* + record type */
+    METRIC_CB_CALLS = METRIC_EVENTS + RMON_REC_MAX,             /* + enum metric_cb */
+    METRIC_CB_NS = METRIC_CB_CALLS + METRIC_CB_MAX,             /* + enum metric_cb */
+    METRIC_OUT_WRITES = METRIC_CB_NS + METRIC_CB_MAX,
+    METRIC_OUT_BYTES,
+    METRIC_OUT_WRITE_NS,
+    METRIC_MAX
+};
+
+struct metrics_shard {
+    _Atomic uint64_t v[METRIC_MAX];
+    const char *thread;
+    struct metrics_shard *next;
+};
+
+extern __thread struct metrics_shard *metrics_self;
+
+/* Only the owning thread writes its shard, a scrape may read it any time */
+static inline void metric_add(unsigned int m, uint64_t n)
+{
+    struct metrics_shard *s = metrics_self;
+
+    if (s)
+        atomic_store_explicit(&s->v[m], atomic_load_explicit(&s->v[m], memory_order_relaxed) + n,
+                              memory_order_relaxed);
+}
+
+static inline uint64_t metrics_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void metric_time(enum metric_cb cb, uint64_t start)
+{
+    metric_add(METRIC_CB_CALLS + cb, 1);
+    metric_add(METRIC_CB_NS + cb, metrics_now() - start);
+}
+
+struct metrics_writer {
+    char *buf;
+    size_t len;
+    size_t cap;
+    const char *last;           /* metric family written last */
+    uint64_t dropped;           /* samples that did not fit */
+};
+
+typedef void (*metrics_collect_fn)(struct metrics_writer *w, void *data);
+
+/*
+ * Samples of one family must be put one after the other. A NULL help
+ * continues the family put last, for the _sum and _count of a summary.
+ */
+void metrics_put(struct metrics_writer *w, const char *name, const char *type,
+                 const char *help, const char *labels, double value);
+
+int metrics_thread(const char *name);
+int metrics_collector(metrics_collect_fn fn, void *data);
+
+#define METRICS_MAX_CLIENTS 4
+#define METRICS_POLLFDS     (1 + METRICS_MAX_CLIENTS)
+
+int metrics_init(const char *path);
+int metrics_pollfds(struct pollfd *pfd);
+int metrics_timeout(void);
+void metrics_handle(const struct pollfd *pfd, int n);
+void metrics_close(void);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Route monitor - route moves
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "moves.h"
+
+struct move_slot {
+    struct route_move mv;
+    int taken;
+};
+
+static struct {
+    struct move_slot *slots;
+    size_t cap;
+    size_t used;
+} moves;
+
+static struct move_slot *slot(uint64_t key)
+{
+    size_t mask = moves.cap - 1;
+    size_t i = key & mask;
+
+    while (moves.slots[i].mv.key && moves.slots[i].mv.key != key)
+        i = (i + 1) & mask;
+    return &moves.slots[i];
+}
+
+static int resize(size_t cap)
+{
+    struct move_slot *old = moves.slots;
+    size_t old_cap = moves.cap;
+    size_t i;
+
+    moves.slots = mem_calloc(MEM_MOVES, cap, sizeof(*moves.slots));
+    if (!moves.slots) {
+        moves.slots = old;
+        return -NLE_NOMEM;
+    }
+    moves.cap = cap;
+    for (i = 0; i < old_cap; i++)
+        if (old[i].mv.key)
+            *slot(old[i].mv.key) = old[i];
+    free(old);
+    return 0;
+}
+
+int moves_hold(const struct route_move *mv)
+{
+    struct move_slot *e;
+
+    if (2 * (moves.used + 1) > moves.cap && resize(moves.cap ? 2 * moves.cap : 256) < 0)
+        return -NLE_NOMEM;
+
+    e = slot(mv->key);
+    if (!e->mv.key)
+        moves.used++;
+    e->mv = *mv;
+    e->taken = 0;
+    return 0;
+}
+
+/* Entries are only removed in bulk by moves_flush(), a taken one is just marked */
+int moves_take(uint64_t key, struct route_move *mv)
+{
+    struct move_slot *e;
+
+    if (!moves.used)
+        return 0;
+
+    e = slot(key);
+    if (!e->mv.key || e->taken)
+        return 0;
+    *mv = e->mv;
+    e->taken = 1;
+    return 1;
+}
+
+/* Reports deletions whose re-addition never arrived and empties the table */
+void moves_flush(void (*fn)(struct route_move *, void *), void *arg)
+{
+    size_t i;
+
+    if (!moves.used)
+        return;
+
+    for (i = 0; i < moves.cap; i++) {
+        if (moves.slots[i].mv.key && !moves.slots[i].taken)
+            fn(&moves.slots[i].mv, arg);
+    }
+    memset(moves.slots, 0, moves.cap * sizeof(*moves.slots));
+    moves.used = 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Route monitor - route moves
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_MOVES_H
+#define RMON_MOVES_H
+
+#include <stdint.h>
+
+#include "event.h"
+
+/*
+ * Deletions that are followed by a re-addition of the same route key in
+ * the same batch are parked here until the addition arrives, so both can be
+ * reported as one "Route moved" event. The deletion event is kept as built.
+ */
+struct route_move {
+    uint64_t key;
+    struct rmon_event ev;
+};
+
+int moves_hold(const struct route_move *mv);
+int moves_take(uint64_t key, struct route_move *mv);
+void moves_flush(void (*fn)(struct route_move *, void *), void *arg);
+
+#endif
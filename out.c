@@ -0,0 +1,728 @@
+/*
+ * Route monitor - buffered output
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/errno.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event.h"
+#include "format.h"
+#include "latency.h"
+#include "mem.h"
+#include "metrics.h"
+#include "out.h"
+
+#define OUT_CHUNKS          16
+#define OUT_CHUNK_SIZE      (64 * 1024)
+#define OUT_DEADLINE_USEC   1000
+#define OUT_STATUS_MAX      512
+#define OUT_RETRY_MSEC      10
+#define OUT_STAMPS          (OUT_CHUNKS * OUT_CHUNK_SIZE / 32)
+
+/* Queue entries that are not events; type 0 pads the end of the queue */
+#define OUT_REC_PAD         0
+#define OUT_REC_STATUS      0xfd
+#define OUT_REC_BATCH       0xfe
+#define OUT_REC_FLUSH       0xff
+#define OUT_REC_MAX         (sizeof(struct rmon_rec_hdr) + OUT_STATUS_MAX)
+
+#define ALIGN8(n)           (((n) + 7) & ~(size_t)7)
+
+_Static_assert(sizeof(struct rmon_event) <= OUT_REC_MAX, "events don't fit queue entries");
+
+union out_rec {
+    struct rmon_rec_hdr hdr;
+    char buf[OUT_REC_MAX];
+};
+
+/*
+ * The main thread (producer) queues records, the emitter thread formats
+ * and writes them. Only the producer moves head; both move tail, the
+ * producer only when dropping the oldest entries.
+ */
+static struct {
+    /* Set up before the emitter starts */
+    int fd;
+    enum out_format format;
+    int (*formatter)(const struct rmon_rec_hdr *rec, char *buf, size_t len);
+    enum out_policy policy;
+    enum out_overflow overflow;
+    uint64_t deadline_ns;
+    size_t queue_size;
+    unsigned char *q;
+    int data_fd;                /* wakes the emitter */
+    int space_fd;               /* wakes the producer */
+    pthread_t thread;
+    int running;
+
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t done;      /* last flush marker written out */
+    _Atomic int emitter_waiting;
+    _Atomic int producer_waiting;
+    _Atomic int stop;
+
+    /* Producer only */
+    uint64_t woken;
+    uint64_t marked;
+    uint64_t flushes;
+    uint64_t pending_drops;
+    uint64_t drop_first_seq;
+    uint64_t queued;
+    uint64_t dropped;
+    uint64_t blocked;
+    uint64_t high;
+    uint64_t wakeups;
+
+    /* Emitter only, counters are read by out_report() */
+    char *buf;
+    struct iovec iov[OUT_CHUNKS];
+    int chunk;
+    uint64_t first_ns;
+    uint64_t *stamps;           /* of the events in the chunks */
+    size_t nstamps;
+    _Atomic uint64_t events;
+    _Atomic uint64_t writes;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t forced;
+    _Atomic uint64_t errors;
+} out = {
+    .fd = -1,
+    .formatter = rmon_format_text,
+    .deadline_ns = OUT_DEADLINE_USEC * 1000ULL,
+    .queue_size = OUT_DEFAULT_QUEUE,
+    .data_fd = -1,
+    .space_fd = -1,
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Counters have a single writer, so no read-modify-write is needed */
+static void stat_add(_Atomic uint64_t *stat, uint64_t n)
+{
+    atomic_store_explicit(stat, atomic_load_explicit(stat, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+static uint64_t stat_get(_Atomic uint64_t *stat)
+{
+    return atomic_load_explicit(stat, memory_order_relaxed);
+}
+
+int out_set_format(const char *format)
+{
+    if (!strcmp(format, "text")) {
+        out.format = OUT_FORMAT_TEXT;
+        out.formatter = rmon_format_text;
+    } else if (!strcmp(format, "binary")) {
+        out.format = OUT_FORMAT_BINARY;
+        out.formatter = rmon_format_binary;
+    } else if (!strcmp(format, "jsonl")) {
+        out.format = OUT_FORMAT_JSONL;
+        out.formatter = rmon_format_jsonl;
+    } else {
+        return -NLE_INVAL;
+    }
+    return 0;
+}
+
+/* "batch", "event", "deadline" or "deadline:USEC" */
+int out_set_policy(const char *policy)
+{
+    char *end;
+
+    if (!strcmp(policy, "batch")) {
+        out.policy = OUT_FLUSH_BATCH;
+    } else if (!strcmp(policy, "event")) {
+        out.policy = OUT_FLUSH_EVENT;
+    } else if (!strncmp(policy, "deadline", 8)) {
+        out.policy = OUT_FLUSH_DEADLINE;
+        if (policy[8] == ':') {
+            out.deadline_ns = strtoul(policy + 9, &end, 0) * 1000ULL;
+            if (*end || end == policy + 9)
+                return -NLE_INVAL;
+        } else if (policy[8]) {
+            return -NLE_INVAL;
+        }
+    } else {
+        return -NLE_INVAL;
+    }
+    return 0;
+}
+
+/* "block", "drop-oldest" or "summarize" */
+int out_set_overflow(const char *overflow)
+{
+    if (!strcmp(overflow, "block"))
+        out.overflow = OUT_OVERFLOW_BLOCK;
+    else if (!strcmp(overflow, "drop-oldest"))
+        out.overflow = OUT_OVERFLOW_DROP_OLDEST;
+    else if (!strcmp(overflow, "summarize"))
+        out.overflow = OUT_OVERFLOW_SUMMARIZE;
+    else
+        return -NLE_INVAL;
+    return 0;
+}
+
+void out_set_queue(size_t size)
+{
+    out.queue_size = size;
+}
+
+/* Time from emitting each event just written out until now */
+static void record_stamps(void)
+{
+    struct timespec ts;
+    uint64_t now;
+    size_t i;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    for (i = 0; i < out.nstamps; i++)
+        lat_record(LAT_OUTPUT, now - out.stamps[i]);
+}
+
+static void write_chunks(void)
+{
+    struct iovec *iov = out.iov;
+    int cnt = out.chunk + 1;
+    uint64_t start;
+    ssize_t n;
+    int i;
+
+    if (!out.iov[0].iov_len)
+        return;
+
+    while (cnt) {
+        start = metrics_now();
+        n = writev(out.fd, iov, cnt);
+        metric_add(METRIC_OUT_WRITE_NS, metrics_now() - start);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            /* SIGPIPE is blocked here, pass it on like a write from the main thread would */
+            if (errno == EPIPE)
+                kill(getpid(), SIGPIPE);
+            if (!stat_get(&out.errors))
+                fprintf(stderr, "Output write failed: %s\n", strerror(errno));
+            stat_add(&out.errors, 1);
+            out.nstamps = 0;
+            break;
+        }
+        stat_add(&out.writes, 1);
+        stat_add(&out.bytes, n);
+        metric_add(METRIC_OUT_WRITES, 1);
+        metric_add(METRIC_OUT_BYTES, n);
+
+        /* Partial write: skip what went out and retry with the rest */
+        while (cnt && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    record_stamps();
+    out.nstamps = 0;
+    for (i = 0; i < OUT_CHUNKS; i++) {
+        out.iov[i].iov_base = out.buf + i * OUT_CHUNK_SIZE;
+        out.iov[i].iov_len = 0;
+    }
+    out.chunk = 0;
+}
+
+/*
+ * Runs a formatter against the room left in the current chunk, moving on
+ * to the next chunk (or flushing when none is left) if it doesn't fit.
+ * ts is when an event was emitted, 0 for anything else.
+ */
+static void put(int (*fmt)(const void *arg, char *buf, size_t len), const void *arg,
+                uint64_t ts)
+{
+    struct iovec *iov;
+    size_t room;
+    int n;
+
+    if (!out.iov[0].iov_len && out.policy == OUT_FLUSH_DEADLINE)
+        out.first_ns = now_ns();
+
+    for (;;) {
+        iov = &out.iov[out.chunk];
+        room = OUT_CHUNK_SIZE - iov->iov_len;
+
+        n = fmt(arg, (char *)iov->iov_base + iov->iov_len, room);
+        if (n < 0)
+            return;
+        if ((size_t)n < room || ((size_t)n == room && out.format == OUT_FORMAT_BINARY))
+            break;
+        if (!iov->iov_len)
+            return;
+
+        if (out.chunk + 1 < OUT_CHUNKS) {
+            out.chunk++;
+        } else {
+            stat_add(&out.forced, 1);
+            write_chunks();
+            if (out.policy == OUT_FLUSH_DEADLINE)
+                out.first_ns = now_ns();
+        }
+    }
+
+    iov->iov_len += n;
+    if (ts && out.nstamps < OUT_STAMPS)
+        out.stamps[out.nstamps++] = ts;
+    if (out.policy == OUT_FLUSH_EVENT)
+        write_chunks();
+}
+
+static int put_record(const void *arg, char *buf, size_t len)
+{
+    return out.formatter(arg, buf, len);
+}
+
+static int put_status(const void *arg, char *buf, size_t len)
+{
+    return snprintf(buf, len, "%s", (const char *)arg);
+}
+
+static void wake_producer(void)
+{
+    uint64_t one = 1;
+
+    if (atomic_load(&out.producer_waiting) && atomic_exchange(&out.producer_waiting, 0))
+        (void)!write(out.space_fd, &one, sizeof(one));
+}
+
+/*
+ * Takes the oldest entry off the queue. The producer may drop it in the
+ * meantime, then the copy is thrown away and the next one is tried.
+ */
+static int pop(union out_rec *rec)
+{
+    const struct rmon_rec_hdr *hdr;
+    uint64_t tail, head;
+    size_t len;
+    int pad;
+
+    for (;;) {
+        tail = atomic_load_explicit(&out.tail, memory_order_acquire);
+        head = atomic_load_explicit(&out.head, memory_order_acquire);
+        if (tail == head)
+            return 0;
+
+        hdr = (const struct rmon_rec_hdr *)(out.q + (tail & (out.queue_size - 1)));
+        len = hdr->len;
+        pad = hdr->type == OUT_REC_PAD;
+        if (!pad) {
+            if (len < sizeof(*hdr) || len > OUT_REC_MAX)
+                continue;
+            memcpy(rec, hdr, len);
+        }
+        if (!atomic_compare_exchange_strong(&out.tail, &tail, tail + ALIGN8(len)))
+            continue;
+        wake_producer();
+        if (!pad)
+            return 1;
+    }
+}
+
+static void handle(const struct rmon_rec_hdr *rec)
+{
+    switch (rec->type) {
+    case OUT_REC_STATUS:
+        put(put_status, rec + 1, 0);
+        break;
+    case OUT_REC_BATCH:
+        if (out.policy == OUT_FLUSH_BATCH)
+            write_chunks();
+        break;
+    case OUT_REC_FLUSH:
+        write_chunks();
+        atomic_store(&out.done, rec->seq);
+        wake_producer();
+        break;
+    default:
+        put(put_record, rec, rec->type != RMON_REC_STREAM ? rec->ts : 0);
+        if (rec->type != RMON_REC_STREAM)
+            stat_add(&out.events, 1);
+        break;
+    }
+}
+
+/* Sleeps until the producer queues more, the deadline (if any) passes or rmon stops */
+static void emitter_wait(int64_t timeout_ns)
+{
+    struct pollfd pfd = { .fd = out.data_fd, .events = POLLIN };
+    struct timespec ts = {
+        .tv_sec = timeout_ns / 1000000000,
+        .tv_nsec = timeout_ns % 1000000000,
+    };
+    uint64_t v;
+
+    atomic_store(&out.emitter_waiting, 1);
+    if (atomic_load(&out.head) == atomic_load(&out.tail) && !atomic_load(&out.stop))
+        ppoll(&pfd, 1, timeout_ns < 0 ? NULL : &ts, NULL);
+    (void)!read(out.data_fd, &v, sizeof(v));
+    atomic_store(&out.emitter_waiting, 0);
+}
+
+static void *emitter(void *arg)
+{
+    union out_rec rec;
+    int64_t left;
+
+    metrics_thread("emitter");
+    for (;;) {
+        if (pop(&rec)) {
+            handle(&rec.hdr);
+            continue;
+        }
+        if (atomic_load(&out.stop))
+            break;
+
+        left = -1;
+        if (out.policy == OUT_FLUSH_DEADLINE && out.iov[0].iov_len) {
+            left = out.first_ns + out.deadline_ns - now_ns();
+            if (left <= 0) {
+                write_chunks();
+                continue;
+            }
+        }
+        emitter_wait(left);
+    }
+    write_chunks();
+    return NULL;
+}
+
+static void wake_emitter(void)
+{
+    uint64_t one = 1;
+
+    out.woken = atomic_load_explicit(&out.head, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&out.emitter_waiting, 0)) {
+        (void)!write(out.data_fd, &one, sizeof(one));
+        out.wakeups++;
+    }
+}
+
+/* Sleeps until the emitter moved *what on from seen */
+static void wait_for(_Atomic uint64_t *what, uint64_t seen)
+{
+    struct pollfd pfd = { .fd = out.space_fd, .events = POLLIN };
+    uint64_t v;
+
+    atomic_store(&out.producer_waiting, 1);
+    wake_emitter();
+    if (atomic_load(what) == seen)
+        poll(&pfd, 1, -1);
+    (void)!read(out.space_fd, &v, sizeof(v));
+    atomic_store(&out.producer_waiting, 0);
+}
+
+/* Makes room for n bytes at head, fails if the entry is to be dropped instead */
+static int reserve(uint64_t head, size_t n, enum out_overflow overflow)
+{
+    const struct rmon_rec_hdr *hdr;
+    uint64_t tail;
+    int blocked = 0;
+
+    for (;;) {
+        tail = atomic_load_explicit(&out.tail, memory_order_acquire);
+        if (head + n - tail <= out.queue_size)
+            return 0;
+
+        switch (overflow) {
+        case OUT_OVERFLOW_BLOCK:
+            if (!blocked++)
+                out.blocked++;
+            wait_for(&out.tail, tail);
+            break;
+        case OUT_OVERFLOW_DROP_OLDEST:
+            hdr = (const struct rmon_rec_hdr *)(out.q + (tail & (out.queue_size - 1)));
+            if (atomic_compare_exchange_strong(&out.tail, &tail, tail + ALIGN8(hdr->len)) &&
+                hdr->type > OUT_REC_PAD && hdr->type < RMON_REC_MAX)
+                out.dropped++;
+            break;
+        default:
+            return -1;
+        }
+    }
+}
+
+/* Queues a record, keeping room for extra more bytes */
+static int push(const struct rmon_rec_hdr *rec, size_t extra, enum out_overflow overflow)
+{
+    uint64_t head = atomic_load_explicit(&out.head, memory_order_relaxed);
+    size_t off = head & (out.queue_size - 1);
+    size_t span = ALIGN8(rec->len);
+    size_t pad = out.queue_size - off < span ? out.queue_size - off : 0;
+    struct rmon_rec_hdr *hdr;
+
+    if (reserve(head, pad + span + extra, overflow) < 0)
+        return -1;
+
+    if (pad) {
+        hdr = (struct rmon_rec_hdr *)(out.q + off);
+        hdr->len = pad;
+        hdr->type = OUT_REC_PAD;
+        head += pad;
+        off = 0;
+    }
+    memcpy(out.q + off, rec, rec->len);
+    atomic_store_explicit(&out.head, head + span, memory_order_release);
+
+    head += span;
+    if (head - atomic_load_explicit(&out.tail, memory_order_relaxed) > out.high)
+        out.high = head - atomic_load_explicit(&out.tail, memory_order_relaxed);
+    if (head - out.woken >= out.queue_size / 4)
+        wake_emitter();
+    return 0;
+}
+
+/* Signals stay with the main thread, the emitter only writes */
+int out_init(int fd)
+{
+    sigset_t all, old;
+    int i, err;
+
+    out.buf = mem_malloc(MEM_OUT, OUT_CHUNKS * OUT_CHUNK_SIZE);
+    out.stamps = mem_malloc(MEM_OUT, OUT_STAMPS * sizeof(*out.stamps));
+    if (!out.buf || !out.stamps)
+        return -NLE_NOMEM;
+    for (i = 0; i < OUT_CHUNKS; i++) {
+        out.iov[i].iov_base = out.buf + i * OUT_CHUNK_SIZE;
+        out.iov[i].iov_len = 0;
+    }
+    out.fd = fd;
+
+    if (out.queue_size < 64 * 1024)
+        out.queue_size = 64 * 1024;
+    while (out.queue_size & (out.queue_size - 1))
+        out.queue_size &= out.queue_size - 1;
+    out.q = mem_malloc(MEM_OUT, out.queue_size);
+    if (!out.q)
+        return -NLE_NOMEM;
+
+    out.data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    out.space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (out.data_fd < 0 || out.space_fd < 0)
+        return -nl_syserr2nlerr(errno);
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    err = pthread_create(&out.thread, NULL, emitter, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err)
+        return -nl_syserr2nlerr(err);
+    out.running = 1;
+    return 0;
+}
+
+/* Non-text streams open with a stream record carrying the version */
+void out_start(void)
+{
+    struct rmon_event ev;
+
+    if (out.format == OUT_FORMAT_TEXT)
+        return;
+    event_stream(&ev);
+    push(&ev.hdr, 0, OUT_OVERFLOW_BLOCK);
+}
+
+/* Queues the drop notice, keeping room for extra more bytes */
+static int push_drops(size_t extra)
+{
+    struct rmon_event ev;
+
+    event_dropped(&ev, out.pending_drops, out.drop_first_seq);
+    if (push(&ev.hdr, extra, out.overflow) < 0)
+        return -1;
+    out.pending_drops = 0;
+    return 0;
+}
+
+/*
+ * Under the summarize policy events that don't fit are counted and a
+ * drop notice goes out ahead of the next event that does, or at the end
+ * of a batch once there is room.
+ */
+void out_event(const struct rmon_rec_hdr *rec)
+{
+    if (out.pending_drops && push_drops(ALIGN8(rec->len)) < 0)
+        goto drop;
+    if (push(rec, 0, out.overflow) == 0) {
+        out.queued++;
+        if (out.policy == OUT_FLUSH_EVENT)
+            wake_emitter();
+        return;
+    }
+
+drop:
+    if (!out.pending_drops++)
+        out.drop_first_seq = rec->seq;
+    out.dropped++;
+}
+
+/* Informational lines only belong into the text stream */
+void out_status(const char *fmt, ...)
+{
+    union out_rec rec;
+    va_list ap;
+    int n;
+
+    if (out.format != OUT_FORMAT_TEXT)
+        return;
+
+    va_start(ap, fmt);
+    n = vsnprintf(rec.buf + sizeof(rec.hdr), OUT_STATUS_MAX, fmt, ap);
+    va_end(ap);
+    if (n >= OUT_STATUS_MAX)
+        n = OUT_STATUS_MAX - 1;
+    memset(&rec.hdr, 0, sizeof(rec.hdr));
+    rec.hdr.type = OUT_REC_STATUS;
+    rec.hdr.len = ALIGN8(sizeof(rec.hdr) + n + 1);
+    push(&rec.hdr, 0, out.overflow);
+}
+
+static void push_marker(uint8_t type, uint64_t seq)
+{
+    struct rmon_rec_hdr hdr = {
+        .len = sizeof(hdr),
+        .type = type,
+        .seq = seq,
+    };
+
+    push(&hdr, 0, type == OUT_REC_FLUSH ? OUT_OVERFLOW_BLOCK : out.overflow);
+}
+
+void out_batch_end(void)
+{
+    uint64_t head = atomic_load_explicit(&out.head, memory_order_relaxed);
+
+    if (out.pending_drops) {
+        push_drops(0);
+        head = atomic_load_explicit(&out.head, memory_order_relaxed);
+    }
+    if (!out.running || head == out.marked)
+        return;
+    if (out.policy == OUT_FLUSH_BATCH)
+        push_marker(OUT_REC_BATCH, 0);
+    out.marked = atomic_load_explicit(&out.head, memory_order_relaxed);
+    wake_emitter();
+}
+
+/* Milliseconds until a pending drop notice is retried, -1 if there is none */
+int out_timeout(void)
+{
+    return out.pending_drops ? OUT_RETRY_MSEC : -1;
+}
+
+/* Waits until everything queued so far is written out */
+void out_flush(void)
+{
+    uint64_t done;
+
+    if (!out.running)
+        return;
+    push_marker(OUT_REC_FLUSH, ++out.flushes);
+    wake_emitter();
+    while ((done = atomic_load(&out.done)) != out.flushes)
+        wait_for(&out.done, done);
+}
+
+void out_close(void)
+{
+    uint64_t one = 1;
+
+    if (out.running) {
+        out_flush();
+        atomic_store(&out.stop, 1);
+        (void)!write(out.data_fd, &one, sizeof(one));
+        pthread_join(out.thread, NULL);
+        out.running = 0;
+    }
+    if (out.data_fd >= 0)
+        close(out.data_fd);
+    if (out.space_fd >= 0)
+        close(out.space_fd);
+    out.data_fd = out.space_fd = -1;
+    free(out.q);
+    free(out.buf);
+    free(out.stamps);
+    out.q = NULL;
+    out.buf = NULL;
+    out.stamps = NULL;
+}
+
+void out_metrics(struct metrics_writer *w, void *data)
+{
+    uint64_t depth = atomic_load(&out.head) - atomic_load(&out.tail);
+
+    metrics_put(w, "rmon_output_events_total", "counter", "Events written to the output.",
+                NULL, stat_get(&out.events));
+    metrics_put(w, "rmon_output_queue_bytes", "gauge", "Bytes in the output queue.", NULL,
+                depth);
+    metrics_put(w, "rmon_output_queue_capacity_bytes", "gauge", "Output queue size.", NULL,
+                out.queue_size);
+    metrics_put(w, "rmon_output_queue_high_water_bytes", "gauge",
+                "Most bytes the output queue held.", NULL, out.high);
+    metrics_put(w, "rmon_output_dropped_total", "counter",
+                "Events dropped on a full output queue.", NULL, out.dropped);
+    metrics_put(w, "rmon_output_blocked_total", "counter",
+                "Events that waited for room in the output queue.", NULL, out.blocked);
+    metrics_put(w, "rmon_output_errors_total", "counter", "Failed output writes.", NULL,
+                stat_get(&out.errors));
+}
+
+void out_report(FILE *f)
+{
+    uint64_t events = stat_get(&out.events), writes = stat_get(&out.writes);
+
+    fprintf(f, "Output: events: %llu writes: %llu bytes: %llu forced flushes: %llu "
+            "writes/event: %.4f\n",
+            (unsigned long long)events, (unsigned long long)writes,
+            (unsigned long long)stat_get(&out.bytes), (unsigned long long)stat_get(&out.forced),
+            events ? (double)writes / events : 0.0);
+    fprintf(f, "Output queue: queued: %llu dropped: %llu blocked: %llu high water: %llu "
+            "of %zu bytes wakeups: %llu\n",
+            (unsigned long long)out.queued, (unsigned long long)out.dropped,
+            (unsigned long long)out.blocked, (unsigned long long)out.high, out.queue_size,
+            (unsigned long long)out.wakeups);
+}
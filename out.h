@@ -0,0 +1,78 @@
+/*
+ * Route monitor - buffered output
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_OUT_H
+#define RMON_OUT_H
+
+#include <stdio.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Events are queued to an emitter thread, which formats them into a set of
+ * reusable chunks and writes them out with a single writev() according to
+ * the flush policy:
+ *   batch     - once per drained netlink batch (default)
+ *   event     - after every event line
+ *   deadline  - when the oldest buffered line is older than the deadline
+ * A full buffer is always flushed right away.
+ *
+ * A stalled reader only ever stalls the emitter. When the queue fills up,
+ * the overflow policy decides:
+ *   block        - wait for the emitter (default, nothing is lost)
+ *   drop-oldest  - drop queued events to make room
+ *   summarize    - drop new events, then report them in a dropped record
+ */
+enum out_policy {
+    OUT_FLUSH_BATCH,
+    OUT_FLUSH_EVENT,
+    OUT_FLUSH_DEADLINE,
+};
+
+enum out_format {
+    OUT_FORMAT_TEXT,
+    OUT_FORMAT_BINARY,
+    OUT_FORMAT_JSONL,
+};
+
+enum out_overflow {
+    OUT_OVERFLOW_BLOCK,
+    OUT_OVERFLOW_DROP_OLDEST,
+    OUT_OVERFLOW_SUMMARIZE,
+};
+
+#define OUT_DEFAULT_QUEUE   (4 * 1024 * 1024)
+
+struct metrics_writer;
+
+int out_set_policy(const char *policy);
+int out_set_format(const char *format);
+int out_set_overflow(const char *overflow);
+void out_set_queue(size_t size);
+int out_init(int fd);
+void out_start(void);
+
+void out_event(const struct rmon_rec_hdr *rec);
+void out_status(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void out_batch_end(void);
+void out_flush(void);
+int out_timeout(void);
+void out_report(FILE *f);
+void out_metrics(struct metrics_writer *w, void *data);
+void out_close(void);
+
+#endif
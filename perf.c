@@ -0,0 +1,255 @@
+/*
+ * Route monitor - hardware counters per callback
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/errno.h>
+#include <netlink/utils.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+struct perf_stats {
+    uint64_t calls;
+    double sum[PERF_COUNTER_MAX];
+};
+
+static struct {
+    int fd[PERF_COUNTER_MAX];   /* -1 where the counter isn't there */
+    int idx[PERF_COUNTER_MAX];  /* position in a group read */
+    int nr;
+    uint64_t interval_ns;
+    uint64_t next_ns;
+    uint64_t unscheduled;       /* calls the group wasn't counting during */
+    struct perf_stats cur[PERF_HANDLER_MAX];
+    struct perf_stats total[PERF_HANDLER_MAX];
+} perf = {
+    .fd = { -1, -1, -1, -1 },
+};
+
+static const uint64_t configs[PERF_COUNTER_MAX] = {
+    [PERF_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+    [PERF_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+    [PERF_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    [PERF_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static const char *counter_names[PERF_COUNTER_MAX] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_CACHE_MISSES] = "cache_misses",
+    [PERF_BRANCH_MISSES] = "branch_misses",
+};
+
+static const char *handler_names[PERF_HANDLER_MAX] = {
+    [PERF_ROUTE] = "route_change",
+    [PERF_LINK] = "link_change",
+    [PERF_ADDR] = "addr_change",
+    [PERF_INVALIDATE] = "invalidation",
+};
+
+/*
+ * A counter the CPU doesn't have is left out of the group, the first one
+ * that opens leads it. Fails only if none does.
+ */
+int perf_init(unsigned int interval)
+{
+    struct perf_event_attr attr;
+    int leader = -1, err = 0, i;
+
+    for (i = 0; i < PERF_COUNTER_MAX; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = leader < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        perf.fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (perf.fd[i] < 0) {
+            if (!err)
+                err = errno;
+            perf.idx[i] = -1;
+            continue;
+        }
+        if (leader < 0)
+            leader = perf.fd[i];
+        perf.idx[i] = perf.nr++;
+    }
+    if (leader < 0)
+        return err == ENOENT ? -NLE_OPNOTSUPP : -nl_syserr2nlerr(err);
+
+    if (ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) < 0) {
+        err = -nl_syserr2nlerr(errno);
+        perf_close();
+        return err;
+    }
+    perf.interval_ns = (uint64_t)interval * 1000000000ULL;
+    perf.next_ns = metrics_now() + perf.interval_ns;
+    return 0;
+}
+
+static int leader_fd(void)
+{
+    int i;
+
+    for (i = 0; i < PERF_COUNTER_MAX; i++)
+        if (perf.fd[i] >= 0)
+            return perf.fd[i];
+    return -1;
+}
+
+void perf_begin(struct perf_snap *s)
+{
+    uint64_t buf[3 + PERF_COUNTER_MAX];
+    int i;
+
+    if (!perf.nr)
+        return;
+    memset(s, 0, sizeof(*s));
+    s->running = UINT64_MAX;    /* not counted if the read fails */
+    if (read(leader_fd(), buf, sizeof(buf)) < (ssize_t)((3 + perf.nr) * sizeof(buf[0])))
+        return;
+    s->enabled = buf[1];
+    s->running = buf[2];
+    for (i = 0; i < PERF_COUNTER_MAX; i++)
+        if (perf.idx[i] >= 0)
+            s->v[i] = buf[3 + perf.idx[i]];
+}
+
+/* Multiplexed with other users of the PMU the group is scaled up */
+void perf_end(enum perf_handler h, const struct perf_snap *s)
+{
+    struct perf_snap e;
+    double scale;
+    int i;
+
+    if (!perf.nr)
+        return;
+    perf_begin(&e);
+    if (e.running <= s->running) {
+        perf.unscheduled++;
+        return;
+    }
+    scale = (double)(e.enabled - s->enabled) / (e.running - s->running);
+    perf.cur[h].calls++;
+    for (i = 0; i < PERF_COUNTER_MAX; i++)
+        perf.cur[h].sum[i] += (e.v[i] - s->v[i]) * scale;
+}
+
+static void print_stats(FILE *f, const char *what, enum perf_handler h,
+                        const struct perf_stats *st)
+{
+    int i;
+
+    fprintf(f, "%s %s: calls: %llu per call", what, handler_names[h],
+            (unsigned long long)st->calls);
+    for (i = 0; i < PERF_COUNTER_MAX; i++) {
+        if (perf.idx[i] < 0)
+            fprintf(f, " %s: -", counter_names[i]);
+        else
+            fprintf(f, " %s: %.1f", counter_names[i], st->sum[i] / st->calls);
+    }
+    if (perf.idx[PERF_CYCLES] >= 0 && perf.idx[PERF_INSTRUCTIONS] >= 0 &&
+        st->sum[PERF_CYCLES] > 0)
+        fprintf(f, " ipc: %.2f", st->sum[PERF_INSTRUCTIONS] / st->sum[PERF_CYCLES]);
+    fputc('\n', f);
+}
+
+void perf_batch_end(void)
+{
+    uint64_t now;
+    int h, i;
+
+    if (!perf.nr)
+        return;
+    now = metrics_now();
+    if (now < perf.next_ns)
+        return;
+    perf.next_ns = now + perf.interval_ns;
+    for (h = 0; h < PERF_HANDLER_MAX; h++) {
+        struct perf_stats *cur = &perf.cur[h];
+
+        if (!cur->calls)
+            continue;
+        print_stats(stderr, "Perf", h, cur);
+        perf.total[h].calls += cur->calls;
+        for (i = 0; i < PERF_COUNTER_MAX; i++)
+            perf.total[h].sum[i] += cur->sum[i];
+        memset(cur, 0, sizeof(*cur));
+    }
+}
+
+void perf_report(FILE *f)
+{
+    struct perf_stats st;
+    int h, i;
+
+    if (!perf.nr)
+        return;
+    for (h = 0; h < PERF_HANDLER_MAX; h++) {
+        st = perf.total[h];
+        st.calls += perf.cur[h].calls;
+        for (i = 0; i < PERF_COUNTER_MAX; i++)
+            st.sum[i] += perf.cur[h].sum[i];
+        if (st.calls)
+            print_stats(f, "Perf total", h, &st);
+    }
+    if (perf.unscheduled)
+        fprintf(f, "Perf calls not counted: %llu\n", (unsigned long long)perf.unscheduled);
+}
+
+void perf_metrics(struct metrics_writer *w, void *data)
+{
+    char labels[64];
+    int h, i;
+
+    for (h = 0; h < PERF_HANDLER_MAX; h++) {
+        snprintf(labels, sizeof(labels), "handler=\"%s\"", handler_names[h]);
+        metrics_put(w, "rmon_perf_calls_total", "counter",
+                    "Callbacks and scans counted with hardware counters.", labels,
+                    perf.total[h].calls + perf.cur[h].calls);
+    }
+    for (h = 0; h < PERF_HANDLER_MAX; h++) {
+        for (i = 0; i < PERF_COUNTER_MAX; i++) {
+            if (perf.idx[i] < 0)
+                continue;
+            snprintf(labels, sizeof(labels), "handler=\"%s\",counter=\"%s\"",
+                     handler_names[h], counter_names[i]);
+            metrics_put(w, "rmon_perf_events_total", "counter",
+                        "Hardware events in callbacks and scans, user space only.", labels,
+                        perf.total[h].sum[i] + perf.cur[h].sum[i]);
+        }
+    }
+}
+
+void perf_close(void)
+{
+    int i;
+
+    for (i = 0; i < PERF_COUNTER_MAX; i++) {
+        if (perf.fd[i] >= 0)
+            close(perf.fd[i]);
+        perf.fd[i] = -1;
+    }
+    perf.nr = 0;
+}
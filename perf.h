@@ -0,0 +1,68 @@
+/*
+ * Route monitor - hardware counters per callback
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_PERF_H
+#define RMON_PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "metrics.h"
+
+/*
+ * With --perf the main thread, which runs every callback, opens one
+ * perf_event_open() group of user space cycles, instructions, cache
+ * misses and branch misses. The group is read before and after each
+ * callback and each flush scan, which costs two system calls per call.
+ * Scans run inside the link and address callbacks and count there too.
+ *
+ * Per call averages of each interval go to stderr at the end of the
+ * first batch after it, totals to the statistics report and metrics.
+ */
+enum perf_handler {
+    PERF_ROUTE,
+    PERF_LINK,
+    PERF_ADDR,
+    PERF_INVALIDATE,
+    PERF_HANDLER_MAX
+};
+
+enum perf_counter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_MAX
+};
+
+#define PERF_DEFAULT_INTERVAL   10      /* seconds */
+
+struct perf_snap {
+    uint64_t v[PERF_COUNTER_MAX];
+    uint64_t enabled;
+    uint64_t running;
+};
+
+int perf_init(unsigned int interval);
+void perf_begin(struct perf_snap *s);
+void perf_end(enum perf_handler h, const struct perf_snap *s);
+void perf_batch_end(void);
+void perf_report(FILE *f);
+void perf_metrics(struct metrics_writer *w, void *data);
+void perf_close(void);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Route monitor - event stream reader
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rmon_reader.h"
+
+#define READER_BUF_SIZE     (256 * 1024)
+
+/*
+ * Returns 0 if a complete, well-formed record of a known version starts at
+ * rec, -EAGAIN if more bytes are needed and -EPROTO if the data is corrupt.
+ */
+int rmon_rec_check(const struct rmon_rec_hdr *rec, size_t avail)
+{
+    const struct rmon_rec_route *r;
+    size_t min;
+
+    if (avail < sizeof(*rec))
+        return -EAGAIN;
+    if (rec->len < sizeof(*rec) || rec->len % 8)
+        return -EPROTO;
+    if (rec->version != RMON_PROTO_VERSION)
+        return -EPROTO;
+    if (avail < rec->len)
+        return -EAGAIN;
+
+    if (rmon_rec_is_route(rec)) {
+        if (rec->len < RMON_REC_ROUTE_LEN(0))
+            return -EPROTO;
+        r = rmon_rec_body(rec);
+        min = RMON_REC_ROUTE_LEN(r->nnh + r->old_nnh);
+    } else if (rmon_rec_is_link(rec)) {
+        min = RMON_REC_LINK_LEN;
+    } else if (rmon_rec_is_addr(rec)) {
+        min = RMON_REC_ADDR_LEN;
+    } else if (rec->type == RMON_REC_STREAM) {
+        min = RMON_REC_STREAM_LEN;
+    } else if (rec->type == RMON_REC_DROPPED) {
+        min = RMON_REC_DROPPED_LEN;
+    } else if (rec->type == RMON_REC_SNAPSHOT_BEGIN || rec->type == RMON_REC_SNAPSHOT_END) {
+        min = RMON_REC_SNAPSHOT_LEN;
+    } else if (rec->type == RMON_REC_STARTUP) {
+        min = RMON_REC_STARTUP_LEN;
+    } else {
+        min = sizeof(*rec);
+    }
+    return rec->len < min ? -EPROTO : 0;
+}
+
+int rmon_reader_init(struct rmon_reader *r, int fd)
+{
+    memset(r, 0, sizeof(*r));
+    r->buf = malloc(READER_BUF_SIZE);
+    if (!r->buf)
+        return -ENOMEM;
+    r->cap = READER_BUF_SIZE;
+    r->fd = fd;
+    return 0;
+}
+
+/* Returns 1 with a record, 0 at end of stream, or a negative errno */
+int rmon_reader_next(struct rmon_reader *r, const struct rmon_rec_hdr **rec)
+{
+    const struct rmon_rec_hdr *hdr;
+    ssize_t n;
+    int err;
+
+    for (;;) {
+        hdr = (const struct rmon_rec_hdr *)(r->buf + r->start);
+        err = rmon_rec_check(hdr, r->end - r->start);
+        if (!err) {
+            r->start += hdr->len;
+            *rec = hdr;
+            return 1;
+        }
+        if (err != -EAGAIN)
+            return err;
+        if (r->eof)
+            return r->end == r->start ? 0 : -EPROTO;
+
+        /* Keep the partial record at the start of the buffer and refill */
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+
+        n = read(r->fd, r->buf + r->end, r->cap - r->end);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if (n == 0)
+            r->eof = 1;
+        r->end += n;
+    }
+}
+
+void rmon_reader_free(struct rmon_reader *r)
+{
+    free(r->buf);
+    r->buf = NULL;
+}
@@ -0,0 +1,149 @@
+/*
+ * Route monitor - journal replay
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "replay.h"
+#include "rmon_journal.h"
+
+/* Events emitted per call, so sockets are still served at full speed */
+#define REPLAY_BATCH    4096
+
+static struct {
+    struct rmon_journal j;
+    int open;
+    double speed;
+    const struct rmon_rec_hdr *next;
+    uint64_t first_ts;          /* recorded time of the first event */
+    uint64_t last_ts;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int done;
+    uint64_t events;
+    uint64_t skipped;
+} replay;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* The next event to replay; records the monitor doesn't emit itself are skipped */
+static const struct rmon_rec_hdr *peek(void)
+{
+    const struct rmon_rec_hdr *rec;
+
+    while (!replay.next && rmon_journal_next(&replay.j, &rec)) {
+        if ((rmon_rec_is_route(rec) || rmon_rec_is_link(rec) || rmon_rec_is_addr(rec)) &&
+            rec->len <= sizeof(struct rmon_event) && !(rec->flags & RMON_REC_F_SNAPSHOT))
+            replay.next = rec;
+        else
+            replay.skipped++;
+    }
+    return replay.next;
+}
+
+int replay_init(const char *dir, double speed)
+{
+    int err;
+
+    err = rmon_journal_open(&replay.j, dir);
+    if (err < 0)
+        return -nl_syserr2nlerr(-err);
+    replay.open = 1;
+    replay.speed = speed;
+    if (peek())
+        replay.first_ts = replay.last_ts = replay.next->ts;
+    replay.start_ns = now_ns();
+    return 0;
+}
+
+/* Recorded time never goes backwards, journals may hold several runs */
+static uint64_t due_ns(const struct rmon_rec_hdr *rec)
+{
+    if (rec->ts > replay.last_ts)
+        replay.last_ts = rec->ts;
+    if (!replay.speed)
+        return 0;
+    return replay.start_ns + (uint64_t)((replay.last_ts - replay.first_ts) / replay.speed);
+}
+
+/* Milliseconds until the next event is due, -1 once the journal is done */
+int replay_timeout(void)
+{
+    uint64_t now, due;
+
+    if (!replay.open || !peek())
+        return -1;
+    due = due_ns(replay.next);
+    now = now_ns();
+    if (now >= due)
+        return 0;
+    return (due - now + 999999) / 1000000;
+}
+
+/* Emits the events that are due, returns 1 once all have been replayed */
+int replay_run(void (*emit)(struct rmon_event *ev))
+{
+    struct rmon_event ev;
+    uint64_t now = now_ns();
+    int n;
+
+    if (!replay.open)
+        return 1;
+    for (n = 0; n < REPLAY_BATCH && peek(); n++) {
+        if (due_ns(replay.next) > now)
+            return 0;
+        memcpy(&ev, replay.next, replay.next->len);
+        replay.next = NULL;
+        emit(&ev);
+        replay.events++;
+    }
+    if (peek())
+        return 0;
+    replay.done = 1;
+    return 1;
+}
+
+/* Once done, the first report fixes the end time: call it after flushing output */
+void replay_report(FILE *f)
+{
+    double elapsed, span = (replay.last_ts - replay.first_ts) / 1e9;
+
+    if (!replay.open)
+        return;
+    if (replay.done && !replay.end_ns)
+        replay.end_ns = now_ns();
+    elapsed = ((replay.end_ns ? replay.end_ns : now_ns()) - replay.start_ns) / 1e9;
+    fprintf(f, "Replay: events: %llu skipped: %llu elapsed: %.3f s rate: %.0f events/s "
+            "recorded span: %.3f s speed: %.2fx\n",
+            (unsigned long long)replay.events, (unsigned long long)replay.skipped, elapsed,
+            elapsed > 0 ? replay.events / elapsed : 0.0, span,
+            elapsed > 0 ? span / elapsed : 0.0);
+}
+
+void replay_close(void)
+{
+    if (replay.open)
+        rmon_journal_close(&replay.j);
+    replay.open = 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * Route monitor - journal replay
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_REPLAY_H
+#define RMON_REPLAY_H
+
+#include <stdio.h>
+
+#include "event.h"
+
+/*
+ * Replays the events of a journal (--replay=DIR) through the output
+ * backends in place of the kernel. Events are spaced like they were
+ * recorded, divided by the speed; speed 0 replays as fast as possible.
+ * They get fresh sequence numbers and timestamps, so every backend sees
+ * a regular live stream.
+ */
+int replay_init(const char *dir, double speed);
+int replay_timeout(void);
+int replay_run(void (*emit)(struct rmon_event *ev));
+void replay_report(FILE *f);
+void replay_close(void);
+
+#endif
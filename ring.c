@@ -0,0 +1,426 @@
+/*
+ * Route monitor - shared memory ring
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/errno.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "metrics.h"
+#include "ring.h"
+#include "rmon_ring.h"
+
+_Static_assert(sizeof(struct rmon_ring_hdr) <= RMON_RING_DATA_OFFSET, "ring header too large");
+_Static_assert(RING_POLLFDS == 1 + RMON_RING_SLOTS, "poll set does not match the slots");
+
+struct ring_client {
+    int sock;
+    int efd;
+    int slot_fd;
+    struct rmon_ring_slot *slot;
+};
+
+static struct {
+    struct rmon_ring_hdr *hdr;
+    unsigned char *data;
+    size_t map_size;
+    uint64_t size;
+    uint64_t head;              /* what the header shows, never read back */
+    uint64_t tail;
+    int memfd;
+    int listen_fd;
+    const char *path;
+    struct ring_client clients[RMON_RING_SLOTS];
+    uint64_t notified;
+    uint64_t records;
+    uint64_t wakeups;
+    uint64_t connects;
+    uint64_t rejected;
+} ring = {
+    .memfd = -1,
+    .listen_fd = -1,
+};
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -NLE_INVAL;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -nl_syserr2nlerr(errno);
+
+    /* A stale socket from an earlier run would make bind() fail */
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return -nl_syserr2nlerr(errno);
+    }
+    return fd;
+}
+
+/* size is rounded up to a power of two */
+int ring_init(const char *path, size_t size)
+{
+    uint64_t data_size = 4096;
+    void *map;
+    int i;
+
+    while (data_size < size)
+        data_size <<= 1;
+
+    ring.memfd = memfd_create("rmon-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (ring.memfd < 0)
+        return -nl_syserr2nlerr(errno);
+
+    ring.map_size = RMON_RING_DATA_OFFSET + data_size;
+    if (ftruncate(ring.memfd, ring.map_size) < 0)
+        goto err;
+
+    map = mmap(NULL, ring.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring.memfd, 0);
+    if (map == MAP_FAILED)
+        goto err;
+    /* Only this mapping may write, readers get a memfd they can't resize or write */
+    if (fcntl(ring.memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE |
+                                        F_SEAL_SEAL) < 0) {
+        i = errno;
+        munmap(map, ring.map_size);
+        errno = i;
+        goto err;
+    }
+
+    ring.hdr = map;
+    mem_mapped(MEM_RING, ring.map_size);
+    ring.data = (unsigned char *)map + RMON_RING_DATA_OFFSET;
+    ring.size = data_size;
+    ring.hdr->magic = RMON_RING_MAGIC;
+    ring.hdr->version = RMON_RING_VERSION;
+    ring.hdr->nslots = RMON_RING_SLOTS;
+    ring.hdr->size = data_size;
+    for (i = 0; i < RMON_RING_SLOTS; i++)
+        ring.clients[i].sock = ring.clients[i].efd = ring.clients[i].slot_fd = -1;
+
+    ring.listen_fd = listen_on(path);
+    if (ring.listen_fd < 0) {
+        munmap(map, ring.map_size);
+        mem_mapped(MEM_RING, -(long)ring.map_size);
+        close(ring.memfd);
+        ring.hdr = NULL;
+        return ring.listen_fd;
+    }
+    ring.path = path;
+    return 0;
+
+err:
+    i = errno;
+    close(ring.memfd);
+    return -nl_syserr2nlerr(i);
+}
+
+/*
+ * Copies one record in. tail moves past whatever gets overwritten before
+ * the copy, head moves past the record after it, so readers can tell a
+ * torn record from an intact one.
+ */
+void ring_publish(const struct rmon_rec_hdr *rec)
+{
+    struct rmon_rec_hdr *pad = NULL;
+    uint64_t head, off, left;
+
+    if (!ring.hdr)
+        return;
+
+    head = ring.head;
+    off = head & (ring.size - 1);
+    left = ring.size - off;
+    if (left < rec->len) {
+        if (left >= sizeof(*pad))
+            pad = (struct rmon_rec_hdr *)(ring.data + off);
+        head += left;
+        off = 0;
+    }
+
+    if (head + rec->len > ring.size) {
+        ring.tail = head + rec->len - ring.size;
+        atomic_store_explicit(&ring.hdr->tail, ring.tail, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (pad) {
+        memset(pad, 0, sizeof(*pad));
+        pad->len = left;
+        pad->version = RMON_PROTO_VERSION;
+        pad->type = RMON_RING_PAD;
+    }
+    memcpy(ring.data + off, rec, rec->len);
+    atomic_store_explicit(&ring.hdr->seq, rec->seq, memory_order_relaxed);
+    ring.head = head + rec->len;
+    atomic_store_explicit(&ring.hdr->head, ring.head, memory_order_release);
+    ring.records++;
+}
+
+/* Wakes up the readers that went to sleep, once per batch of events */
+void ring_notify(void)
+{
+    uint64_t one = 1;
+    int i;
+
+    if (!ring.hdr || ring.head == ring.notified)
+        return;
+    ring.notified = ring.head;
+
+    for (i = 0; i < RMON_RING_SLOTS; i++) {
+        if (ring.clients[i].sock < 0 || !atomic_exchange(&ring.clients[i].slot->waiting, 0))
+            continue;
+        (void)!write(ring.clients[i].efd, &one, sizeof(one));
+        ring.wakeups++;
+    }
+}
+
+static int send_hello(int sock, uint16_t slot, int slot_fd, int efd)
+{
+    union {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } u;
+    struct rmon_ring_hello hello = {
+        .magic = RMON_RING_MAGIC,
+        .version = RMON_RING_VERSION,
+        .slot = slot,
+        .map_size = ring.map_size,
+    };
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    struct cmsghdr *cmsg;
+    int fds[3] = { ring.memfd, slot_fd, efd };
+
+    if (slot != RMON_RING_NO_SLOT) {
+        msg.msg_control = u.buf;
+        msg.msg_controllen = sizeof(u.buf);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    }
+    return sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 ? -1 : 0;
+}
+
+static void release_client(int i)
+{
+    struct ring_client *c = &ring.clients[i];
+
+    munmap(c->slot, sizeof(*c->slot));
+    mem_mapped(MEM_RING, -(long)sizeof(*c->slot));
+    close(c->slot_fd);
+    close(c->sock);
+    close(c->efd);
+    c->sock = c->efd = c->slot_fd = -1;
+    c->slot = NULL;
+}
+
+/* A slot of its own keeps a reader from writing to anything another one reads */
+static int slot_alloc(struct ring_client *c)
+{
+    void *map;
+
+    c->slot_fd = memfd_create("rmon-ring-slot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (c->slot_fd < 0)
+        return -1;
+    if (ftruncate(c->slot_fd, sizeof(*c->slot)) < 0 ||
+        fcntl(c->slot_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+        goto err;
+    map = mmap(NULL, sizeof(*c->slot), PROT_READ | PROT_WRITE, MAP_SHARED, c->slot_fd, 0);
+    if (map == MAP_FAILED)
+        goto err;
+    c->slot = map;
+    mem_mapped(MEM_RING, sizeof(*c->slot));
+    return 0;
+
+err:
+    close(c->slot_fd);
+    c->slot_fd = -1;
+    return -1;
+}
+
+static void accept_client(void)
+{
+    struct ring_client *c = NULL;
+    int sock;
+    int i;
+
+    sock = accept4(ring.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (sock < 0)
+        return;
+
+    for (i = 0; i < RMON_RING_SLOTS; i++) {
+        if (ring.clients[i].sock < 0) {
+            c = &ring.clients[i];
+            break;
+        }
+    }
+    if (!c) {
+        ring.rejected++;
+        send_hello(sock, RMON_RING_NO_SLOT, -1, -1);
+        close(sock);
+        return;
+    }
+
+    if (slot_alloc(c) < 0) {
+        close(sock);
+        return;
+    }
+    c->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (c->efd < 0) {
+        c->sock = sock;
+        release_client(i);
+        return;
+    }
+
+    /* The slot must be ready before the reader can touch it */
+    atomic_store(&c->slot->cursor, ring.head);
+    atomic_store(&c->slot->waiting, 0);
+    c->sock = sock;
+    if (send_hello(sock, i, c->slot_fd, c->efd) < 0) {
+        release_client(i);
+        return;
+    }
+    ring.connects++;
+}
+
+/* Fills in the listening socket and the connection of every reader */
+int ring_pollfds(struct pollfd *pfd)
+{
+    int i, n = 0;
+
+    if (!ring.hdr)
+        return 0;
+
+    pfd[n].fd = ring.listen_fd;
+    pfd[n].events = POLLIN;
+    pfd[n++].revents = 0;
+    for (i = 0; i < RMON_RING_SLOTS; i++) {
+        pfd[n].fd = ring.clients[i].sock;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+    }
+    return n;
+}
+
+/* Readers never send anything, so any activity on a connection is a hangup */
+void ring_handle(const struct pollfd *pfd, int n)
+{
+    int i;
+
+    if (!n)
+        return;
+    for (i = 1; i < n; i++) {
+        if (pfd[i].fd >= 0 && pfd[i].revents)
+            release_client(i - 1);
+    }
+    if (pfd[0].revents & POLLIN)
+        accept_client();
+}
+
+void ring_report(FILE *f)
+{
+    uint64_t head, lag, max_lag = 0;
+    int i, readers = 0, lapped = 0;
+
+    if (!ring.hdr)
+        return;
+
+    head = ring.head;
+    for (i = 0; i < RMON_RING_SLOTS; i++) {
+        if (ring.clients[i].sock < 0)
+            continue;
+        readers++;
+        lag = head - atomic_load(&ring.clients[i].slot->cursor);
+        if (lag > ring.size)
+            lapped++;
+        if (lag > max_lag)
+            max_lag = lag;
+    }
+
+    fprintf(f, "Ring: records: %llu bytes: %llu size: %llu readers: %d lapped: %d "
+            "max lag: %llu bytes wakeups: %llu connects: %llu rejected: %llu\n",
+            (unsigned long long)ring.records, (unsigned long long)head,
+            (unsigned long long)ring.size, readers, lapped, (unsigned long long)max_lag,
+            (unsigned long long)ring.wakeups, (unsigned long long)ring.connects,
+            (unsigned long long)ring.rejected);
+}
+
+void ring_metrics(struct metrics_writer *w, void *data)
+{
+    uint64_t head, lag, max_lag = 0;
+    int i, readers = 0, lapped = 0;
+
+    if (!ring.hdr)
+        return;
+
+    head = ring.head;
+    for (i = 0; i < RMON_RING_SLOTS; i++) {
+        if (ring.clients[i].sock < 0)
+            continue;
+        readers++;
+        lag = head - atomic_load(&ring.clients[i].slot->cursor);
+        if (lag > ring.size)
+            lapped++;
+        if (lag > max_lag)
+            max_lag = lag;
+    }
+
+    metrics_put(w, "rmon_ring_records_total", "counter", "Records published to the ring.",
+                NULL, ring.records);
+    metrics_put(w, "rmon_ring_readers", "gauge", "Connected ring readers.", NULL, readers);
+    metrics_put(w, "rmon_ring_lapped_readers", "gauge",
+                "Ring readers the producer has overrun.", NULL, lapped);
+    metrics_put(w, "rmon_ring_max_lag_bytes", "gauge", "Largest ring reader lag.", NULL,
+                max_lag);
+    metrics_put(w, "rmon_ring_wakeups_total", "counter", "Ring reader wakeups.", NULL,
+                ring.wakeups);
+}
+
+void ring_close(void)
+{
+    int i;
+
+    if (!ring.hdr)
+        return;
+    for (i = 0; i < RMON_RING_SLOTS; i++) {
+        if (ring.clients[i].sock >= 0)
+            release_client(i);
+    }
+    close(ring.listen_fd);
+    unlink(ring.path);
+    munmap(ring.hdr, ring.map_size);
+    mem_mapped(MEM_RING, -(long)ring.map_size);
+    close(ring.memfd);
+    ring.hdr = NULL;
+}
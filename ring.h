@@ -0,0 +1,41 @@
+/*
+ * Route monitor - shared memory ring
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_RING_PRODUCER_H
+#define RMON_RING_PRODUCER_H
+
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "rmon_proto.h"
+
+#define RING_DEFAULT_SIZE   (4 * 1024 * 1024)
+#define RING_POLLFDS        33      /* listening socket + one per reader slot */
+
+struct metrics_writer;
+
+int ring_init(const char *path, size_t size);
+void ring_publish(const struct rmon_rec_hdr *rec);
+void ring_notify(void);
+int ring_pollfds(struct pollfd *pfd);
+void ring_handle(const struct pollfd *pfd, int n);
+void ring_report(FILE *f);
+void ring_metrics(struct metrics_writer *w, void *data);
+void ring_close(void);
+
+#endif
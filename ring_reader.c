@@ -0,0 +1,239 @@
+/*
+ * Route monitor - shared memory ring reader
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rmon_ring.h"
+
+static int recv_hello(int sock, struct rmon_ring_hello *hello, int fds[3])
+{
+    union {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } u;
+    struct iovec iov = { .iov_base = hello, .iov_len = sizeof(*hello) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = u.buf,
+        .msg_controllen = sizeof(u.buf),
+    };
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return -errno;
+    if (n != sizeof(*hello) || hello->magic != RMON_RING_MAGIC)
+        return -EPROTO;
+    if (hello->version != RMON_RING_VERSION)
+        return -EPROTONOSUPPORT;
+    if (hello->slot == RMON_RING_NO_SLOT)
+        return -EBUSY;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return -EPROTO;
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    return 0;
+}
+
+/*
+ * Connects to rmon and maps the ring read-only and the slot of the reader
+ * writable. The connection is kept open for as long as the reader exists,
+ * closing it gives the slot back.
+ */
+int rmon_ring_connect(struct rmon_ring_reader *r, const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct rmon_ring_hello hello;
+    int fds[3] = { -1, -1, -1 };
+    void *map, *slot;
+    int sock;
+    int err;
+
+    memset(r, 0, sizeof(*r));
+    r->efd = -1;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -ENAMETOOLONG;
+    strcpy(addr.sun_path, path);
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return -errno;
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        err = -errno;
+        goto err_sock;
+    }
+
+    err = recv_hello(sock, &hello, fds);
+    if (err < 0)
+        goto err_sock;
+
+    map = mmap(NULL, hello.map_size, PROT_READ, MAP_SHARED, fds[0], 0);
+    if (map == MAP_FAILED)
+        err = -errno;
+    slot = mmap(NULL, sizeof(*r->slot), PROT_READ | PROT_WRITE, MAP_SHARED, fds[1], 0);
+    if (slot == MAP_FAILED && !err)
+        err = -errno;
+    close(fds[0]);
+    close(fds[1]);
+    if (err < 0) {
+        if (map != MAP_FAILED)
+            munmap(map, hello.map_size);
+        if (slot != MAP_FAILED)
+            munmap(slot, sizeof(*r->slot));
+        close(fds[2]);
+        goto err_sock;
+    }
+
+    r->hdr = map;
+    r->data = (const unsigned char *)map + RMON_RING_DATA_OFFSET;
+    r->map_size = hello.map_size;
+    r->slot = slot;
+    r->efd = fds[2];
+    r->sock = sock;
+    r->cursor = atomic_load_explicit(&r->hdr->head, memory_order_acquire);
+    r->last = r->cursor;
+    r->last_seq = atomic_load_explicit(&r->hdr->seq, memory_order_relaxed);
+    atomic_store_explicit(&r->slot->cursor, r->cursor, memory_order_relaxed);
+    return 0;
+
+err_sock:
+    close(sock);
+    return err;
+}
+
+/*
+ * Returns 1 with the next record, 0 if the reader has caught up, or
+ * -EOVERFLOW once after the writer lapped the reader; reading then resumes
+ * at the newest record and the skipped events are counted in lost once
+ * the next one arrives.
+ */
+int rmon_ring_next(struct rmon_ring_reader *r, const struct rmon_rec_hdr **rec)
+{
+    uint64_t size = r->hdr->size;
+    const struct rmon_rec_hdr *h;
+    uint64_t head, off, left;
+    uint16_t len;
+
+    for (;;) {
+        head = atomic_load_explicit(&r->hdr->head, memory_order_acquire);
+        if (r->cursor == head) {
+            atomic_store_explicit(&r->slot->cursor, r->cursor, memory_order_relaxed);
+            return 0;
+        }
+        if (head - r->cursor > size)
+            goto overrun;
+
+        off = r->cursor & (size - 1);
+        left = size - off;
+        if (left < sizeof(*h)) {
+            r->cursor += left;
+            continue;
+        }
+
+        h = (const struct rmon_rec_hdr *)(r->data + off);
+        len = h->len;
+        atomic_thread_fence(memory_order_acquire);
+        if (r->cursor < atomic_load_explicit(&r->hdr->tail, memory_order_relaxed))
+            goto overrun;
+        if (len < sizeof(*h) || len % 8 || len > left)
+            goto overrun;
+
+        r->last = r->cursor;
+        r->cursor += len;
+        if (h->type == RMON_RING_PAD)
+            continue;
+
+        if (h->seq > r->last_seq + 1)
+            r->lost += h->seq - r->last_seq - 1;
+        r->last_seq = h->seq;
+        atomic_store_explicit(&r->slot->cursor, r->cursor, memory_order_relaxed);
+        *rec = h;
+        return 1;
+    }
+
+overrun:
+    r->overruns++;
+    r->cursor = atomic_load_explicit(&r->hdr->head, memory_order_acquire);
+    r->last = r->cursor;
+    atomic_store_explicit(&r->slot->cursor, r->cursor, memory_order_relaxed);
+    return -EOVERFLOW;
+}
+
+/* Whether the record last returned by rmon_ring_next() is still unmodified */
+int rmon_ring_intact(const struct rmon_ring_reader *r)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return r->last >= atomic_load_explicit(&r->hdr->tail, memory_order_relaxed);
+}
+
+/*
+ * Sleeps until rmon publishes more events or the timeout (in milliseconds,
+ * -1 for none) expires. Returns 1 if there is something to read, 0 on
+ * timeout, -EPIPE when rmon went away.
+ */
+int rmon_ring_wait(struct rmon_ring_reader *r, int timeout)
+{
+    struct pollfd pfd[2] = {
+        { .fd = r->efd, .events = POLLIN },
+        { .fd = r->sock, .events = POLLIN },
+    };
+    uint64_t val;
+    int n;
+
+    atomic_store(&r->slot->waiting, 1);
+    if (atomic_load(&r->hdr->head) != r->cursor) {
+        atomic_store(&r->slot->waiting, 0);
+        return 1;
+    }
+
+    n = poll(pfd, 2, timeout);
+    atomic_store(&r->slot->waiting, 0);
+    if (n < 0)
+        return errno == EINTR ? 0 : -errno;
+    if (pfd[0].revents & POLLIN)
+        (void)!read(r->efd, &val, sizeof(val));
+    if (pfd[1].revents & (POLLIN | POLLHUP))
+        return -EPIPE;
+    return atomic_load(&r->hdr->head) != r->cursor;
+}
+
+void rmon_ring_close(struct rmon_ring_reader *r)
+{
+    if (r->hdr)
+        munmap((void *)r->hdr, r->map_size);
+    if (r->slot)
+        munmap(r->slot, sizeof(*r->slot));
+    if (r->efd >= 0)
+        close(r->efd);
+    if (r->sock >= 0)
+        close(r->sock);
+    memset(r, 0, sizeof(*r));
+    r->efd = r->sock = -1;
+}
@@ -20,175 +20,1358 @@
 #include <netlink/route/route.h>
 #include <netlink/route/link.h>
 #include <netlink/route/addr.h>
+#include <netlink/route/nexthop.h>
+#include <linux/sock_diag.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-static void check_routes_for_ifindex(struct nl_cache *route_cache, int ifindex)
+#include "capture.h"
+#include "damp.h"
+#include "event.h"
+#include "flush.h"
+#include "fp.h"
+#include "journal.h"
+#include "latency.h"
+#include "mem.h"
+#include "metrics.h"
+#include "moves.h"
+#include "out.h"
+#include "perf.h"
+#include "replay.h"
+#include "ring.h"
+#include "rx.h"
+#include "startup.h"
+#include "sub.h"
+
+#define NL_RCVBUF   (8 << 20)   /* capped at net.core.rmem_max */
+
+static volatile sig_atomic_t report_requested;
+static volatile sig_atomic_t stop_requested;
+static uint64_t callback_ns;        /* start of the running change callback */
+static struct perf_snap callback_perf;
+static int embed_latency;
+static uint64_t resyncs;            /* cache dumps after socket overruns */
+
+static void request_report(int sig)
+{
+    report_requested = 1;
+}
+
+static void request_stop(int sig)
+{
+    stop_requested = 1;
+}
+
+static uint32_t saturate(uint64_t ns)
+{
+    return ns > UINT32_MAX ? UINT32_MAX : ns;
+}
+
+/* Records how long the netlink message behind a callback took to become ev */
+static void note_latency(struct rmon_event *ev)
+{
+    const struct rx_stamp *st = rx_stamp();
+    struct rmon_rec_latency *lat;
+    uint64_t now;
+
+    if (!st)
+        return;
+    now = metrics_now();
+    lat_record(LAT_HANDLE, now - callback_ns);
+    lat_record(LAT_TOTAL, now - st->read_ns);
+    if (!embed_latency || (ev->hdr.flags & RMON_REC_F_LATENCY))
+        return;
+
+    lat = (struct rmon_rec_latency *)((char *)ev + ev->hdr.len);
+    lat->total_ns = saturate(now - st->read_ns);
+    lat->lane_ns = saturate(st->in_ns - st->read_ns);
+    lat->parse_ns = saturate(callback_ns - st->in_ns);
+    lat->handle_ns = saturate(now - callback_ns);
+    ev->hdr.len += sizeof(*lat);
+    ev->hdr.flags |= RMON_REC_F_LATENCY;
+}
+
+static void publish(struct rmon_event *ev)
+{
+    metric_add(METRIC_EVENTS + ev->hdr.type, 1);
+    event_stamp(ev);
+    out_event(&ev->hdr);
+    ring_publish(&ev->hdr);
+    sub_publish(&ev->hdr);
+    journal_append(&ev->hdr);
+}
+
+static void emit(struct rmon_event *ev)
+{
+    struct rmon_event startup;
+
+    if (startup_event(&startup))
+        publish(&startup);
+    if (callback_ns)
+        note_latency(ev);
+    publish(ev);
+}
+
+static void batch_end(void)
+{
+    out_batch_end();
+    ring_notify();
+    sub_flush();
+    journal_batch_end();
+    perf_batch_end();
+}
+
+struct rmon_caches {
+    struct nl_cache *route;
+    struct nl_cache *link;
+    struct nl_cache *addr;
+};
+
+static void invalidate_route(struct rtnl_route *route, void *arg)
+{
+    struct rmon_event ev;
+
+    event_route(&ev, RMON_REC_ROUTE_INVALIDATE, route);
+    emit(&ev);
+
+    fp_forget(fp_route_key(route));
+    nl_cache_remove((struct nl_object *)route);
+}
+
+/*
+ * The kernel flushes IPv4 routes through an interface that goes down or
+ * loses its last address without sending RTM_DELROUTE, so they are reported
+ * and dropped from the route cache here. Routes using a removed address as
+ * preferred source go away as well.
+ */
+static void check_routes_for_ifindex(struct nl_cache *route_cache, int ifindex,
+                                     int flags, struct nl_addr *prefsrc)
+{
+    struct perf_snap ps;
+
+    perf_begin(&ps);
+    flush_scan(route_cache, ifindex, flags, prefsrc, invalidate_route, NULL);
+    perf_end(PERF_INVALIDATE, &ps);
+}
+
+static int has_ipv4_addr(struct nl_cache *addr_cache, int ifindex)
 {
     struct nl_object *obj;
-    char dst_str[INET6_ADDRSTRLEN] = "unknown";
-    char gw_str[INET6_ADDRSTRLEN] = "none";
-    struct rtnl_route *route = NULL;
-    struct nl_addr *gw = NULL;
-    struct rtnl_nexthop *nh = NULL;
-    struct nl_addr *dst = NULL;
-    int route_ifindex = -1;
-    int metric;
-
-    for (obj = nl_cache_get_first(route_cache); obj; obj = nl_cache_get_next(obj)) {
-        route = (struct rtnl_route *)obj;
-
-        if (rtnl_route_get_family(route) != AF_INET)
-            continue;
 
-        dst = rtnl_route_get_dst(route);
-        if (dst)
-            nl_addr2str(dst, dst_str, sizeof(dst_str));
+    for (obj = nl_cache_get_first(addr_cache); obj; obj = nl_cache_get_next(obj)) {
+        struct rtnl_addr *addr = (struct rtnl_addr *)obj;
 
-        nh = rtnl_route_nexthop_n(route, 0);
-        if (nh) {
-            route_ifindex = rtnl_route_nh_get_ifindex(nh);
-            gw = rtnl_route_nh_get_gateway(nh);
-            if (gw)
-                nl_addr2str(gw, gw_str, sizeof(gw_str));
-        }
+        if (rtnl_addr_get_family(addr) == AF_INET && rtnl_addr_get_ifindex(addr) == ifindex)
+            return 1;
+    }
+    return 0;
+}
 
-        metric = rtnl_route_get_priority(route);
+/* Updates the flap penalty and reports a damped route becoming usable again */
+static enum damp_verdict damp_route(uint64_t key, unsigned int penalty,
+                                    const struct rmon_event *route_ev, struct damp_info *info)
+{
+    enum damp_verdict verdict = damp_update(key, penalty, &route_ev->route, info);
+    struct rmon_event ev;
 
-        if (route_ifindex == ifindex)
-            printf("Route invalidated: destination: %s oif: %d gateway: %s metric: %d\n",
-                   dst_str, route_ifindex, gw_str, metric);
+    if (verdict == DAMP_REUSED) {
+        event_route_note(&ev, route_ev, RMON_REC_ROUTE_REUSABLE, info->events);
+        emit(&ev);
     }
+    return verdict;
 }
 
-static void route_change(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
+/* Looks a route up by the identity of its record, returns it with a reference */
+static struct rtnl_route *cached_route(struct nl_cache *route_cache,
+                                       const struct rmon_rec_route *r)
 {
-    struct rtnl_route *route = (struct rtnl_route *)obj;
-    char dst_str[INET6_ADDRSTRLEN] = "unknown";
-    char gw_str[INET6_ADDRSTRLEN] = "none";
-    struct rtnl_nexthop *nh = NULL;
-    struct nl_addr *dst = NULL;
-    struct nl_addr *gw = NULL;
-    int ifindex = -1;
-    int metric;
+    struct rtnl_route *route = rtnl_route_alloc();
+    struct nl_addr *dst = nl_addr_build(r->family, r->dst, r->dst_alen);
+    struct nl_object *obj = NULL;
 
-    if (rtnl_route_get_family(route) != AF_INET)
+    if (route && dst) {
+        nl_addr_set_prefixlen(dst, r->dst_len);
+        rtnl_route_set_family(route, r->family);
+        rtnl_route_set_tos(route, r->tos);
+        rtnl_route_set_table(route, r->table);
+        rtnl_route_set_priority(route, r->priority);
+        rtnl_route_set_dst(route, dst);
+        obj = nl_cache_search(route_cache, (struct nl_object *)route);
+    }
+    nl_addr_put(dst);
+    rtnl_route_put(route);
+    return (struct rtnl_route *)obj;
+}
+
+/*
+ * A damped route that decayed below the reuse limit, or was evicted from
+ * the damping table, without another event. If events were suppressed
+ * meanwhile its state is reported from the route cache, or withdrawn if
+ * the route is gone.
+ */
+static void route_reusable(const struct rmon_rec_route *r, unsigned int events, void *arg)
+{
+    struct rtnl_route *route;
+    struct rmon_event ev, note;
+
+    ev.route = *r;
+    event_route_note(&note, &ev, RMON_REC_ROUTE_REUSABLE, events);
+    emit(&note);
+    if (!events)
         return;
 
-    dst = rtnl_route_get_dst(route);
-    if (dst)
-        nl_addr2str(dst, dst_str, sizeof(dst_str));
+    route = cached_route(arg, r);
+    if (route) {
+        event_route(&ev, RMON_REC_ROUTE_ADD, route);
+        rtnl_route_put(route);
+    } else {
+        event_route_note(&ev, &note, RMON_REC_ROUTE_DEL, 0);
+    }
+    emit(&ev);
+}
 
-    nh = rtnl_route_nexthop_n(route, 0);
-    if (nh) {
-        ifindex = rtnl_route_nh_get_ifindex(nh);
-        gw = rtnl_route_nh_get_gateway(nh);
-        if (gw)
-            nl_addr2str(gw, gw_str, sizeof(gw_str));
+/* Reports a route event, unless its route is suppressed for flapping */
+static void emit_route(uint64_t key, unsigned int penalty, struct rmon_event *ev)
+{
+    enum damp_verdict verdict;
+    struct damp_info info;
+    struct rmon_event note;
+
+    verdict = damp_route(key, penalty, ev, &info);
+    if (verdict == DAMP_SUPPRESS)
+        return;
+
+    emit(ev);
+    if (verdict == DAMP_DAMPED) {
+        event_route_note(&note, ev, RMON_REC_ROUTE_DAMPED, info.penalty);
+        emit(&note);
     }
+}
+
+static void route_change(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
+{
+    static const uint8_t types[] = {
+        [NL_ACT_NEW]    = RMON_REC_ROUTE_ADD,
+        [NL_ACT_DEL]    = RMON_REC_ROUTE_DEL,
+        [NL_ACT_CHANGE] = RMON_REC_ROUTE_CHANGE,
+    };
+    struct rtnl_route *route = (struct rtnl_route *)obj;
+    struct route_move mv;
+    struct rmon_event ev;
+    unsigned int penalty;
+    int moved = 0;
+    uint64_t key;
 
-    metric = rtnl_route_get_priority(route);
+    if (rtnl_route_get_family(route) != AF_INET)
+        return;
+    if (action != NL_ACT_NEW && action != NL_ACT_DEL && action != NL_ACT_CHANGE)
+        return;
 
+    key = fp_route_key(route);
     switch (action) {
     case NL_ACT_NEW:
-        printf("Route added: destination: %s oif: %d gateway: %s metric: %d\n",
-               dst_str, ifindex, gw_str, metric);
+        if (moves_take(key, &mv)) {
+            if (fp_update(key, fp_route_fingerprint(route))) {
+                fp_suppressed();
+                return;
+            }
+            moved = 1;
+            break;
+        }
+        fp_update(key, fp_route_fingerprint(route));
         break;
     case NL_ACT_DEL:
-        printf("Route deleted: destination: %s oif: %d gateway: %s metric: %d\n",
-               dst_str, ifindex, gw_str, metric);
+        if (rx_move_pending(key)) {
+            mv.key = key;
+            event_route(&mv.ev, RMON_REC_ROUTE_DEL, route);
+            if (moves_hold(&mv) == 0)
+                return;
+        }
+        fp_forget(key);
         break;
     case NL_ACT_CHANGE:
-        printf("Route changed: destination: %s oif: %d gateway: %s metric: %d\n",
-               dst_str, ifindex, gw_str, metric);
+        if (fp_update(key, fp_route_fingerprint(route))) {
+            fp_suppressed();
+            return;
+        }
         break;
     }
+
+    if (action == NL_ACT_DEL)
+        penalty = DAMP_PENALTY_WITHDRAW;
+    else if (action == NL_ACT_CHANGE || moved)
+        penalty = DAMP_PENALTY_CHANGE;
+    else
+        penalty = 0;
+
+    event_route(&ev, types[action], route);
+    if (moved)
+        event_move(&ev, &mv.ev);
+    emit_route(key, penalty, &ev);
+}
+
+static void unpaired_delete(struct route_move *mv, void *arg)
+{
+    fp_forget(mv->key);
+    emit_route(mv->key, DAMP_PENALTY_WITHDRAW, &mv->ev);
+}
+
+/* Current state for subscriber snapshots, limited to what events cover */
+static void snapshot(void (*put)(const struct rmon_rec_hdr *, void *), void *arg, void *data)
+{
+    struct rmon_caches *caches = data;
+    struct nl_object *obj;
+    struct rmon_event ev;
+    struct timespec ts;
+    uint64_t now;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    for (obj = nl_cache_get_first(caches->link); obj; obj = nl_cache_get_next(obj)) {
+        event_link(&ev, RMON_REC_LINK_ADD, (struct rtnl_link *)obj);
+        event_snapshot_state(&ev, now);
+        put(&ev.hdr, arg);
+    }
+    for (obj = nl_cache_get_first(caches->addr); obj; obj = nl_cache_get_next(obj)) {
+        event_addr(&ev, RMON_REC_ADDR_ADD, (struct rtnl_addr *)obj);
+        event_snapshot_state(&ev, now);
+        put(&ev.hdr, arg);
+    }
+    for (obj = nl_cache_get_first(caches->route); obj; obj = nl_cache_get_next(obj)) {
+        if (rtnl_route_get_family((struct rtnl_route *)obj) != AF_INET)
+            continue;
+        event_route(&ev, RMON_REC_ROUTE_ADD, (struct rtnl_route *)obj);
+        event_snapshot_state(&ev, now);
+        put(&ev.hdr, arg);
+    }
+}
+
+static void batch_done(void *arg)
+{
+    moves_flush(unpaired_delete, NULL);
+    batch_end();
+}
+
+/* SIGUSR1 dumps statistics to stderr, SIGINT/SIGTERM flush and exit */
+static void install_signals(void)
+{
+    struct sigaction sa = { .sa_handler = request_report };
+
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+static void report(void)
+{
+    rx_report(stderr);
+    lat_report(stderr);
+    out_report(stderr);
+    ring_report(stderr);
+    sub_report(stderr);
+    journal_report(stderr);
+    capture_report(stderr);
+    replay_report(stderr);
+    fp_report(stderr);
+    damp_report(stderr);
+    mem_report(stderr);
+    perf_report(stderr);
+}
+
+static int min_timeout(int a, int b)
+{
+    if (a < 0)
+        return b;
+    if (b < 0)
+        return a;
+    return a < b ? a : b;
+}
+
+/* Serves the journal's events to the backends instead of the kernel's */
+static int replay_loop(void)
+{
+    struct pollfd pfd[RING_POLLFDS + SUB_POLLFDS + METRICS_POLLFDS];
+    int nring, nsub, n, done = 0;
+
+    install_signals();
+    while (!stop_requested && !done) {
+        nring = ring_pollfds(pfd);
+        nsub = sub_pollfds(pfd + nring);
+        n = nring + nsub + metrics_pollfds(pfd + nring + nsub);
+        if (poll(pfd, n, min_timeout(min_timeout(replay_timeout(), out_timeout()),
+                                     min_timeout(journal_timeout(), metrics_timeout()))) < 0 &&
+            errno != EINTR) {
+            fprintf(stderr, "Polling failed: %s\n", strerror(errno));
+            return -1;
+        }
+        ring_handle(pfd, nring);
+        sub_handle(pfd + nring, nsub);
+        metrics_handle(pfd + nring + nsub, n - nring - nsub);
+        done = replay_run(emit);
+        batch_end();
+        if (report_requested) {
+            report_requested = 0;
+            report();
+        }
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -w, --move-window=USEC  hold trailing route deletions up to USEC\n"
+            "                          waiting for a re-addition (default 0)\n"
+            "  -d, --damp=SEC          damp flapping routes, penalty half life SEC\n"
+            "  -F, --format=FORMAT     write events as 'text' (default), 'binary'\n"
+            "                          or 'jsonl' (one JSON object per line)\n"
+            "  -f, --flush=POLICY      flush output per 'batch' (default), per 'event'\n"
+            "                          or after 'deadline[:USEC]' (default 1000)\n"
+            "      --overflow=POLICY   when the output queue is full 'block' (default),\n"
+            "                          'drop-oldest' or 'summarize' new events\n"
+            "      --out-queue=BYTES   output queue size (default 4 MiB)\n"
+            "  -r, --ring=PATH         publish events in a shared memory ring, handed\n"
+            "                          out to readers over the Unix socket PATH\n"
+            "      --ring-size=BYTES   ring data size (default 4 MiB)\n"
+            "  -s, --subscribe=PATH    serve filtered event streams on the Unix socket PATH\n"
+            "      --sub-queue=BYTES   per subscriber queue and snapshot limit\n"
+            "                          (default 256 KiB)\n"
+            "  -j, --journal=DIR       append events to a journal of segment files in DIR\n"
+            "      --journal-size=N    journal segment size in bytes (default 64 MiB)\n"
+            "      --journal-keep=N    keep only the newest N segments (default all)\n"
+            "      --replay=DIR        replay the events of the journal in DIR instead\n"
+            "                          of monitoring the kernel\n"
+            "      --speed=SPEED       replay at SPEED times the recorded pace\n"
+            "                          (default 1) or at 'max' speed\n"
+            "      --metrics=PATH      serve Prometheus metrics on the Unix socket PATH\n"
+            "      --latency           add per stage latencies to the events\n"
+            "      --record=FILE       record the netlink messages read to the pcap FILE\n"
+            "      --from-capture=FILE process the netlink capture FILE instead of the\n"
+            "                          kernel's messages, as fast as possible\n"
+            "      --memstats          account the memory held by each cache, index and\n"
+            "                          buffer, reported with the statistics and metrics\n"
+            "      --footprint=ROUTES  print the memory expected for ROUTES routes\n"
+            "                          with the other options given, then exit\n"
+            "      --perf[=SEC]        count cycles, instructions, cache and branch\n"
+            "                          misses per callback, averages every SEC\n"
+            "                          seconds (default 10)\n"
+            "  -h, --help              show this help\n", prog);
+}
+
+/* Links known to be down, so their routes are only flushed as they go down */
+static struct {
+    int *ifindex;
+    size_t n, size;
+} down_links;
+
+/* Records whether a link is down, returns whether it already was */
+static int link_set_down(int ifindex, int down)
+{
+    size_t i, size;
+    int *p;
+
+    for (i = 0; i < down_links.n && down_links.ifindex[i] != ifindex; i++)
+        ;
+    if (i < down_links.n) {
+        if (!down)
+            down_links.ifindex[i] = down_links.ifindex[--down_links.n];
+        return 1;
+    }
+    if (!down)
+        return 0;
+    if (down_links.n == down_links.size) {
+        size = down_links.size ? 2 * down_links.size : 16;
+        p = mem_realloc(MEM_LINKS, down_links.ifindex, size * sizeof(*p));
+        if (!p)
+            return 0;
+        down_links.ifindex = p;
+        down_links.size = size;
+    }
+    down_links.ifindex[down_links.n++] = ifindex;
+    return 0;
+}
+
+static void seed_down_links(struct nl_cache *link_cache)
+{
+    struct nl_object *obj;
+
+    for (obj = nl_cache_get_first(link_cache); obj; obj = nl_cache_get_next(obj)) {
+        struct rtnl_link *link = (struct rtnl_link *)obj;
+
+        if (!(rtnl_link_get_flags(link) & IFF_UP))
+            link_set_down(rtnl_link_get_ifindex(link), 1);
+    }
 }
 
 static void link_change(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
 {
-    struct nl_cache *route_cache = (struct nl_cache *)data;
+    struct rmon_caches *caches = data;
     struct rtnl_link *link = (struct rtnl_link *)obj;
     int ifindex = rtnl_link_get_ifindex(link);
+    int down = !(rtnl_link_get_flags(link) & IFF_UP);
+    struct rmon_event ev;
 
     switch (action) {
     case NL_ACT_NEW:
-        printf("Link added, index: %d\n", ifindex);
+        event_link(&ev, RMON_REC_LINK_ADD, link);
+        emit(&ev);
+        link_set_down(ifindex, down);
         break;
     case NL_ACT_DEL:
-        printf("Link deleted, index: %d\n", ifindex);
-        check_routes_for_ifindex(route_cache, ifindex);
+        event_link(&ev, RMON_REC_LINK_DEL, link);
+        emit(&ev);
+        link_set_down(ifindex, 0);
+        check_routes_for_ifindex(caches->route, ifindex, FLUSH_ANY_NH, NULL);
         break;
     case NL_ACT_CHANGE:
-        printf("Link changed, index: %d\n", ifindex);
+        event_link(&ev, RMON_REC_LINK_CHANGE, link);
+        emit(&ev);
+        /* Other changes of a link that is down have nothing left to flush */
+        if (!link_set_down(ifindex, down) && down)
+            check_routes_for_ifindex(caches->route, ifindex, FLUSH_KEEP_LOCAL, NULL);
         break;
     }
 }
 
 static void addr_change(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
 {
-    struct nl_cache *route_cache = (struct nl_cache *)data;
+    struct rmon_caches *caches = data;
     struct rtnl_addr *addr = (struct rtnl_addr *)obj;
     struct nl_addr *local = NULL;
-    char addr_str[INET6_ADDRSTRLEN] = {0};
+    struct rmon_event ev;
     int ifindex;
 
     if (action == NL_ACT_DEL) {
         ifindex = rtnl_addr_get_ifindex(addr);
         local = rtnl_addr_get_local(addr);
         if (local) {
-            nl_addr2str(local, addr_str, sizeof(addr_str));
-            printf("Address deleted: %s on interface %d\n", addr_str, ifindex);
-            check_routes_for_ifindex(route_cache, ifindex);
+            event_addr(&ev, RMON_REC_ADDR_DEL, addr);
+            emit(&ev);
+            if (rtnl_addr_get_family(addr) != AF_INET)
+                return;
+            /* Losing the last IPv4 address takes all routes via the interface down */
+            if (!has_ipv4_addr(caches->addr, ifindex))
+                check_routes_for_ifindex(caches->route, ifindex, 0, local);
+            else
+                check_routes_for_ifindex(caches->route, -1, 0, local);
+        }
+    }
+}
+
+static void callback_start(void)
+{
+    const struct rx_stamp *st = rx_stamp();
+
+    callback_ns = metrics_now();
+    if (st)
+        lat_record(LAT_PARSE, callback_ns - st->in_ns);
+    perf_begin(&callback_perf);
+}
+
+static void callback_end(enum metric_cb cb, enum perf_handler h)
+{
+    perf_end(h, &callback_perf);
+    metric_time(cb, callback_ns);
+    callback_ns = 0;
+}
+
+/* The callbacks as registered, timed for the metrics and latencies */
+static void route_update(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
+{
+    callback_start();
+    route_change(cache, obj, action, data);
+    callback_end(METRIC_CB_ROUTE, PERF_ROUTE);
+}
+
+static void link_update(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
+{
+    callback_start();
+    link_change(cache, obj, action, data);
+    callback_end(METRIC_CB_LINK, PERF_LINK);
+}
+
+static void addr_update(struct nl_cache *cache, struct nl_object *obj, int action, void *data)
+{
+    callback_start();
+    addr_change(cache, obj, action, data);
+    callback_end(METRIC_CB_ADDR, PERF_ADDR);
+}
+
+static void cache_metrics(struct metrics_writer *w, void *data)
+{
+    struct rmon_caches *caches = data;
+
+    metrics_put(w, "rmon_cache_objects", "gauge", "Objects in the netlink caches.",
+                "cache=\"route\"", nl_cache_nitems(caches->route));
+    metrics_put(w, "rmon_cache_objects", "gauge", "Objects in the netlink caches.",
+                "cache=\"link\"", nl_cache_nitems(caches->link));
+    metrics_put(w, "rmon_cache_objects", "gauge", "Objects in the netlink caches.",
+                "cache=\"addr\"", nl_cache_nitems(caches->addr));
+}
+
+static size_t cache_entries(void *cache)
+{
+    return nl_cache_nitems(cache);
+}
+
+static size_t fp_entries(void *arg)
+{
+    return fp_count();
+}
+
+static void memory_entries(struct rmon_caches *caches)
+{
+    mem_entries(MEM_ROUTES, cache_entries, caches->route);
+    mem_entries(MEM_LINKS, cache_entries, caches->link);
+    mem_entries(MEM_ADDRS, cache_entries, caches->addr);
+    mem_entries(MEM_FP, fp_entries, NULL);
+}
+
+#define FOOTPRINT_SAMPLE    10000
+
+/*
+ * The route cache is sized from a sample of unicast routes with one
+ * gateway each, built and cached the way libnl does with the dump; the
+ * fingerprint table from its growth rule. Buffers are what the options
+ * given have allocated so far. Links and addresses aren't included.
+ */
+static int footprint(unsigned long routes)
+{
+    unsigned long sample = routes < FOOTPRINT_SAMPLE ? routes : FOOTPRINT_SAMPLE;
+    struct mem_usage before, after, u;
+    struct nl_addr *dst, *gw;
+    struct rtnl_nexthop *nh;
+    struct rtnl_route *route;
+    struct nl_cache *cache;
+    double per_route, total;
+    size_t buffers = 0;
+    unsigned long i;
+    uint32_t a;
+    int d, err;
+
+    mem_usage(MEM_ROUTES, &before);
+    mem_domain(MEM_ROUTES);
+    err = nl_cache_alloc_name("route/route", &cache);
+    if (err < 0) {
+        fprintf(stderr, "Unable to allocate route cache: %s\n", nl_geterror(err));
+        return err;
+    }
+    a = htonl(0x64400002);
+    gw = nl_addr_build(AF_INET, &a, sizeof(a));
+    for (i = 0; i < sample; i++) {
+        route = rtnl_route_alloc();
+        a = htonl(0x0a000000 + (i << 8));
+        dst = nl_addr_build(AF_INET, &a, sizeof(a));
+        nh = rtnl_route_nh_alloc();
+        if (!gw || !route || !dst || !nh) {
+            fprintf(stderr, "Unable to build sample routes\n");
+            return -NLE_NOMEM;
+        }
+        nl_addr_set_prefixlen(dst, 24);
+        rtnl_route_set_family(route, AF_INET);
+        rtnl_route_set_table(route, RT_TABLE_MAIN);
+        rtnl_route_set_type(route, RTN_UNICAST);
+        rtnl_route_set_protocol(route, RTPROT_BGP);
+        rtnl_route_set_scope(route, RT_SCOPE_UNIVERSE);
+        rtnl_route_set_dst(route, dst);
+        rtnl_route_nh_set_gateway(nh, gw);
+        rtnl_route_nh_set_ifindex(nh, 2);
+        rtnl_route_add_nexthop(route, nh);
+        nl_cache_add(cache, (struct nl_object *)route);
+        rtnl_route_put(route);
+        nl_addr_put(dst);
+    }
+    nl_addr_put(gw);
+    mem_domain(MEM_OTHER);
+    mem_usage(MEM_ROUTES, &after);
+    per_route = (double)(after.bytes - before.bytes) / sample;
+    nl_cache_free(cache);
+
+    printf("Footprint of %lu routes, from %lu sample routes with one nexthop:\n",
+           routes, sample);
+    printf("  route cache: %.1f bytes per route, %.0f bytes\n", per_route, per_route * routes);
+    printf("  fingerprints: %zu bytes\n", fp_table_bytes(routes));
+    total = per_route * routes + fp_table_bytes(routes);
+    for (d = MEM_MOVES; d < MEM_SELF; d++) {
+        mem_usage(d, &u);
+        if (!u.bytes && !u.mapped)
+            continue;
+        printf("  %s: %zu bytes\n", mem_domain_name(d), u.bytes + u.mapped);
+        buffers += u.bytes + u.mapped;
+    }
+    total += buffers;
+    printf("  total: %.0f bytes (%.1f MiB)\n", total, total / (1024 * 1024));
+    return 0;
+}
+
+#ifndef SO_MEMINFO
+#define SO_MEMINFO 55
+#endif
+
+static void socket_metrics(struct metrics_writer *w, void *data)
+{
+    uint32_t mem[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(mem);
+
+    if (getsockopt(nl_socket_get_fd(data), SOL_SOCKET, SO_MEMINFO, mem, &len) < 0 ||
+        len < (SK_MEMINFO_DROPS + 1) * sizeof(mem[0]))
+        return;
+    metrics_put(w, "rmon_netlink_drops_total", "counter",
+                "Messages the kernel dropped on the netlink socket.", NULL,
+                mem[SK_MEMINFO_DROPS]);
+    metrics_put(w, "rmon_netlink_rx_queue_bytes", "gauge",
+                "Memory queued on the netlink socket.", NULL, mem[SK_MEMINFO_RMEM_ALLOC]);
+    metrics_put(w, "rmon_netlink_rcvbuf_bytes", "gauge", "Netlink socket receive buffer.",
+                NULL, mem[SK_MEMINFO_RCVBUF]);
+    metrics_put(w, "rmon_netlink_resyncs_total", "counter",
+                "Cache resynchronizations after the netlink socket overran.", NULL, resyncs);
+}
+
+/*
+ * Events dropped when the socket overran (ENOBUFS) are made up for by
+ * dumping the caches again over a socket of their own; whatever changed
+ * meanwhile goes through the change callbacks. Links go first so routes
+ * on links that went down are flushed as they would have been.
+ */
+static int resync(struct nl_sock **sync_sk, struct rmon_caches *caches)
+{
+    int err;
+
+    if (!*sync_sk) {
+        *sync_sk = nl_socket_alloc();
+        if (!*sync_sk)
+            return -NLE_NOMEM;
+        err = nl_connect(*sync_sk, NETLINK_ROUTE);
+        if (err < 0) {
+            nl_socket_free(*sync_sk);
+            *sync_sk = NULL;
+            return err;
+        }
+    }
+
+    resyncs++;
+    mem_domain(MEM_LINKS);
+    err = nl_cache_resync(*sync_sk, caches->link, link_update, caches);
+    if (err >= 0) {
+        mem_domain(MEM_ADDRS);
+        err = nl_cache_resync(*sync_sk, caches->addr, addr_update, caches);
+    }
+    if (err >= 0) {
+        mem_domain(MEM_ROUTES);
+        err = nl_cache_resync(*sync_sk, caches->route, route_update, NULL);
+    }
+    mem_domain(MEM_OTHER);
+    return err;
+}
+
+struct cache_assoc {
+    struct nl_cache *cache;
+    change_func_t change;
+    void *data;
+};
+
+static void include_change(struct nl_object *obj, void *arg)
+{
+    struct cache_assoc *a = arg;
+
+    nl_cache_include(a->cache, obj, a->change, a->data);
+}
+
+/* What the cache manager does with the messages of the live socket */
+static int capture_input(struct nl_msg *msg, void *arg)
+{
+    struct rmon_caches *caches = arg;
+    struct cache_assoc a;
+
+    switch (nlmsg_hdr(msg)->nlmsg_type) {
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+        a = (struct cache_assoc){ caches->route, route_update, NULL };
+        break;
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+        a = (struct cache_assoc){ caches->link, link_update, caches };
+        break;
+    case RTM_NEWADDR:
+    case RTM_DELADDR:
+        a = (struct cache_assoc){ caches->addr, addr_update, caches };
+        break;
+    default:
+        return NL_SKIP;
+    }
+    nl_msg_parse(msg, include_change, &a);
+    return NL_OK;
+}
+
+static struct nl_cache *dump_cache(struct rmon_caches *caches, int type)
+{
+    switch (type) {
+    case RTM_NEWROUTE:
+        return caches->route;
+    case RTM_NEWLINK:
+        return caches->link;
+    case RTM_NEWADDR:
+        return caches->addr;
+    }
+    return NULL;
+}
+
+/* Fills the caches from the dump a capture starts with, without callbacks */
+static uint64_t load_dump(struct rmon_caches *caches)
+{
+    struct nlmsghdr *nlh;
+    struct nl_cache *cache;
+    struct nl_msg *msg;
+    uint64_t loaded = 0;
+    const void *data;
+    uint64_t batch;
+    int rem;
+
+    while ((rem = capture_next(&data, &batch))) {
+        nlh = (struct nlmsghdr *)data;
+        if (!nlmsg_ok(nlh, rem) || !(nlh->nlmsg_flags & NLM_F_MULTI)) {
+            capture_unread();
+            break;
+        }
+        for (; nlmsg_ok(nlh, rem); nlh = nlmsg_next(nlh, &rem)) {
+            if (nlh->nlmsg_type == NLMSG_DONE)
+                return loaded;
+            cache = dump_cache(caches, nlh->nlmsg_type);
+            mem_domain(mem_msg_domain(nlh->nlmsg_type));
+            msg = cache ? nlmsg_convert(nlh) : NULL;
+            if (!msg)
+                continue;
+            if (nl_cache_parse_and_add(cache, msg) == 0)
+                loaded++;
+            nlmsg_free(msg);
         }
     }
+    return loaded;
+}
+
+/*
+ * Pushes a capture through the same receive path, caches and callbacks as
+ * the live socket, then reports where the time and memory went. Nothing
+ * is read from the kernel.
+ */
+static int from_capture(const char *path)
+{
+    struct rmon_caches caches = { 0 };
+    uint64_t start, loaded, processed, done, objects, events;
+    struct nl_sock *sk = NULL;
+    struct nl_cb *cb = NULL;
+    struct rusage ru;
+    int err;
+
+    err = capture_open(path);
+    if (err < 0) {
+        fprintf(stderr, "Unable to open capture: %s\n", nl_geterror(err));
+        return -1;
+    }
+
+    if ((err = nl_cache_alloc_name("route/route", &caches.route)) < 0 ||
+        (err = nl_cache_alloc_name("route/link", &caches.link)) < 0 ||
+        (err = nl_cache_alloc_name("route/addr", &caches.addr)) < 0) {
+        fprintf(stderr, "Unable to allocate caches: %s\n", nl_geterror(err));
+        goto out;
+    }
+
+    start = metrics_now();
+    objects = load_dump(&caches);
+    mem_domain(MEM_OTHER);
+    fp_seed(caches.route);
+    seed_down_links(caches.link);
+    memory_entries(&caches);
+    sub_set_snapshot(snapshot, &caches);
+    loaded = metrics_now();
+
+    sk = nl_socket_alloc();
+    if (!sk) {
+        err = -NLE_NOMEM;
+        fprintf(stderr, "Unable to allocate netlink socket\n");
+        goto out;
+    }
+    nl_socket_disable_seq_check(sk);
+    err = rx_install(sk, batch_done, NULL);
+    cb = nl_socket_get_cb(sk);
+    if (err >= 0 && cb)
+        err = nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, capture_input, &caches);
+    if (err < 0 || !cb) {
+        fprintf(stderr, "Unable to set up receive path: %s\n", nl_geterror(err));
+        goto out;
+    }
+    rx_set_source(capture_read);
+
+    install_signals();
+    while (!stop_requested) {
+        err = nl_recvmsgs_report(sk, cb);
+        /* The receive path leaves the domain of the last message behind */
+        mem_domain(MEM_OTHER);
+        if (err < 0) {
+            fprintf(stderr, "Processing capture failed: %s\n", nl_geterror(err));
+            break;
+        }
+        damp_sweep(route_reusable, caches.route);
+        if (report_requested) {
+            report_requested = 0;
+            report();
+        }
+        if (!err && rx_drained())
+            break;
+    }
+    processed = metrics_now();
+    out_flush();
+    done = metrics_now();
+
+    events = event_last_seq();
+    getrusage(RUSAGE_SELF, &ru);
+    report();
+    fprintf(stderr, "Capture: %llu objects loaded in %.3f s, %llu events in %.3f s "
+            "(%.0f events/s), output drained in %.3f s, peak RSS: %ld KiB\n",
+            (unsigned long long)objects, (loaded - start) / 1e9, (unsigned long long)events,
+            (processed - loaded) / 1e9,
+            processed > loaded ? events * 1e9 / (processed - loaded) : 0.0,
+            (done - processed) / 1e9, ru.ru_maxrss);
+
+out:
+    if (cb)
+        nl_cb_put(cb);
+    if (sk)
+        nl_socket_free(sk);
+    if (caches.route)
+        nl_cache_free(caches.route);
+    if (caches.link)
+        nl_cache_free(caches.link);
+    if (caches.addr)
+        nl_cache_free(caches.addr);
+    capture_input_close();
+    return err < 0 ? -1 : 0;
 }
 
 int main(int argc, char **argv)
 {
     struct nl_cache_mngr *mngr;
-    struct nl_cache *route_cache, *link_cache, *addr_cache;
-    int err;
+    struct rmon_caches caches;
+    static const struct option options[] = {
+        { "move-window", required_argument, NULL, 'w' },
+        { "damp",        required_argument, NULL, 'd' },
+        { "flush",       required_argument, NULL, 'f' },
+        { "format",      required_argument, NULL, 'F' },
+        { "overflow",    required_argument, NULL, 'O' },
+        { "out-queue",   required_argument, NULL, 'U' },
+        { "ring",        required_argument, NULL, 'r' },
+        { "ring-size",   required_argument, NULL, 'R' },
+        { "subscribe",   required_argument, NULL, 's' },
+        { "sub-queue",   required_argument, NULL, 'Q' },
+        { "journal",     required_argument, NULL, 'j' },
+        { "journal-size", required_argument, NULL, 'J' },
+        { "journal-keep", required_argument, NULL, 'K' },
+        { "replay",      required_argument, NULL, 'P' },
+        { "speed",       required_argument, NULL, 'S' },
+        { "metrics",     required_argument, NULL, 'M' },
+        { "latency",     no_argument,       NULL, 'L' },
+        { "record",      required_argument, NULL, 'C' },
+        { "from-capture", required_argument, NULL, 'I' },
+        { "memstats",    no_argument,       NULL, 'A' },
+        { "footprint",   required_argument, NULL, 'T' },
+        { "perf",        optional_argument, NULL, 'H' },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct pollfd pfd[1 + RING_POLLFDS + SUB_POLLFDS + METRICS_POLLFDS];
+    size_t ring_size = RING_DEFAULT_SIZE;
+    size_t sub_queue = SUB_DEFAULT_QUEUE;
+    const char *ring_path = NULL;
+    const char *sub_path = NULL;
+    size_t journal_size = JOURNAL_DEFAULT_SEGMENT;
+    unsigned int journal_keep = 0;
+    const char *journal_dir = NULL;
+    const char *replay_dir = NULL;
+    double replay_speed = 1;
+    const char *metrics_path = NULL;
+    const char *record_path = NULL;
+    const char *input_path = NULL;
+    unsigned long footprint_routes = 0;
+    unsigned long perf_interval = 0;
+    char *end;
+    int nring, nsub;
+    struct nl_sock *sk, *sync_sk = NULL;
+    int err, opt, n;
 
-    err = nl_cache_mngr_alloc(NULL, NETLINK_ROUTE, NL_AUTO_PROVIDE, &mngr);
+    startup_init();
+    while ((opt = getopt_long(argc, argv, "w:d:f:F:r:s:j:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'w':
+            rx_set_move_window(strtoul(optarg, NULL, 0));
+            break;
+        case 'd':
+            damp_init(strtoul(optarg, NULL, 0));
+            break;
+        case 'f':
+            if (out_set_policy(optarg) < 0) {
+                fprintf(stderr, "Invalid flush policy: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'F':
+            if (out_set_format(optarg) < 0) {
+                fprintf(stderr, "Invalid output format: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'O':
+            if (out_set_overflow(optarg) < 0) {
+                fprintf(stderr, "Invalid overflow policy: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'U':
+            out_set_queue(strtoul(optarg, NULL, 0));
+            break;
+        case 'r':
+            ring_path = optarg;
+            break;
+        case 'R':
+            ring_size = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            sub_path = optarg;
+            break;
+        case 'Q':
+            sub_queue = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            journal_dir = optarg;
+            break;
+        case 'J':
+            journal_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'K':
+            journal_keep = strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            replay_dir = optarg;
+            break;
+        case 'S':
+            replay_speed = strcmp(optarg, "max") ? strtod(optarg, &end) : 0;
+            if (replay_speed < 0 || (replay_speed == 0 && strcmp(optarg, "max")) ||
+                (replay_speed && *end)) {
+                fprintf(stderr, "Invalid replay speed: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'M':
+            metrics_path = optarg;
+            break;
+        case 'L':
+            embed_latency = 1;
+            break;
+        case 'C':
+            record_path = optarg;
+            break;
+        case 'I':
+            input_path = optarg;
+            break;
+        case 'A':
+        case 'T':
+            if (opt == 'T') {
+                footprint_routes = strtoul(optarg, &end, 0);
+                if (!footprint_routes || *end) {
+                    fprintf(stderr, "Invalid route count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+            }
+            err = mem_enable();
+            if (err < 0) {
+                fprintf(stderr, "Unable to enable memory accounting: %s\n", nl_geterror(err));
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'H':
+            perf_interval = optarg ? strtoul(optarg, &end, 0) : PERF_DEFAULT_INTERVAL;
+            if (!perf_interval || (optarg && *end)) {
+                fprintf(stderr, "Invalid perf interval: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    metrics_thread("main");
+    if (perf_interval) {
+        err = perf_init(perf_interval);
+        if (err < 0) {
+            fprintf(stderr, "Unable to open hardware counters: %s\n", nl_geterror(err));
+            return EXIT_FAILURE;
+        }
+    }
+    err = out_init(STDOUT_FILENO);
+    if (err < 0) {
+        fprintf(stderr, "Unable to start output: %s\n", nl_geterror(err));
+        return EXIT_FAILURE;
+    }
+    out_start();
+
+    if (ring_path) {
+        err = ring_init(ring_path, ring_size);
+        if (err < 0) {
+            fprintf(stderr, "Unable to set up event ring: %s\n", nl_geterror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (journal_dir) {
+        err = journal_init(journal_dir, journal_size, journal_keep);
+        if (err < 0) {
+            fprintf(stderr, "Unable to open journal directory: %s\n", nl_geterror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (sub_path) {
+        err = sub_init(sub_path, sub_queue);
+        if (err < 0) {
+            fprintf(stderr, "Unable to set up subscription socket: %s\n", nl_geterror(err));
+            ring_close();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (metrics_path) {
+        err = metrics_init(metrics_path);
+        if (err < 0) {
+            fprintf(stderr, "Unable to set up metrics socket: %s\n", nl_geterror(err));
+            ring_close();
+            sub_close();
+            return EXIT_FAILURE;
+        }
+        metrics_collector(out_metrics, NULL);
+        metrics_collector(ring_metrics, NULL);
+        metrics_collector(sub_metrics, NULL);
+        metrics_collector(journal_metrics, NULL);
+        if (perf_interval)
+            metrics_collector(perf_metrics, NULL);
+    }
+
+    if (footprint_routes) {
+        err = footprint(footprint_routes);
+        fflush(stdout);
+        out_close();
+        ring_close();
+        sub_close();
+        journal_close();
+        metrics_close();
+        return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (replay_dir) {
+        err = replay_init(replay_dir, replay_speed);
+        if (err < 0) {
+            fprintf(stderr, "Unable to open journal for replay: %s\n", nl_geterror(err));
+            ring_close();
+            sub_close();
+            return EXIT_FAILURE;
+        }
+        err = replay_loop();
+        out_flush();
+        replay_report(stderr);
+        out_close();
+        ring_close();
+        sub_close();
+        journal_close();
+        replay_close();
+        metrics_close();
+        return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (input_path) {
+        err = from_capture(input_path);
+        out_close();
+        ring_close();
+        sub_close();
+        journal_close();
+        metrics_close();
+        return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (record_path) {
+        err = capture_init(record_path);
+        if (err < 0) {
+            fprintf(stderr, "Unable to open capture file: %s\n", nl_geterror(err));
+            ring_close();
+            sub_close();
+            return EXIT_FAILURE;
+        }
+    }
+
+    startup_mark();
+    sk = nl_socket_alloc();
+    if (!sk) {
+        fprintf(stderr, "Unable to allocate netlink socket\n");
+        ring_close();
+        sub_close();
+        return EXIT_FAILURE;
+    }
+
+    err = rx_install(sk, batch_done, NULL);
+    if (err < 0) {
+        fprintf(stderr, "Unable to set up receive path: %s\n", nl_geterror(err));
+        nl_socket_free(sk);
+        ring_close();
+        sub_close();
+        return EXIT_FAILURE;
+    }
+
+    err = nl_cache_mngr_alloc(sk, NETLINK_ROUTE, NL_AUTO_PROVIDE, &mngr);
     if (err < 0) {
         fprintf(stderr, "Unable to allocate cache manager: %s\n", nl_geterror(err));
+        nl_socket_free(sk);
+        ring_close();
+        sub_close();
         return EXIT_FAILURE;
     }
 
-    err = nl_cache_mngr_add(mngr, "route/route", route_change, NULL, &route_cache);
+    /* Bursts such as a link flap must fit, or events are lost until a resync */
+    err = nl_socket_set_buffer_size(sk, NL_RCVBUF, 0);
+    if (err < 0)
+        fprintf(stderr, "Unable to set receive buffer: %s\n", nl_geterror(err));
+
+    startup_phase(RMON_STARTUP_SOCKET, 0);
+
+    mem_domain(MEM_ROUTES);
+    err = nl_cache_mngr_add(mngr, "route/route", route_update, NULL, &caches.route);
     if (err < 0) {
         fprintf(stderr, "Unable to add route cache: %s\n", nl_geterror(err));
         nl_cache_mngr_free(mngr);
+        nl_socket_free(sk);
+        ring_close();
+        sub_close();
         return EXIT_FAILURE;
     }
-    printf("Subscribed to route changes\n");
+    startup_phase(RMON_STARTUP_ROUTE_DUMP, nl_cache_nitems(caches.route));
+    fp_seed(caches.route);
+    startup_phase(RMON_STARTUP_INDEX, fp_count());
+    out_status("Subscribed to route changes\n");
 
-    err = nl_cache_mngr_add(mngr, "route/link", link_change, route_cache, &link_cache);
+    mem_domain(MEM_LINKS);
+    startup_mark();
+    err = nl_cache_mngr_add(mngr, "route/link", link_update, &caches, &caches.link);
     if (err < 0) {
         fprintf(stderr, "Unable to add link cache: %s\n", nl_geterror(err));
         nl_cache_mngr_free(mngr);
+        nl_socket_free(sk);
+        ring_close();
+        sub_close();
         return EXIT_FAILURE;
     }
-    printf("Subscribed to link changes\n");
+    startup_phase(RMON_STARTUP_LINK_DUMP, nl_cache_nitems(caches.link));
+    seed_down_links(caches.link);
+    out_status("Subscribed to link changes\n");
 
-    err = nl_cache_mngr_add(mngr, "route/addr", addr_change, route_cache, &addr_cache);
+    mem_domain(MEM_ADDRS);
+    startup_mark();
+    err = nl_cache_mngr_add(mngr, "route/addr", addr_update, &caches, &caches.addr);
     if (err < 0) {
         fprintf(stderr, "Unable to add addr cache: %s\n", nl_geterror(err));
         nl_cache_mngr_free(mngr);
+        nl_socket_free(sk);
+        ring_close();
+        sub_close();
         return EXIT_FAILURE;
     }
-    printf("Subscribed to addr changes\n");
+    startup_phase(RMON_STARTUP_ADDR_DUMP, nl_cache_nitems(caches.addr));
+    startup_ready();
+    out_status("Subscribed to addr changes\n");
+    mem_domain(MEM_OTHER);
+    memory_entries(&caches);
+    sub_set_snapshot(snapshot, &caches);
+    if (record_path)
+        capture_dump(caches.link, caches.addr, caches.route);
+    if (metrics_path) {
+        metrics_collector(rx_metrics, NULL);
+        metrics_collector(lat_metrics, NULL);
+        metrics_collector(capture_metrics, NULL);
+        metrics_collector(cache_metrics, &caches);
+        metrics_collector(socket_metrics, sk);
+        metrics_collector(startup_metrics, NULL);
+        if (mem_enabled())
+            metrics_collector(mem_metrics, NULL);
+    }
+    out_flush();
 
-    while (1) {
-        err = nl_cache_mngr_poll(mngr, -1);
-        if (err < 0) {
-            fprintf(stderr, "Polling failed: %s\n", nl_geterror(err));
+    install_signals();
+
+    pfd[0].fd = nl_cache_mngr_get_fd(mngr);
+    pfd[0].events = POLLIN;
+
+    while (!stop_requested) {
+        pfd[0].revents = 0;
+        nring = ring_pollfds(pfd + 1);
+        nsub = sub_pollfds(pfd + 1 + nring);
+        n = 1 + nring + nsub + metrics_pollfds(pfd + 1 + nring + nsub);
+        err = poll(pfd, n, min_timeout(min_timeout(min_timeout(rx_timeout(), out_timeout()),
+                                                   min_timeout(journal_timeout(), damp_timeout())),
+                                       metrics_timeout()));
+        if (err < 0 && errno != EINTR) {
+            fprintf(stderr, "Polling failed: %s\n", strerror(errno));
+            break;
+        }
+        err = 0;
+        /* Release held route deletions once the move window has passed */
+        if ((pfd[0].revents & POLLIN) || rx_timeout() == 0) {
+            err = nl_cache_mngr_data_ready(mngr);
+            /* The receive path leaves the domain of the last message behind */
+            mem_domain(MEM_OTHER);
+        }
+        if (err == -NLE_NOMEM) {
+            fprintf(stderr, "Event socket overran, resynchronizing caches\n");
+            err = resync(&sync_sk, &caches);
+        }
+        damp_sweep(route_reusable, caches.route);
+        ring_handle(pfd + 1, nring);
+        sub_handle(pfd + 1 + nring, nsub);
+        metrics_handle(pfd + 1 + nring + nsub, n - 1 - nring - nsub);
+        batch_end();
+        if (report_requested) {
+            report_requested = 0;
+            report();
+        }
+        if (err < 0 && err != -NLE_INTR) {
+            fprintf(stderr, "Receiving failed: %s\n", nl_geterror(err));
             break;
         }
     }
 
+    out_close();
+    ring_close();
+    sub_close();
+    journal_close();
+    capture_close();
+    metrics_close();
+    perf_close();
     nl_cache_mngr_free(mngr);
+    nl_socket_free(sk);
+    if (sync_sk)
+        nl_socket_free(sync_sk);
     return EXIT_SUCCESS;
 }
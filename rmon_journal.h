@@ -0,0 +1,128 @@
+/*
+ * Route monitor - event journal
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_JOURNAL_H
+#define RMON_JOURNAL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Event journal (--journal=DIR). Events are appended to preallocated,
+ * memory-mapped segment files named rmon-<ns>.jnl after the time they
+ * were started, so names sort chronologically:
+ *
+ *   [struct rmon_journal_hdr][index entries][pad to data_offset][blocks]
+ *
+ * Records are grouped into 8-byte aligned blocks, each a struct
+ * rmon_journal_block followed by the compact encoding described in
+ * journal_codec.h; every block decodes on its own. A block is written out
+ * once it is full or RMON_JOURNAL_BLOCK_AGE old.
+ *
+ * The index is sparse: the first block at or after every
+ * RMON_JOURNAL_INDEX_STRIDE bytes of data gets an entry with its time,
+ * sequence number and offset. data_end only ever grows and everything
+ * below it is complete, so a segment can be read while it is written. A
+ * finished segment is truncated to its data.
+ *
+ * Sequence numbers restart with every rmon run; run tells runs apart.
+ * Time lookups assume CLOCK_REALTIME doesn't step backwards.
+ */
+#define RMON_JOURNAL_MAGIC          0x4c4e4a52      /* "RJNL" */
+#define RMON_JOURNAL_VERSION        3
+#define RMON_JOURNAL_INDEX_STRIDE   (64 * 1024)
+#define RMON_JOURNAL_BLOCK_MAGIC    0x4b4c4252      /* "RBLK" */
+#define RMON_JOURNAL_BLOCK_SIZE     (32 * 1024)     /* encoded bytes */
+#define RMON_JOURNAL_BLOCK_AGE      1000            /* milliseconds */
+
+struct rmon_journal_block {
+    uint32_t magic;
+    uint32_t len;               /* encoded bytes after this header */
+    uint32_t records;
+    uint32_t raw_len;           /* bytes of the decoded records */
+    uint64_t first_seq;
+    uint64_t first_ts;
+    uint64_t last_seq;
+    uint64_t last_ts;
+};
+
+#define RMON_JOURNAL_BLOCK_SPAN(blk) \
+    ((sizeof(struct rmon_journal_block) + (blk)->len + 7) & ~(size_t)7)
+
+struct rmon_journal_index {
+    uint64_t ts;
+    uint64_t seq;
+    uint64_t offset;            /* from data_offset */
+};
+
+struct rmon_journal_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_len;
+    uint64_t run;               /* start time of the writing rmon, ns */
+    uint64_t data_offset;
+    uint64_t data_size;         /* room for records */
+    uint64_t first_seq;
+    uint64_t first_ts;
+    uint32_t index_cap;
+    _Atomic uint32_t index_len;
+    _Atomic uint32_t closed;
+    uint32_t reserved;
+    _Atomic uint64_t last_ts;
+    _Atomic uint64_t data_end;
+};
+
+static inline struct rmon_journal_index *rmon_journal_index(const struct rmon_journal_hdr *hdr)
+{
+    return (struct rmon_journal_index *)((char *)hdr + sizeof(*hdr));
+}
+
+struct rmon_journal_seg {
+    char *path;
+    const struct rmon_journal_hdr *hdr;
+    const unsigned char *data;
+    size_t map_size;
+};
+
+/*
+ * Reads the segments of a journal directory in order. Records returned by
+ * rmon_journal_next() stay valid until the next call.
+ */
+struct rmon_journal {
+    struct rmon_journal_seg *segs;
+    int nsegs;
+    int cur;
+    uint64_t off;               /* of the current block */
+    uint64_t next;              /* of the block after it */
+    unsigned char *buf;         /* decoded current block */
+    size_t cap;
+    size_t len;
+    size_t pos;
+    int loaded;
+    uint64_t scanned;           /* records looked at, including seeking */
+    uint64_t blocks;            /* blocks decoded */
+};
+
+int rmon_journal_open(struct rmon_journal *j, const char *dir);
+int rmon_journal_seek_time(struct rmon_journal *j, uint64_t ts);
+int rmon_journal_seek_seq(struct rmon_journal *j, uint64_t seq);
+int rmon_journal_next(struct rmon_journal *j, const struct rmon_rec_hdr **rec);
+void rmon_journal_close(struct rmon_journal *j);
+
+#endif
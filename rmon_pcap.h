@@ -0,0 +1,74 @@
+/*
+ * Route monitor - netlink capture format
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_PCAP_H
+#define RMON_PCAP_H
+
+#include <stdint.h>
+
+/*
+ * Netlink capture (--record=FILE): a pcap file with nanosecond timestamps
+ * and the link type nlmon captures have, so Wireshark and tcpdump read it
+ * as they would a capture taken on an nlmon device. Every packet holds the
+ * bytes of one read from the netlink socket after a cooked header, fields
+ * of which are big endian; the netlink messages are in host byte order.
+ *
+ * Captures start with the state rmon began with, as an rtnetlink dump of
+ * its link, address and route caches (NLM_F_MULTI messages ending with
+ * NLMSG_DONE), followed by the notifications in the order they were read.
+ * Captures taken on an nlmon device lack the dump and may have microsecond
+ * timestamps; --from-capture reads those too. rmon-gen writes synthetic
+ * workloads in the same form.
+ */
+#define RMON_PCAP_MAGIC         0xa1b23c4d      /* nanosecond resolution */
+#define RMON_PCAP_MAGIC_USEC    0xa1b2c3d4      /* what tcpdump writes */
+#define RMON_PCAP_VERSION_MAJOR 2
+#define RMON_PCAP_VERSION_MINOR 4
+#define RMON_PCAP_LINKTYPE      253             /* LINKTYPE_NETLINK */
+#define RMON_PCAP_SNAPLEN       (1024 * 1024)
+
+struct rmon_pcap_hdr {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct rmon_pcap_rec {
+    uint32_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+/*
+ * Linux cooked header of LINKTYPE_NETLINK. Netlink has no link layer
+ * address (halen is 0), rmon puts the number of the receive batch the read
+ * belonged to in addr instead, 0 for the dump. nlmon leaves it zero.
+ */
+struct rmon_pcap_nl {
+    uint16_t pkttype;           /* PACKET_USER, delivered to a user socket */
+    uint16_t hatype;            /* ARPHRD_NETLINK */
+    uint16_t halen;
+    uint8_t addr[8];            /* big endian batch number */
+    uint16_t family;            /* NETLINK_ROUTE */
+};
+
+#endif
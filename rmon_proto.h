@@ -0,0 +1,230 @@
+/*
+ * Route monitor - binary event stream format
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_PROTO_H
+#define RMON_PROTO_H
+
+#include <stdint.h>
+
+/*
+ * Binary event stream (--format=binary). A stream is a sequence of
+ * length-prefixed records, each starting with struct rmon_rec_hdr. Records
+ * are 8-byte aligned and laid out in host byte order; the stream record that
+ * opens every stream carries RMON_PROTO_MAGIC so a reader can detect a byte
+ * order mismatch. Addresses are raw 4 or 16 byte network order values
+ * stored in 16-byte fields, with a separate length byte.
+ *
+ * Readers must skip records of unknown type using hdr.len, and may rely on
+ * fields only ever being appended to a record body within one version.
+ * A record flagged RMON_REC_F_LATENCY ends with struct rmon_rec_latency,
+ * after everything else in it.
+ */
+#define RMON_PROTO_MAGIC        0x4e4f4d52      /* "RMON" */
+#define RMON_PROTO_VERSION      1
+
+enum rmon_rec_type {
+    RMON_REC_STREAM = 1,
+    RMON_REC_ROUTE_ADD,
+    RMON_REC_ROUTE_DEL,
+    RMON_REC_ROUTE_CHANGE,
+    RMON_REC_ROUTE_MOVE,
+    RMON_REC_ROUTE_INVALIDATE,
+    RMON_REC_ROUTE_DAMPED,
+    RMON_REC_ROUTE_REUSABLE,
+    RMON_REC_LINK_ADD,
+    RMON_REC_LINK_DEL,
+    RMON_REC_LINK_CHANGE,
+    RMON_REC_ADDR_DEL,
+    RMON_REC_DROPPED,
+    RMON_REC_ADDR_ADD,
+    RMON_REC_SNAPSHOT_BEGIN,
+    RMON_REC_SNAPSHOT_END,
+    RMON_REC_STARTUP,
+    RMON_REC_MAX
+};
+
+/* hdr.flags */
+#define RMON_REC_F_TRUNCATED    0x1     /* not all nexthops fitted */
+#define RMON_REC_F_SNAPSHOT     0x2     /* current state, not a change */
+#define RMON_REC_F_LATENCY      0x4     /* ends with struct rmon_rec_latency */
+
+struct rmon_rec_hdr {
+    uint16_t len;           /* whole record including this header */
+    uint8_t version;
+    uint8_t type;
+    uint32_t flags;
+    uint64_t seq;           /* stream sequence number, 0 for the stream record */
+    uint64_t ts;            /* CLOCK_REALTIME in nanoseconds */
+};
+
+struct rmon_rec_stream {
+    uint32_t magic;
+    uint16_t hdr_len;
+    uint16_t reserved;
+    uint64_t start_seq;     /* sequence number of the first event */
+};
+
+/* Events a subscriber missed because its queue was full */
+struct rmon_rec_dropped {
+    uint64_t events;
+    uint64_t first_seq;
+};
+
+/*
+ * Brackets a state snapshot. Its records carry RMON_REC_F_SNAPSHOT and the
+ * sequence number the state is consistent with; events after it start at
+ * seq + 1.
+ */
+struct rmon_rec_snapshot {
+    uint64_t seq;
+    uint64_t records;       /* state records in between, end record only */
+};
+
+enum rmon_startup_phase {
+    RMON_STARTUP_SOCKET,        /* netlink socket and cache manager */
+    RMON_STARTUP_ROUTE_DUMP,
+    RMON_STARTUP_INDEX,         /* fingerprints of the dumped routes */
+    RMON_STARTUP_LINK_DUMP,
+    RMON_STARTUP_ADDR_DUMP,
+    RMON_STARTUP_FIRST_EVENT,   /* from ready until the first event */
+    RMON_STARTUP_PHASES
+};
+
+struct rmon_rec_startup_phase {
+    uint64_t ns;                /* CLOCK_MONOTONIC duration */
+    uint64_t objects;           /* loaded by the phase */
+};
+
+/*
+ * How long startup took, sent once right before the first event. The
+ * phases run one after the other, ready_ns also covers setting up the
+ * outputs before them.
+ */
+struct rmon_rec_startup {
+    uint64_t ready_ns;          /* from start until all caches are subscribed */
+    struct rmon_rec_startup_phase phase[RMON_STARTUP_PHASES];
+};
+
+/*
+ * How long the event took, from reading the netlink message that caused
+ * it off the socket (--latency). Values saturate at UINT32_MAX.
+ */
+struct rmon_rec_latency {
+    uint32_t total_ns;      /* until the event was emitted */
+    uint32_t lane_ns;       /* waiting in its receive lane */
+    uint32_t parse_ns;      /* libnl parsing and cache update */
+    uint32_t handle_ns;     /* change callback, including invalidation */
+};
+
+struct rmon_rec_nh {
+    int32_t ifindex;
+    uint8_t gw_len;         /* 0 (no gateway), 4 or 16 */
+    uint8_t weight;
+    uint8_t flags;          /* RTNH_F_* */
+    uint8_t reserved;
+    uint8_t gw[16];
+};
+
+/*
+ * Route records are followed by nnh nexthops; a move record is followed by
+ * nnh current nexthops and then old_nnh previous ones.
+ */
+struct rmon_rec_route {
+    uint8_t family;
+    uint8_t dst_len;        /* prefix length */
+    uint8_t dst_alen;       /* 0 (no destination attribute), 4 or 16 */
+    uint8_t tos;
+    uint8_t protocol;
+    uint8_t scope;
+    uint8_t rtype;
+    uint8_t nnh;
+    uint8_t old_nnh;
+    uint8_t reserved[3];
+    uint32_t table;
+    uint32_t priority;
+    uint32_t aux;           /* damped: penalty, reusable: summarized events */
+    uint8_t dst[16];
+};
+
+struct rmon_rec_link {
+    int32_t ifindex;
+    uint32_t flags;         /* IFF_* */
+    uint32_t mtu;
+    uint32_t reserved;
+    char name[16];
+};
+
+struct rmon_rec_addr {
+    int32_t ifindex;
+    uint8_t family;
+    uint8_t prefixlen;
+    uint8_t alen;
+    uint8_t reserved;
+    uint8_t local[16];
+};
+
+#define RMON_REC_ROUTE_LEN(nnh) \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_route) + \
+     (nnh) * sizeof(struct rmon_rec_nh))
+#define RMON_REC_LINK_LEN \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_link))
+#define RMON_REC_ADDR_LEN \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_addr))
+#define RMON_REC_STREAM_LEN \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_stream))
+#define RMON_REC_DROPPED_LEN \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_dropped))
+#define RMON_REC_SNAPSHOT_LEN \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_snapshot))
+#define RMON_REC_STARTUP_LEN \
+    (sizeof(struct rmon_rec_hdr) + sizeof(struct rmon_rec_startup))
+
+static inline const void *rmon_rec_body(const struct rmon_rec_hdr *hdr)
+{
+    return hdr + 1;
+}
+
+static inline const struct rmon_rec_nh *rmon_rec_nexthops(const struct rmon_rec_hdr *hdr)
+{
+    return (const struct rmon_rec_nh *)((const struct rmon_rec_route *)(hdr + 1) + 1);
+}
+
+static inline const struct rmon_rec_latency *rmon_rec_latency(const struct rmon_rec_hdr *hdr)
+{
+    if (!(hdr->flags & RMON_REC_F_LATENCY) ||
+        hdr->len < sizeof(*hdr) + sizeof(struct rmon_rec_latency))
+        return NULL;
+    return (const struct rmon_rec_latency *)((const char *)hdr + hdr->len -
+                                              sizeof(struct rmon_rec_latency));
+}
+
+static inline int rmon_rec_is_route(const struct rmon_rec_hdr *hdr)
+{
+    return hdr->type >= RMON_REC_ROUTE_ADD && hdr->type <= RMON_REC_ROUTE_REUSABLE;
+}
+
+static inline int rmon_rec_is_link(const struct rmon_rec_hdr *hdr)
+{
+    return hdr->type >= RMON_REC_LINK_ADD && hdr->type <= RMON_REC_LINK_CHANGE;
+}
+
+static inline int rmon_rec_is_addr(const struct rmon_rec_hdr *hdr)
+{
+    return hdr->type == RMON_REC_ADDR_DEL || hdr->type == RMON_REC_ADDR_ADD;
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * Route monitor - event stream reader
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_READER_H
+#define RMON_READER_H
+
+#include <stddef.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Reads binary records from a file descriptor. Records returned by
+ * rmon_reader_next() stay valid until the next call.
+ */
+struct rmon_reader {
+    int fd;
+    unsigned char *buf;
+    size_t cap;
+    size_t start;
+    size_t end;
+    int eof;
+};
+
+int rmon_reader_init(struct rmon_reader *r, int fd);
+int rmon_reader_next(struct rmon_reader *r, const struct rmon_rec_hdr **rec);
+void rmon_reader_free(struct rmon_reader *r);
+
+int rmon_rec_check(const struct rmon_rec_hdr *rec, size_t avail);
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Route monitor - shared memory ring
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_RING_H
+#define RMON_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Shared memory ring (--ring=PATH). rmon writes every event record into a
+ * memfd shared with local consumers, which get the memfd, a slot and an
+ * eventfd of their own over the Unix socket at PATH:
+ *
+ *   [struct rmon_ring_hdr][pad to RMON_RING_DATA_OFFSET][data]
+ *
+ * head and tail are byte positions that only grow; the data at position p
+ * lives at data[p & (size - 1)]. Records never wrap: the space left at the
+ * end of the data area is skipped with an RMON_RING_PAD record, or
+ * implicitly if even a header does not fit. Everything between tail and
+ * head is intact, tail is advanced before anything is overwritten. rmon
+ * keeps both to itself and only publishes them; the memfd is sealed against
+ * writes once rmon has mapped it, so readers can only map it read-only.
+ *
+ * A reader owns one slot, a memfd of its own shared with rmon only: it
+ * publishes its cursor there (for lag accounting only, the writer never
+ * waits for anybody) and sets waiting before it sleeps on its eventfd,
+ * which rmon signals once per batch.
+ */
+#define RMON_RING_MAGIC         0x474e4952      /* "RING" */
+#define RMON_RING_VERSION       2
+#define RMON_RING_SLOTS         32
+#define RMON_RING_DATA_OFFSET   4096
+#define RMON_RING_PAD           0               /* record type of padding */
+#define RMON_RING_NO_SLOT       0xffff
+
+struct rmon_ring_slot {
+    _Atomic uint64_t cursor;
+    _Atomic uint32_t waiting;
+    uint32_t reserved;
+};
+
+struct rmon_ring_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t nslots;                /* readers served at a time */
+    uint64_t size;                  /* data area size, a power of two */
+    _Atomic uint64_t head __attribute__((aligned(64)));
+    _Atomic uint64_t tail;
+    _Atomic uint64_t seq;           /* sequence number of the newest record */
+};
+
+/* Sent with SCM_RIGHTS [memfd, slot memfd, eventfd] to every connecting reader */
+struct rmon_ring_hello {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slot;                  /* RMON_RING_NO_SLOT if all are taken */
+    uint64_t map_size;
+};
+
+/*
+ * Records are handed out in place. A reader that may be lapped while it
+ * looks at one checks rmon_ring_intact() before trusting what it read.
+ */
+struct rmon_ring_reader {
+    const struct rmon_ring_hdr *hdr;
+    const unsigned char *data;
+    size_t map_size;
+    struct rmon_ring_slot *slot;
+    int efd;
+    int sock;
+    uint64_t cursor;
+    uint64_t last;                  /* position of the last returned record */
+    uint64_t last_seq;
+    uint64_t lost;                  /* events skipped after overruns */
+    uint64_t overruns;
+};
+
+int rmon_ring_connect(struct rmon_ring_reader *r, const char *path);
+int rmon_ring_next(struct rmon_ring_reader *r, const struct rmon_rec_hdr **rec);
+int rmon_ring_intact(const struct rmon_ring_reader *r);
+int rmon_ring_wait(struct rmon_ring_reader *r, int timeout);
+void rmon_ring_close(struct rmon_ring_reader *r);
+
+#endif
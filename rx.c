@@ -0,0 +1,640 @@
+/*
+ * Route monitor - netlink receive path
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <netlink/handlers.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+#include "hash.h"
+#include "latency.h"
+#include "mem.h"
+#include "metrics.h"
+#include "rx.h"
+
+#define RX_HEADROOM     (64 * 1024)
+#define RX_BATCH_MAX    (1024 * 1024)
+
+struct rx_msg {
+    uint32_t off;
+    uint32_t len;
+    uint8_t lane;
+    uint64_t read_ns;
+};
+
+/* Bytes up to end were read at ns */
+struct rx_chunk {
+    size_t end;
+    uint64_t ns;
+};
+
+struct rx_slot {
+    uint8_t lane;
+    uint64_t read_ns;
+};
+
+struct rx_key {
+    uint64_t hash;
+    uint16_t last_type;
+    uint8_t lane;
+    uint8_t paired;
+};
+
+struct lane_stats {
+    uint64_t msgs;
+    uint64_t wait_ns;
+    uint64_t max_wait_ns;
+};
+
+static const char *lane_names[LANE_MAX] = {
+    [LANE_LINK] = "link/addr",
+    [LANE_ROUTE_DEL] = "route-del",
+    [LANE_ROUTE] = "route",
+};
+
+static struct {
+    unsigned char *buf;
+    size_t cap;
+    struct rx_msg *msgs;
+    size_t nmsgs, msgs_cap;
+    struct rx_chunk *chunks;
+    size_t nchunks, chunks_cap;
+    struct rx_slot *order;
+    size_t order_cap, cursor;
+    struct rx_stamp cur;
+    int in_msg;
+    struct rx_key *keys;
+    size_t keys_cap, nkeys;
+    uint64_t rx_ns;
+    int pending_err;
+    int in_batch;
+    size_t held_len;
+    uint64_t held_deadline;
+    uint64_t move_window_ns;
+    void (*batch_done)(void *);
+    void *batch_arg;
+    ssize_t (*source)(const void **data);
+    int source_end;
+    uint64_t batches;
+    uint64_t demoted;
+    uint64_t paired;
+    struct lane_stats lanes[LANE_MAX];
+} rx;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t hash_ifindex(uint8_t tag, uint32_t ifindex)
+{
+    uint64_t h = HASH_INIT;
+
+    h = hash_bytes(h, &tag, sizeof(tag));
+    return hash_bytes(h, &ifindex, sizeof(ifindex)) | 1;
+}
+
+/* Same identity libnl uses for route objects: family, tos, table, dst, priority */
+static uint64_t hash_route(struct nlmsghdr *nlh, uint32_t *oifs, int *noifs, int max_oifs)
+{
+    struct rtmsg *rtm = nlmsg_data(nlh);
+    uint32_t table = rtm->rtm_table;
+    uint32_t priority = 0;
+    struct nlattr *dst = NULL;
+    struct nlattr *nla;
+    int rem;
+
+    *noifs = 0;
+    nlmsg_for_each_attr(nla, nlh, sizeof(*rtm), rem) {
+        switch (nla_type(nla)) {
+        case RTA_DST:
+            dst = nla;
+            break;
+        case RTA_TABLE:
+            table = nla_get_u32(nla);
+            break;
+        case RTA_PRIORITY:
+            priority = nla_get_u32(nla);
+            break;
+        case RTA_OIF:
+            if (*noifs < max_oifs)
+                oifs[(*noifs)++] = nla_get_u32(nla);
+            break;
+        case RTA_MULTIPATH: {
+            struct rtnexthop *rtnh = nla_data(nla);
+            int len = nla_len(nla);
+
+            while (RTNH_OK(rtnh, len) && *noifs < max_oifs) {
+                oifs[(*noifs)++] = rtnh->rtnh_ifindex;
+                len -= NLMSG_ALIGN(rtnh->rtnh_len);
+                rtnh = RTNH_NEXT(rtnh);
+            }
+            break;
+        }
+        }
+    }
+
+    return hash_route_key(rtm->rtm_family, rtm->rtm_tos, table, rtm->rtm_dst_len,
+                          dst ? nla_data(dst) : NULL, dst ? nla_len(dst) : 0,
+                          priority);
+}
+
+static struct rx_key *key_slot(uint64_t hash)
+{
+    size_t mask = rx.keys_cap - 1;
+    size_t i = hash & mask;
+
+    while (rx.keys[i].hash && rx.keys[i].hash != hash)
+        i = (i + 1) & mask;
+    return &rx.keys[i];
+}
+
+static int keys_rehash(size_t cap)
+{
+    struct rx_key *old = rx.keys;
+    size_t old_cap = rx.keys_cap;
+    size_t i;
+
+    rx.keys = mem_calloc(MEM_RX, cap, sizeof(*rx.keys));
+    if (!rx.keys) {
+        rx.keys = old;
+        return -NLE_NOMEM;
+    }
+    rx.keys_cap = cap;
+    for (i = 0; i < old_cap; i++)
+        if (old[i].hash)
+            *key_slot(old[i].hash) = old[i];
+    free(old);
+    return 0;
+}
+
+static struct rx_key *key_find(uint64_t hash)
+{
+    struct rx_key *k = key_slot(hash);
+
+    return k->hash ? k : NULL;
+}
+
+/* Returns NULL if the table can't grow; ordering then falls back to FIFO */
+static struct rx_key *key_get(uint64_t hash)
+{
+    struct rx_key *k = key_slot(hash);
+
+    if (k->hash)
+        return k;
+
+    /* Keep the load factor under one half */
+    if (2 * (rx.nkeys + 1) > rx.keys_cap) {
+        if (keys_rehash(2 * rx.keys_cap) < 0)
+            return NULL;
+        k = key_slot(hash);
+    }
+    k->hash = hash;
+    rx.nkeys++;
+    return k;
+}
+
+static uint8_t key_lane(uint64_t hash)
+{
+    struct rx_key *k = key_find(hash);
+
+    return k ? k->lane : 0;
+}
+
+static void key_raise(uint64_t hash, uint8_t lane)
+{
+    struct rx_key *k = key_get(hash);
+
+    if (k && k->lane < lane)
+        k->lane = lane;
+}
+
+/*
+ * A message never moves ahead of an earlier one with the same key: its lane
+ * is raised to the highest lane already taken by that key in this batch.
+ * Link and address messages also wait for pending route messages through
+ * the same interface, since they can invalidate routes in the cache. A route
+ * addition directly following a deletion of the same key is marked as a
+ * pair so the two can be reported as one move.
+ */
+static uint8_t classify(struct nlmsghdr *nlh)
+{
+    uint32_t oifs[32];
+    struct rx_key *k;
+    uint64_t hash;
+    uint8_t lane;
+    int noifs, i;
+
+    switch (nlh->nlmsg_type) {
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+        if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg)))
+            return LANE_LINK;
+        lane = nlh->nlmsg_type == RTM_DELROUTE ? LANE_ROUTE_DEL : LANE_ROUTE;
+        hash = hash_route(nlh, oifs, &noifs, 32);
+        k = key_get(hash);
+        if (k) {
+            if (k->lane > lane) {
+                lane = k->lane;
+                rx.demoted++;
+            }
+            if (nlh->nlmsg_type == RTM_NEWROUTE && k->last_type == RTM_DELROUTE) {
+                k->paired = 1;
+                rx.paired++;
+            }
+            k->lane = lane;
+            k->last_type = nlh->nlmsg_type;
+        }
+        for (i = 0; i < noifs; i++)
+            key_raise(hash_ifindex('R', oifs[i]), lane);
+        return lane;
+
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+    case RTM_NEWADDR:
+    case RTM_DELADDR: {
+        uint8_t route_lane;
+        uint32_t ifindex;
+
+        if (nlh->nlmsg_type == RTM_NEWLINK || nlh->nlmsg_type == RTM_DELLINK) {
+            if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg)))
+                return LANE_LINK;
+            ifindex = ((struct ifinfomsg *)nlmsg_data(nlh))->ifi_index;
+        } else {
+            if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifaddrmsg)))
+                return LANE_LINK;
+            ifindex = ((struct ifaddrmsg *)nlmsg_data(nlh))->ifa_index;
+        }
+
+        hash = hash_ifindex('L', ifindex);
+        lane = key_lane(hash);
+        route_lane = key_lane(hash_ifindex('R', ifindex));
+        if (route_lane > lane)
+            lane = route_lane;
+        if (lane != LANE_LINK)
+            rx.demoted++;
+        key_raise(hash, lane);
+        return lane;
+    }
+    default:
+        return LANE_LINK;
+    }
+}
+
+static int grow(void **ptr, size_t *cap, size_t need, size_t size)
+{
+    size_t n = *cap ? *cap : 64;
+    void *p;
+
+    if (need <= *cap)
+        return 0;
+    while (n < need)
+        n *= 2;
+    p = mem_realloc(MEM_RX, *ptr, n * size);
+    if (!p)
+        return -NLE_NOMEM;
+    *ptr = p;
+    *cap = n;
+    return 0;
+}
+
+/*
+ * Route deletions at the tail of a batch may be the first half of a
+ * delete/add pair split across two reads. With a move window they are kept
+ * back (at the start of rx.buf) until more data arrives or the window ends.
+ * Bytes below hold_from were held before and are never held again.
+ */
+static int reorder(unsigned char *in, size_t len, size_t hold_from, unsigned char **out)
+{
+    struct nlmsghdr *nlh = (struct nlmsghdr *)in;
+    size_t i, nbatch, total, chunk = 0, held = 0;
+    int rem = len;
+    unsigned char *p;
+    int lane, ret;
+
+    rx.nmsgs = 0;
+    for (; nlmsg_ok(nlh, rem); nlh = nlmsg_next(nlh, &rem)) {
+        struct rx_msg *m;
+
+        if (grow((void **)&rx.msgs, &rx.msgs_cap, rx.nmsgs + 1, sizeof(*rx.msgs)) < 0)
+            return -NLE_NOMEM;
+        m = &rx.msgs[rx.nmsgs++];
+        m->off = (unsigned char *)nlh - in;
+        m->len = NLMSG_ALIGN(nlh->nlmsg_len);
+        while (chunk + 1 < rx.nchunks && m->off >= rx.chunks[chunk].end)
+            chunk++;
+        m->read_ns = rx.nchunks ? rx.chunks[chunk].ns : rx.rx_ns;
+    }
+
+    nbatch = rx.nmsgs;
+    if (rx.move_window_ns) {
+        while (nbatch && rx.msgs[nbatch - 1].off >= hold_from &&
+               ((struct nlmsghdr *)(in + rx.msgs[nbatch - 1].off))->nlmsg_type == RTM_DELROUTE) {
+            nbatch--;
+            held += rx.msgs[nbatch].len;
+        }
+    }
+    total = rx.nmsgs;
+    rx.nmsgs = nbatch;
+
+    if (grow((void **)&rx.order, &rx.order_cap, rx.nmsgs, sizeof(*rx.order)) < 0)
+        return -NLE_NOMEM;
+    if (!rx.keys && keys_rehash(1024) < 0)
+        return -NLE_NOMEM;
+    memset(rx.keys, 0, rx.keys_cap * sizeof(*rx.keys));
+    rx.nkeys = 0;
+
+    for (i = 0; i < rx.nmsgs; i++)
+        rx.msgs[i].lane = classify((struct nlmsghdr *)(in + rx.msgs[i].off));
+
+    if (held == len) {
+        *out = NULL;
+        ret = 0;
+        goto hold;
+    }
+
+    p = *out = mem_malloc(MEM_RX, len - held);
+    if (!p)
+        return -NLE_NOMEM;
+
+    rx.cursor = 0;
+    for (lane = 0; lane < LANE_MAX; lane++) {
+        for (i = 0; i < rx.nmsgs; i++) {
+            if (rx.msgs[i].lane != lane)
+                continue;
+            memcpy(p, in + rx.msgs[i].off, rx.msgs[i].len);
+            p += rx.msgs[i].len;
+            rx.order[rx.cursor].lane = lane;
+            rx.order[rx.cursor++].read_ns = rx.msgs[i].read_ns;
+        }
+    }
+    rx.cursor = 0;
+    ret = p - *out;
+
+hold:
+    /* Held messages keep the time they were read */
+    rx.nchunks = 0;
+    for (i = nbatch; i < total; i++) {
+        if (rx.nchunks && rx.chunks[rx.nchunks - 1].ns == rx.msgs[i].read_ns) {
+            rx.chunks[rx.nchunks - 1].end += rx.msgs[i].len;
+        } else {
+            rx.chunks[rx.nchunks].end = (rx.nchunks ? rx.chunks[rx.nchunks - 1].end : 0) +
+                                        rx.msgs[i].len;
+            rx.chunks[rx.nchunks++].ns = rx.msgs[i].read_ns;
+        }
+    }
+    if (held) {
+        memmove(in, in + len - held, held);
+        rx.held_deadline = rx.rx_ns + rx.move_window_ns;
+    }
+    rx.held_len = held;
+    return ret;
+}
+
+/*
+ * Replaces nl_recv() on the cache manager socket: drains everything queued
+ * on the socket into one batch and hands it to libnl in lane order.
+ */
+static int rx_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+                   unsigned char **buf, struct ucred **creds)
+{
+    size_t len = rx.held_len;
+    size_t hold_from;
+    ssize_t n;
+    int ret;
+
+    rx.in_msg = 0;
+    mem_domain(MEM_RX);
+    if (rx.in_batch) {
+        rx.in_batch = 0;
+        if (rx.batch_done)
+            rx.batch_done(rx.batch_arg);
+    }
+
+    if (rx.pending_err) {
+        n = rx.pending_err;
+        rx.pending_err = 0;
+        return n;
+    }
+
+    while (rx.source && !rx.source_end && len < RX_BATCH_MAX) {
+        const void *data;
+
+        n = rx.source(&data);
+        if (n <= 0) {
+            rx.source_end = n < 0;
+            break;
+        }
+        if (grow((void **)&rx.buf, &rx.cap, len + n + RX_HEADROOM, 1) < 0)
+            return -NLE_NOMEM;
+        memcpy(rx.buf + len, data, n);
+        len += NLMSG_ALIGN(n);
+        if (grow((void **)&rx.chunks, &rx.chunks_cap, rx.nchunks + 1, sizeof(*rx.chunks)) < 0)
+            return -NLE_NOMEM;
+        rx.chunks[rx.nchunks].end = len;
+        rx.chunks[rx.nchunks++].ns = now_ns();
+    }
+
+    while (!rx.source && len < RX_BATCH_MAX) {
+        struct iovec iov;
+        struct msghdr msg = {
+            .msg_name = nla,
+            .msg_namelen = sizeof(*nla),
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+        };
+
+        if (grow((void **)&rx.buf, &rx.cap, len + RX_HEADROOM, 1) < 0)
+            return -NLE_NOMEM;
+        iov.iov_base = rx.buf + len;
+        iov.iov_len = rx.cap - len;
+
+        n = recvmsg(nl_socket_get_fd(sk), &msg, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            /* Hand over what was read, report the error on the next call */
+            if (len) {
+                rx.pending_err = -nl_syserr2nlerr(errno);
+                break;
+            }
+            return -nl_syserr2nlerr(errno);
+        }
+        if (msg.msg_flags & MSG_TRUNC)
+            return -NLE_MSG_TRUNC;
+        if (n == 0)
+            break;
+        capture_packet(rx.buf + len, n, rx.batches + 1);
+        len += NLMSG_ALIGN(n);
+        if (grow((void **)&rx.chunks, &rx.chunks_cap, rx.nchunks + 1, sizeof(*rx.chunks)) < 0)
+            return -NLE_NOMEM;
+        rx.chunks[rx.nchunks].end = len;
+        rx.chunks[rx.nchunks++].ns = now_ns();
+    }
+
+    hold_from = rx.held_len;
+    if (len == rx.held_len) {
+        /* Nothing more is coming from a source that ended */
+        if (!rx.held_len || (!rx.source_end && now_ns() < rx.held_deadline))
+            return 0;
+        hold_from = len;
+    }
+
+    rx.rx_ns = now_ns();
+    rx.batches++;
+    ret = reorder(rx.buf, len, hold_from, buf);
+    if (ret > 0)
+        rx.in_batch = 1;
+    return ret;
+}
+
+static int rx_msg_in(struct nl_msg *msg, void *arg)
+{
+    struct rx_slot *slot;
+    struct lane_stats *ls;
+    uint64_t wait;
+
+    mem_domain(mem_msg_domain(nlmsg_hdr(msg)->nlmsg_type));
+    if (rx.cursor >= rx.nmsgs)
+        return NL_OK;
+
+    slot = &rx.order[rx.cursor++];
+    ls = &rx.lanes[slot->lane];
+    rx.cur.read_ns = slot->read_ns;
+    rx.cur.in_ns = now_ns();
+    rx.in_msg = 1;
+    wait = rx.cur.in_ns - slot->read_ns;
+    lat_record(LAT_LANE, wait);
+    ls->msgs++;
+    ls->wait_ns += wait;
+    if (wait > ls->max_wait_ns)
+        ls->max_wait_ns = wait;
+    return NL_OK;
+}
+
+int rx_install(struct nl_sock *sk, void (*batch_done)(void *), void *arg)
+{
+    struct nl_cb *cb = nl_socket_get_cb(sk);
+    int err;
+
+    if (!cb)
+        return -NLE_NOMEM;
+
+    rx.batch_done = batch_done;
+    rx.batch_arg = arg;
+    nl_cb_overwrite_recv(cb, rx_recv);
+    err = nl_cb_set(cb, NL_CB_MSG_IN, NL_CB_CUSTOM, rx_msg_in, NULL);
+    nl_cb_put(cb);
+    return err;
+}
+
+void rx_report(FILE *f)
+{
+    int i;
+
+    fprintf(f, "Receive batches: %llu demoted: %llu paired: %llu\n",
+            (unsigned long long)rx.batches, (unsigned long long)rx.demoted,
+            (unsigned long long)rx.paired);
+    for (i = 0; i < LANE_MAX; i++) {
+        struct lane_stats *ls = &rx.lanes[i];
+
+        fprintf(f, "Lane %s: messages: %llu wait avg: %llu us max: %llu us\n",
+                lane_names[i], (unsigned long long)ls->msgs,
+                (unsigned long long)(ls->msgs ? ls->wait_ns / ls->msgs / 1000 : 0),
+                (unsigned long long)(ls->max_wait_ns / 1000));
+    }
+}
+
+void rx_metrics(struct metrics_writer *w, void *data)
+{
+    char labels[32];
+    int i;
+
+    metrics_put(w, "rmon_rx_batches_total", "counter", "Netlink receive batches.", NULL,
+                rx.batches);
+    for (i = 0; i < LANE_MAX; i++) {
+        snprintf(labels, sizeof(labels), "lane=\"%s\"", lane_names[i]);
+        metrics_put(w, "rmon_rx_messages_total", "counter", "Netlink messages by lane.",
+                    labels, rx.lanes[i].msgs);
+    }
+    for (i = 0; i < LANE_MAX; i++) {
+        snprintf(labels, sizeof(labels), "lane=\"%s\"", lane_names[i]);
+        metrics_put(w, "rmon_rx_wait_seconds_total", "counter",
+                    "Time messages waited in their lane.", labels, rx.lanes[i].wait_ns / 1e9);
+    }
+}
+
+void rx_set_move_window(unsigned int usec)
+{
+    rx.move_window_ns = (uint64_t)usec * 1000;
+}
+
+/*
+ * Takes messages from source instead of the socket. It returns 0 where a
+ * read would find the socket drained, and -1 once it has nothing left.
+ */
+void rx_set_source(ssize_t (*source)(const void **data))
+{
+    rx.source = source;
+    rx.source_end = 0;
+}
+
+/* The source ended and everything it gave was handed on */
+int rx_drained(void)
+{
+    return rx.source_end && !rx.held_len;
+}
+
+const struct rx_stamp *rx_stamp(void)
+{
+    return rx.in_msg ? &rx.cur : NULL;
+}
+
+int rx_move_pending(uint64_t key)
+{
+    struct rx_key *k;
+
+    if (!rx.in_batch)
+        return 0;
+    k = key_find(key);
+    return k && k->paired;
+}
+
+int rx_timeout(void)
+{
+    uint64_t now;
+
+    if (!rx.held_len)
+        return -1;
+    now = now_ns();
+    if (now >= rx.held_deadline)
+        return 0;
+    return (rx.held_deadline - now + 999999) / 1000000;
+}
@@ -0,0 +1,72 @@
+/*
+ * Route monitor - netlink receive path
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_RX_H
+#define RMON_RX_H
+
+#include <netlink/netlink.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Every batch drained from the event socket is reordered so that link and
+ * address messages are handed to libnl first, then route deletions, then
+ * route additions and changes. Messages sharing a key never overtake each
+ * other.
+ */
+enum rmon_lane {
+    LANE_LINK,
+    LANE_ROUTE_DEL,
+    LANE_ROUTE,
+    LANE_MAX
+};
+
+struct metrics_writer;
+
+/*
+ * Messages are parsed in the memory domain of their cache, which the
+ * thread is still in when a receive returns; callers switch back.
+ */
+int rx_install(struct nl_sock *sk, void (*batch_done)(void *), void *arg);
+void rx_set_source(ssize_t (*source)(const void **data));
+int rx_drained(void);
+void rx_report(FILE *f);
+void rx_metrics(struct metrics_writer *w, void *data);
+
+/*
+ * Route keys deleted and re-added within one batch are reported by
+ * rx_move_pending() while that batch is being processed. A non-zero move
+ * window also holds trailing deletions back for up to that long waiting for
+ * their re-addition; rx_timeout() returns the poll timeout in milliseconds
+ * (-1 if nothing is held) after which the socket must be read again.
+ */
+void rx_set_move_window(unsigned int usec);
+int rx_move_pending(uint64_t key);
+int rx_timeout(void);
+
+/*
+ * Monotonic times the netlink message being handled was read off the
+ * socket and handed to libnl, NULL outside of one.
+ */
+struct rx_stamp {
+    uint64_t read_ns;
+    uint64_t in_ns;
+};
+
+const struct rx_stamp *rx_stamp(void);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Route monitor - startup phases
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "format.h"
+#include "startup.h"
+
+static struct {
+    uint64_t start;
+    uint64_t mark;
+    uint64_t ready;             /* time ready, 0 before */
+    uint32_t done;              /* phases timed */
+    int sent;
+    struct rmon_rec_startup rec;
+} startup;
+
+void startup_init(void)
+{
+    startup.start = startup.mark = metrics_now();
+}
+
+void startup_mark(void)
+{
+    startup.mark = metrics_now();
+}
+
+void startup_phase(enum rmon_startup_phase phase, uint64_t objects)
+{
+    uint64_t now = metrics_now();
+
+    startup.rec.phase[phase].ns = now - startup.mark;
+    startup.rec.phase[phase].objects = objects;
+    startup.done |= 1u << phase;
+    startup.mark = now;
+}
+
+void startup_ready(void)
+{
+    startup.ready = metrics_now();
+    startup.rec.ready_ns = startup.ready - startup.start;
+}
+
+int startup_event(struct rmon_event *ev)
+{
+    if (!startup.ready || startup.sent)
+        return 0;
+    startup.mark = startup.ready;
+    startup_phase(RMON_STARTUP_FIRST_EVENT, 0);
+    startup.sent = 1;
+    event_startup(ev, &startup.rec);
+    return 1;
+}
+
+void startup_metrics(struct metrics_writer *w, void *data)
+{
+    char labels[32];
+    int i;
+
+    if (startup.ready)
+        metrics_put(w, "rmon_startup_ready_seconds", "gauge",
+                    "Time from start until subscribed to all caches.", NULL,
+                    startup.rec.ready_ns / 1e9);
+    for (i = 0; i < RMON_STARTUP_PHASES; i++) {
+        if (!(startup.done & (1u << i)))
+            continue;
+        snprintf(labels, sizeof(labels), "phase=\"%s\"", rmon_startup_phase_name(i));
+        metrics_put(w, "rmon_startup_phase_seconds", "gauge", "Duration of a startup phase.",
+                    labels, startup.rec.phase[i].ns / 1e9);
+    }
+    for (i = 0; i < RMON_STARTUP_PHASES; i++) {
+        if (!(startup.done & (1u << i)))
+            continue;
+        snprintf(labels, sizeof(labels), "phase=\"%s\"", rmon_startup_phase_name(i));
+        metrics_put(w, "rmon_startup_phase_objects", "gauge",
+                    "Objects loaded by a startup phase.", labels, startup.rec.phase[i].objects);
+    }
+}
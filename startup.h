@@ -0,0 +1,41 @@
+/*
+ * Route monitor - startup phases
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_STARTUP_H
+#define RMON_STARTUP_H
+
+#include <stdint.h>
+
+#include "event.h"
+#include "metrics.h"
+
+/*
+ * Startup is timed on CLOCK_MONOTONIC phase by phase. A phase lasts from
+ * the last mark, which the end of the previous phase also sets, so work
+ * between phases isn't charged to either.
+ */
+void startup_init(void);
+void startup_mark(void);
+void startup_phase(enum rmon_startup_phase phase, uint64_t objects);
+void startup_ready(void);
+
+/* Builds the startup record at the first event after ready, 0 otherwise */
+int startup_event(struct rmon_event *ev);
+
+void startup_metrics(struct metrics_writer *w, void *data);
+
+#endif
@@ -0,0 +1,841 @@
+/*
+ * Route monitor - subscription server
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <netlink/errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "event.h"
+#include "format.h"
+#include "mem.h"
+#include "metrics.h"
+#include "sub.h"
+
+#define SUB_MAX_IFINDEX     16
+#define SUB_LINE_MAX        512
+#define SUB_TEXT_MAX        1024
+#define SUB_NOTICE_MAX      64      /* longest "dropped" notice in any format */
+
+#define TYPES_ROUTE     ((1u << RMON_REC_ROUTE_ADD) | (1u << RMON_REC_ROUTE_DEL) | \
+                         (1u << RMON_REC_ROUTE_CHANGE) | (1u << RMON_REC_ROUTE_MOVE) | \
+                         (1u << RMON_REC_ROUTE_INVALIDATE) | (1u << RMON_REC_ROUTE_DAMPED) | \
+                         (1u << RMON_REC_ROUTE_REUSABLE))
+#define TYPES_LINK      ((1u << RMON_REC_LINK_ADD) | (1u << RMON_REC_LINK_DEL) | \
+                         (1u << RMON_REC_LINK_CHANGE))
+#define TYPES_ADDR      ((1u << RMON_REC_ADDR_DEL) | (1u << RMON_REC_ADDR_ADD))
+
+_Static_assert(RMON_REC_MAX <= 32, "record types do not fit the filter mask");
+
+static const char *type_names[RMON_REC_MAX] = {
+    [RMON_REC_ROUTE_ADD] = "route-add",
+    [RMON_REC_ROUTE_DEL] = "route-del",
+    [RMON_REC_ROUTE_CHANGE] = "route-change",
+    [RMON_REC_ROUTE_MOVE] = "route-move",
+    [RMON_REC_ROUTE_INVALIDATE] = "route-invalidate",
+    [RMON_REC_ROUTE_DAMPED] = "route-damped",
+    [RMON_REC_ROUTE_REUSABLE] = "route-reusable",
+    [RMON_REC_LINK_ADD] = "link-add",
+    [RMON_REC_LINK_DEL] = "link-del",
+    [RMON_REC_LINK_CHANGE] = "link-change",
+    [RMON_REC_ADDR_DEL] = "addr-del",
+    [RMON_REC_ADDR_ADD] = "addr-add",
+    [RMON_REC_STARTUP] = "startup",
+};
+
+struct sub_filter {
+    uint32_t types;
+    int nifindex;
+    int32_t ifindex[SUB_MAX_IFINDEX];
+    int has_prefix;
+    uint8_t family;
+    uint8_t plen;
+    uint8_t ge;
+    uint8_t le;
+    uint8_t prefix[16];
+    int has_table;
+    uint32_t table;
+};
+
+enum sub_snapshot {
+    SNAPSHOT_NONE,
+    SNAPSHOT_LIVE,      /* snapshot, then the live stream */
+    SNAPSHOT_ONLY,      /* snapshot, then close */
+};
+
+struct sub_client {
+    int fd;
+    int subscribed;
+    int binary;
+    struct sub_filter filter;
+    char *snap;         /* pending snapshot, sent ahead of the queue */
+    size_t snap_off;
+    size_t snap_len;
+    size_t snap_cap;
+    int snap_close;
+    char *q;
+    size_t qstart;
+    size_t qend;
+    size_t high;
+    char in[SUB_LINE_MAX];
+    size_t inlen;
+    uint64_t delivered;
+    uint64_t dropped;
+    uint64_t pending_drops;
+    uint64_t drop_first_seq;
+};
+
+static struct {
+    int listen_fd;
+    const char *path;
+    size_t queue;
+    sub_snapshot_fn snapshot;
+    void *snapshot_data;
+    struct sub_client clients[SUB_MAX_CLIENTS];
+    uint64_t filtered;
+    uint64_t delivered;
+    uint64_t dropped;
+    uint64_t connects;
+    uint64_t rejected;
+    uint64_t snapshots;
+    uint64_t snapshot_records;
+    uint64_t snapshots_oversized;
+} sub = {
+    .listen_fd = -1,
+};
+
+/* Provides the current state for snapshot requests */
+void sub_set_snapshot(sub_snapshot_fn fn, void *data)
+{
+    sub.snapshot = fn;
+    sub.snapshot_data = data;
+}
+
+int sub_init(const char *path, size_t queue)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int i, err;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -NLE_INVAL;
+    strcpy(addr.sun_path, path);
+
+    sub.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sub.listen_fd < 0)
+        return -nl_syserr2nlerr(errno);
+
+    unlink(path);
+    if (bind(sub.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(sub.listen_fd, 16) < 0) {
+        err = errno;
+        close(sub.listen_fd);
+        sub.listen_fd = -1;
+        return -nl_syserr2nlerr(err);
+    }
+
+    for (i = 0; i < SUB_MAX_CLIENTS; i++)
+        sub.clients[i].fd = -1;
+    sub.path = path;
+    sub.queue = queue;
+    return 0;
+}
+
+static int match_prefix(const struct sub_filter *f, const struct rmon_rec_route *r)
+{
+    unsigned int bytes = f->plen / 8;
+    unsigned int bits = f->plen % 8;
+
+    if (r->family != f->family || r->dst_len < f->plen)
+        return 0;
+    if (r->dst_len < f->ge || r->dst_len > f->le)
+        return 0;
+    if (memcmp(r->dst, f->prefix, bytes))
+        return 0;
+    return !bits || !((r->dst[bytes] ^ f->prefix[bytes]) & (0xff << (8 - bits)));
+}
+
+static int match_ifindex(const struct sub_filter *f, int32_t ifindex)
+{
+    int i;
+
+    for (i = 0; i < f->nifindex; i++) {
+        if (f->ifindex[i] == ifindex)
+            return 1;
+    }
+    return 0;
+}
+
+/* Damped/reusable notes carry no nexthops and are not held to an ifindex set */
+static int match(const struct sub_filter *f, const struct rmon_rec_hdr *rec)
+{
+    const struct rmon_rec_nh *nh;
+    const struct rmon_rec_route *r;
+    int i;
+
+    if (rec->type >= RMON_REC_MAX || !(f->types & (1u << rec->type)))
+        return 0;
+
+    if (rmon_rec_is_route(rec)) {
+        r = rmon_rec_body(rec);
+        if (f->has_table && r->table != f->table)
+            return 0;
+        if (f->has_prefix && !match_prefix(f, r))
+            return 0;
+        if (!f->nifindex || rec->type == RMON_REC_ROUTE_DAMPED ||
+            rec->type == RMON_REC_ROUTE_REUSABLE)
+            return 1;
+        nh = rmon_rec_nexthops(rec);
+        for (i = 0; i < r->nnh + r->old_nnh; i++) {
+            if (match_ifindex(f, nh[i].ifindex))
+                return 1;
+        }
+        return 0;
+    }
+
+    if (!f->nifindex)
+        return 1;
+    if (rmon_rec_is_link(rec))
+        return match_ifindex(f, ((const struct rmon_rec_link *)rmon_rec_body(rec))->ifindex);
+    if (rmon_rec_is_addr(rec))
+        return match_ifindex(f, ((const struct rmon_rec_addr *)rmon_rec_body(rec))->ifindex);
+    return 1;
+}
+
+static const char *parse_types(struct sub_filter *f, char *val)
+{
+    char *name, *save;
+    int t;
+
+    f->types = 0;
+    for (name = strtok_r(val, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        if (!strcmp(name, "route")) {
+            f->types |= TYPES_ROUTE;
+            continue;
+        }
+        if (!strcmp(name, "link")) {
+            f->types |= TYPES_LINK;
+            continue;
+        }
+        if (!strcmp(name, "addr")) {
+            f->types |= TYPES_ADDR;
+            continue;
+        }
+        for (t = 0; t < RMON_REC_MAX; t++) {
+            if (type_names[t] && !strcmp(name, type_names[t]))
+                break;
+        }
+        if (t == RMON_REC_MAX)
+            return "unknown type";
+        f->types |= 1u << t;
+    }
+    return NULL;
+}
+
+static const char *parse_ifindex(struct sub_filter *f, char *val)
+{
+    char *tok, *save, *end;
+
+    f->nifindex = 0;
+    for (tok = strtok_r(val, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (f->nifindex == SUB_MAX_IFINDEX)
+            return "too many interfaces";
+        f->ifindex[f->nifindex++] = strtol(tok, &end, 0);
+        if (*end || end == tok)
+            return "invalid ifindex";
+    }
+    return NULL;
+}
+
+static const char *parse_prefix(struct sub_filter *f, char *val)
+{
+    char *slash = strchr(val, '/');
+    unsigned long plen;
+    char *end;
+
+    if (slash)
+        *slash = '\0';
+    if (inet_pton(AF_INET, val, f->prefix) == 1)
+        f->family = AF_INET;
+    else if (inet_pton(AF_INET6, val, f->prefix) == 1)
+        f->family = AF_INET6;
+    else
+        return "invalid prefix";
+
+    plen = f->family == AF_INET ? 32 : 128;
+    if (slash) {
+        plen = strtoul(slash + 1, &end, 10);
+        if (*end || end == slash + 1 || plen > (f->family == AF_INET ? 32u : 128u))
+            return "invalid prefix length";
+    }
+    f->plen = plen;
+    f->has_prefix = 1;
+    return NULL;
+}
+
+static const char *parse_filter(struct sub_filter *f, int *binary, enum sub_snapshot *snapshot,
+                                char *line)
+{
+    unsigned long ge = 0, le = 128, val;
+    char *tok, *save, *arg, *end;
+    const char *err = NULL;
+
+    memset(f, 0, sizeof(*f));
+    f->types = TYPES_ROUTE | TYPES_LINK | TYPES_ADDR;
+    *binary = 0;
+    *snapshot = SNAPSHOT_NONE;
+
+    for (tok = strtok_r(line, " \t", &save); tok && !err; tok = strtok_r(NULL, " \t", &save)) {
+        arg = strchr(tok, '=');
+        if (!arg)
+            return "expected key=value";
+        *arg++ = '\0';
+
+        if (!strcmp(tok, "types")) {
+            err = parse_types(f, arg);
+        } else if (!strcmp(tok, "ifindex")) {
+            err = parse_ifindex(f, arg);
+        } else if (!strcmp(tok, "prefix")) {
+            err = parse_prefix(f, arg);
+        } else if (!strcmp(tok, "snapshot")) {
+            if (!strcmp(arg, "yes"))
+                *snapshot = SNAPSHOT_LIVE;
+            else if (!strcmp(arg, "only"))
+                *snapshot = SNAPSHOT_ONLY;
+            else if (strcmp(arg, "no"))
+                err = "unknown snapshot mode";
+        } else if (!strcmp(tok, "format")) {
+            if (!strcmp(arg, "binary"))
+                *binary = 1;
+            else if (strcmp(arg, "text"))
+                err = "unknown format";
+        } else if (!strcmp(tok, "ge") || !strcmp(tok, "le") || !strcmp(tok, "table")) {
+            val = strtoul(arg, &end, 0);
+            if (*end || end == arg)
+                return "invalid number";
+            if (tok[0] == 't') {
+                f->table = val;
+                f->has_table = 1;
+            } else if (tok[0] == 'g') {
+                ge = val;
+            } else {
+                le = val;
+            }
+        } else {
+            err = "unknown key";
+        }
+    }
+    if (err)
+        return err;
+
+    if (ge > 128 || le > 128 || ge > le)
+        return "invalid ge/le";
+    f->ge = ge;
+    f->le = le;
+    return NULL;
+}
+
+static void drop_client(struct sub_client *c)
+{
+    close(c->fd);
+    free(c->snap);
+    free(c->q);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+/* Reserves len bytes at the end of the queue, NULL if they don't fit */
+static char *queue_reserve(struct sub_client *c, size_t len)
+{
+    if (c->qend + len > sub.queue && c->qstart) {
+        memmove(c->q, c->q + c->qstart, c->qend - c->qstart);
+        c->qend -= c->qstart;
+        c->qstart = 0;
+    }
+    if (c->qend + len > sub.queue)
+        return NULL;
+    return c->q + c->qend;
+}
+
+static void queue_commit(struct sub_client *c, size_t len)
+{
+    c->qend += len;
+    if (c->qend - c->qstart > c->high)
+        c->high = c->qend - c->qstart;
+}
+
+static int queue_record(struct sub_client *c, const struct rmon_rec_hdr *rec,
+                        const char *text, int text_len)
+{
+    char buf[SUB_TEXT_MAX];
+    size_t len;
+    char *p;
+
+    if (c->binary) {
+        len = rec->len;
+    } else if (text) {
+        len = text_len;
+    } else {
+        len = rmon_format_text(rec, buf, sizeof(buf));
+        if (len >= sizeof(buf))
+            len = sizeof(buf) - 1;
+        text = buf;
+    }
+
+    p = queue_reserve(c, len);
+    if (!p)
+        return -1;
+    memcpy(p, c->binary ? (const char *)rec : text, len);
+    queue_commit(c, len);
+    return 0;
+}
+
+/*
+ * Tells the subscriber about dropped events first. The notice only goes out
+ * together with the event, so a nearly full queue doesn't collect notices.
+ */
+static int queue_event(struct sub_client *c, const struct rmon_rec_hdr *rec,
+                       const char *text, int text_len)
+{
+    struct rmon_event ev;
+
+    if (c->pending_drops) {
+        event_dropped(&ev, c->pending_drops, c->drop_first_seq);
+        if (!queue_reserve(c, SUB_NOTICE_MAX + (c->binary ? rec->len : text_len)) ||
+            queue_record(c, &ev.hdr, NULL, 0) < 0)
+            goto drop;
+        c->pending_drops = 0;
+    }
+    if (queue_record(c, rec, text, text_len) == 0) {
+        c->delivered++;
+        sub.delivered++;
+        return 0;
+    }
+
+drop:
+    if (!c->pending_drops++)
+        c->drop_first_seq = rec->seq;
+    c->dropped++;
+    sub.dropped++;
+    return -1;
+}
+
+void sub_publish(const struct rmon_rec_hdr *rec)
+{
+    char text[SUB_TEXT_MAX];
+    int text_len = -1;
+    struct sub_client *c;
+    int i;
+
+    if (sub.listen_fd < 0)
+        return;
+
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        c = &sub.clients[i];
+        if (c->fd < 0 || !c->subscribed)
+            continue;
+        if (!match(&c->filter, rec)) {
+            sub.filtered++;
+            continue;
+        }
+        /* Text is rendered once per event, for the first subscriber that wants it */
+        if (!c->binary && text_len < 0) {
+            text_len = rmon_format_text(rec, text, sizeof(text));
+            if (text_len >= (int)sizeof(text))
+                text_len = sizeof(text) - 1;
+        }
+        queue_event(c, rec, text, text_len);
+    }
+}
+
+static int send_snapshot(struct sub_client *c)
+{
+    ssize_t n;
+
+    while (c->snap_off < c->snap_len) {
+        n = send(c->fd, c->snap + c->snap_off, c->snap_len - c->snap_off,
+                 MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                drop_client(c);
+            return -1;
+        }
+        c->snap_off += n;
+    }
+
+    free(c->snap);
+    c->snap = NULL;
+    c->snap_off = c->snap_len = c->snap_cap = 0;
+    if (c->snap_close) {
+        drop_client(c);
+        return -1;
+    }
+    return 0;
+}
+
+static void send_queue(struct sub_client *c)
+{
+    ssize_t n;
+
+    if (c->snap && send_snapshot(c) < 0)
+        return;
+
+    while (c->qstart < c->qend) {
+        n = send(c->fd, c->q + c->qstart, c->qend - c->qstart, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                drop_client(c);
+            return;
+        }
+        c->qstart += n;
+    }
+    c->qstart = c->qend = 0;
+}
+
+void sub_flush(void)
+{
+    int i;
+
+    if (sub.listen_fd < 0)
+        return;
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        if (sub.clients[i].fd >= 0 &&
+            (sub.clients[i].snap || sub.clients[i].qend > sub.clients[i].qstart))
+            send_queue(&sub.clients[i]);
+    }
+}
+
+static void accept_client(void)
+{
+    struct sub_client *c = NULL;
+    int fd, i;
+
+    fd = accept4(sub.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        if (sub.clients[i].fd < 0) {
+            c = &sub.clients[i];
+            break;
+        }
+    }
+    if (c)
+        c->q = mem_malloc(MEM_SUB, sub.queue);
+    if (!c || !c->q) {
+        sub.rejected++;
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    sub.connects++;
+}
+
+/* Snapshots are held to the queue limit too, -NLE_MSGSIZE beyond it */
+static int snap_append(struct sub_client *c, const struct rmon_rec_hdr *rec)
+{
+    size_t cap;
+    char *snap;
+    int len;
+
+    for (;;) {
+        if (c->binary) {
+            len = rec->len;
+            if (c->snap_len + len <= c->snap_cap) {
+                memcpy(c->snap + c->snap_len, rec, len);
+                break;
+            }
+        } else {
+            len = rmon_format_text(rec, c->snap + c->snap_len, c->snap_cap - c->snap_len);
+            if (c->snap_len + len < c->snap_cap)
+                break;
+        }
+
+        if (c->snap_cap >= sub.queue)
+            return -NLE_MSGSIZE;
+        cap = c->snap_cap ? 2 * c->snap_cap : 64 * 1024;
+        if (cap > sub.queue)
+            cap = sub.queue;
+        snap = mem_realloc(MEM_SUB, c->snap, cap);
+        if (!snap)
+            return -NLE_NOMEM;
+        c->snap = snap;
+        c->snap_cap = cap;
+    }
+    c->snap_len += len;
+    return 0;
+}
+
+struct snapshot_ctx {
+    struct sub_client *c;
+    uint64_t records;
+    int err;
+};
+
+static void snapshot_put(const struct rmon_rec_hdr *rec, void *arg)
+{
+    struct snapshot_ctx *ctx = arg;
+
+    if (ctx->err || !match(&ctx->c->filter, rec))
+        return;
+    ctx->err = snap_append(ctx->c, rec);
+    ctx->records++;
+}
+
+/*
+ * The snapshot is rendered in one go between two netlink batches, so it
+ * is consistent with the last event stamped so far. It goes out before
+ * anything queued later.
+ */
+static int build_snapshot(struct sub_client *c)
+{
+    struct snapshot_ctx ctx = { .c = c };
+    uint64_t seq = event_last_seq();
+    struct rmon_event ev;
+    int err;
+
+    event_snapshot(&ev, RMON_REC_SNAPSHOT_BEGIN, seq, 0);
+    if ((err = snap_append(c, &ev.hdr)) < 0)
+        return err;
+    sub.snapshot(snapshot_put, &ctx, sub.snapshot_data);
+    if (ctx.err)
+        return ctx.err;
+    event_snapshot(&ev, RMON_REC_SNAPSHOT_END, seq, ctx.records);
+    if ((err = snap_append(c, &ev.hdr)) < 0)
+        return err;
+
+    sub.snapshots++;
+    sub.snapshot_records += ctx.records;
+    return 0;
+}
+
+static void reject(struct sub_client *c, const char *err)
+{
+    char msg[64];
+
+    snprintf(msg, sizeof(msg), "Error: %s\n", err);
+    send(c->fd, msg, strlen(msg), MSG_DONTWAIT | MSG_NOSIGNAL);
+    drop_client(c);
+}
+
+static void subscribe(struct sub_client *c, char *line)
+{
+    enum sub_snapshot snapshot;
+    struct sub_filter filter;
+    struct rmon_event ev;
+    const char *err;
+    int stream;
+    int binary;
+    int ret = 0;
+
+    err = parse_filter(&filter, &binary, &snapshot, line);
+    if (!err && snapshot != SNAPSHOT_NONE && (c->subscribed || c->snap || !sub.snapshot))
+        err = "snapshot only with the first filter";
+    if (err) {
+        reject(c, err);
+        return;
+    }
+
+    /* Binary streams open with a stream record, also when switching to binary */
+    stream = binary && (!c->subscribed || !c->binary);
+    c->binary = binary;
+    c->filter = filter;
+
+    if (snapshot != SNAPSHOT_NONE) {
+        if (stream)
+            event_stream(&ev);
+        if (stream)
+            ret = snap_append(c, &ev.hdr);
+        if (!ret)
+            ret = build_snapshot(c);
+        if (ret == -NLE_MSGSIZE) {
+            sub.snapshots_oversized++;
+            reject(c, "snapshot exceeds the queue limit");
+            return;
+        }
+        if (ret < 0) {
+            reject(c, "out of memory");
+            return;
+        }
+        c->snap_close = snapshot == SNAPSHOT_ONLY;
+        c->subscribed = snapshot == SNAPSHOT_LIVE;
+        return;
+    }
+
+    if (stream) {
+        event_stream(&ev);
+        if (queue_record(c, &ev.hdr, NULL, 0) < 0) {
+            reject(c, "queue full");
+            return;
+        }
+    }
+    c->subscribed = 1;
+}
+
+static void read_filter(struct sub_client *c)
+{
+    char *nl;
+    ssize_t n;
+
+    n = recv(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n <= 0) {
+        drop_client(c);
+        return;
+    }
+    c->inlen += n;
+
+    while (c->fd >= 0 && (nl = memchr(c->in, '\n', c->inlen))) {
+        *nl = '\0';
+        if (nl > c->in && nl[-1] == '\r')
+            nl[-1] = '\0';
+        subscribe(c, c->in);
+        if (c->fd < 0)
+            return;
+        c->inlen -= nl + 1 - c->in;
+        memmove(c->in, nl + 1, c->inlen);
+    }
+    if (c->inlen == sizeof(c->in))
+        drop_client(c);
+}
+
+int sub_pollfds(struct pollfd *pfd)
+{
+    struct sub_client *c;
+    int i, n = 0;
+
+    if (sub.listen_fd < 0)
+        return 0;
+
+    pfd[n].fd = sub.listen_fd;
+    pfd[n].events = POLLIN;
+    pfd[n++].revents = 0;
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        c = &sub.clients[i];
+        pfd[n].fd = c->fd;
+        pfd[n].events = POLLIN | (c->snap || c->qend > c->qstart ? POLLOUT : 0);
+        pfd[n++].revents = 0;
+    }
+    return n;
+}
+
+void sub_handle(const struct pollfd *pfd, int n)
+{
+    struct sub_client *c;
+    int i;
+
+    if (!n)
+        return;
+    for (i = 1; i < n; i++) {
+        c = &sub.clients[i - 1];
+        if (pfd[i].fd < 0 || c->fd != pfd[i].fd)
+            continue;
+        if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR))
+            read_filter(c);
+        if (c->fd >= 0 && (pfd[i].revents & POLLOUT))
+            send_queue(c);
+    }
+    if (pfd[0].revents & POLLIN)
+        accept_client();
+}
+
+void sub_report(FILE *f)
+{
+    struct sub_client *c;
+    int i, clients = 0;
+
+    if (sub.listen_fd < 0)
+        return;
+
+    for (i = 0; i < SUB_MAX_CLIENTS; i++)
+        clients += sub.clients[i].fd >= 0;
+    fprintf(f, "Subscribers: clients: %d delivered: %llu filtered: %llu dropped: %llu "
+            "connects: %llu rejected: %llu snapshots: %llu snapshot records: %llu "
+            "snapshots oversized: %llu\n", clients,
+            (unsigned long long)sub.delivered, (unsigned long long)sub.filtered,
+            (unsigned long long)sub.dropped, (unsigned long long)sub.connects,
+            (unsigned long long)sub.rejected, (unsigned long long)sub.snapshots,
+            (unsigned long long)sub.snapshot_records,
+            (unsigned long long)sub.snapshots_oversized);
+
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        c = &sub.clients[i];
+        if (c->fd < 0)
+            continue;
+        fprintf(f, "Subscriber %d: delivered: %llu dropped: %llu queued: %zu bytes "
+                "max queued: %zu bytes\n", i, (unsigned long long)c->delivered,
+                (unsigned long long)c->dropped, c->qend - c->qstart, c->high);
+    }
+}
+
+void sub_metrics(struct metrics_writer *w, void *data)
+{
+    struct sub_client *c;
+    size_t queued = 0;
+    int i, clients = 0;
+
+    if (sub.listen_fd < 0)
+        return;
+
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        c = &sub.clients[i];
+        if (c->fd < 0)
+            continue;
+        clients++;
+        queued += c->qend - c->qstart;
+    }
+    metrics_put(w, "rmon_subscribers", "gauge", "Connected subscribers.", NULL, clients);
+    metrics_put(w, "rmon_subscriber_queued_bytes", "gauge",
+                "Bytes queued for all subscribers.", NULL, queued);
+    metrics_put(w, "rmon_subscriber_delivered_total", "counter",
+                "Events queued for subscribers.", NULL, sub.delivered);
+    metrics_put(w, "rmon_subscriber_filtered_total", "counter",
+                "Events filtered out for subscribers.", NULL, sub.filtered);
+    metrics_put(w, "rmon_subscriber_dropped_total", "counter",
+                "Events dropped on full subscriber queues.", NULL, sub.dropped);
+    metrics_put(w, "rmon_subscriber_snapshots_oversized_total", "counter",
+                "Snapshots refused for exceeding the queue limit.", NULL,
+                sub.snapshots_oversized);
+}
+
+void sub_close(void)
+{
+    int i;
+
+    if (sub.listen_fd < 0)
+        return;
+    for (i = 0; i < SUB_MAX_CLIENTS; i++) {
+        if (sub.clients[i].fd >= 0) {
+            send_queue(&sub.clients[i]);
+            if (sub.clients[i].fd >= 0)
+                drop_client(&sub.clients[i]);
+        }
+    }
+    close(sub.listen_fd);
+    unlink(sub.path);
+    sub.listen_fd = -1;
+}
@@ -0,0 +1,69 @@
+/*
+ * Route monitor - subscription server
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RMON_SUB_H
+#define RMON_SUB_H
+
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "rmon_proto.h"
+
+/*
+ * Subscribers connect to a Unix stream socket and send a filter line of
+ * space separated key=value pairs, e.g.
+ *
+ *   types=route-add,route-del ifindex=2,3 prefix=10.0.0.0/8 le=24 format=text
+ *
+ * Keys: types (record types or the groups route, link, addr), ifindex,
+ * prefix with optional ge/le bounds on the prefix length, table, format
+ * (text or binary) and snapshot. prefix and table only constrain route
+ * records. An empty line subscribes to everything; a later line replaces
+ * the filter.
+ *
+ * snapshot=yes on the first line sends the matching current state first,
+ * bracketed by snapshot records stamped with the sequence number it is
+ * consistent with, and continues with the live stream right after it.
+ * snapshot=only closes the connection after the snapshot. A snapshot is
+ * held to the queue limit as well; one that would exceed it is refused
+ * with an error and the connection closed.
+ *
+ * Filters run before anything is formatted. Each subscriber has a bounded
+ * queue; when it is full events are dropped and the subscriber gets a
+ * "dropped" record once there is room again, the netlink side never waits.
+ */
+#define SUB_MAX_CLIENTS     32
+#define SUB_POLLFDS         (1 + SUB_MAX_CLIENTS)
+#define SUB_DEFAULT_QUEUE   (256 * 1024)
+
+typedef void (*sub_snapshot_fn)(void (*put)(const struct rmon_rec_hdr *rec, void *arg),
+                                void *arg, void *data);
+
+struct metrics_writer;
+
+int sub_init(const char *path, size_t queue);
+void sub_set_snapshot(sub_snapshot_fn fn, void *data);
+void sub_publish(const struct rmon_rec_hdr *rec);
+void sub_flush(void);
+int sub_pollfds(struct pollfd *pfd);
+void sub_handle(const struct pollfd *pfd, int n);
+void sub_report(FILE *f);
+void sub_metrics(struct metrics_writer *w, void *data);
+void sub_close(void);
+
+#endif
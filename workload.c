@@ -0,0 +1,539 @@
+/*
+ * Route monitor - synthetic rtnetlink workloads
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/if_arp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload.h"
+
+#define MSG_MAX         4096
+#define DUMP_PKT_MAX    (16 * 1024)     /* what a dump read returns at most */
+#define TICK_NS         1000000ULL      /* notifications within it are read together */
+#define LINK_NET        0x64400000      /* 100.64.0.0/10 */
+#define DOWN_NET        0xc6120000      /* 198.18.0.0/15 */
+
+#define LINK_UP         (IFF_UP | IFF_RUNNING | IFF_LOWER_UP | IFF_BROADCAST | IFF_MULTICAST)
+#define LINK_DOWN       (LINK_UP & ~(IFF_UP | IFF_RUNNING | IFF_LOWER_UP))
+
+/*
+ * Prefix lengths of the IPv4 default free zone in parts per thousand,
+ * roughly: six in ten are /24s, most of the rest /19 to /23.
+ */
+static const uint16_t prefix_weights[33] = {
+    [8] = 1, [11] = 1, [12] = 1, [13] = 1, [14] = 2, [15] = 2, [16] = 14, [17] = 8,
+    [18] = 12, [19] = 28, [20] = 35, [21] = 45, [22] = 120, [23] = 80, [24] = 650,
+};
+
+struct route {
+    uint32_t dst;
+    uint8_t len;
+    uint8_t shift;              /* moves the nexthops along on every flap */
+    uint8_t down;
+};
+
+struct pending {
+    uint64_t due;
+    uint32_t route;
+};
+
+struct gen {
+    const struct workload *w;
+    workload_sink sink;
+    void *arg;
+    struct workload_stats *stats;
+    struct route *routes;
+    uint32_t ecmp;
+    uint64_t rng;
+    uint64_t batch;
+    uint64_t tick;
+    uint32_t in_batch;
+    size_t dump_len;
+    unsigned char dump[DUMP_PKT_MAX];
+    unsigned char msg[MSG_MAX];
+};
+
+void workload_defaults(struct workload *w)
+{
+    memset(w, 0, sizeof(*w));
+    w->routes = 10000;
+    w->links = 16;
+    w->ecmp = 1;
+    w->flap_gap_ms = 100;
+    w->duration_ms = 10000;
+    w->batch = 64;
+    w->seed = 1;
+}
+
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t rnd(struct gen *g)
+{
+    return mix(g->rng++);
+}
+
+static struct nlmsghdr *msg_start(struct gen *g, int type, int flags, const void *hdr, size_t len)
+{
+    struct nlmsghdr *nlh = (struct nlmsghdr *)g->msg;
+
+    memset(nlh, 0, NLMSG_SPACE(len));
+    nlh->nlmsg_len = NLMSG_LENGTH(len);
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = flags;
+    memcpy(NLMSG_DATA(nlh), hdr, len);
+    return nlh;
+}
+
+static struct rtattr *put_attr(struct nlmsghdr *nlh, int type, const void *data, size_t len)
+{
+    struct rtattr *rta = (struct rtattr *)((char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+
+    memset(rta, 0, RTA_SPACE(len));
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    if (len)
+        memcpy(RTA_DATA(rta), data, len);
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_SPACE(len);
+    return rta;
+}
+
+static int deliver(struct gen *g, const void *buf, size_t len, uint64_t ts, uint64_t batch)
+{
+    g->stats->packets++;
+    g->stats->bytes += len;
+    return g->sink(g->arg, buf, len, ts, batch);
+}
+
+/* Notifications come one per packet, those of a tick are read together */
+static int notify(struct gen *g, uint64_t ts)
+{
+    struct nlmsghdr *nlh = (struct nlmsghdr *)g->msg;
+    uint64_t tick = ts / TICK_NS;
+
+    if (!g->batch || tick != g->tick || g->in_batch == g->w->batch) {
+        g->batch++;
+        g->tick = tick;
+        g->in_batch = 0;
+        g->stats->batches++;
+    }
+    g->in_batch++;
+    g->stats->messages++;
+    return deliver(g, nlh, nlh->nlmsg_len, ts, g->batch);
+}
+
+static int dump_flush(struct gen *g)
+{
+    int err = 0;
+
+    if (g->dump_len)
+        err = deliver(g, g->dump, g->dump_len, g->w->start_ns, 0);
+    g->dump_len = 0;
+    return err;
+}
+
+/* A dump packs as many messages into a packet as fit */
+static int dump(struct gen *g)
+{
+    struct nlmsghdr *nlh = (struct nlmsghdr *)g->msg;
+    int err;
+
+    nlh->nlmsg_flags |= NLM_F_MULTI;
+    if (g->dump_len + NLMSG_ALIGN(nlh->nlmsg_len) > sizeof(g->dump)) {
+        err = dump_flush(g);
+        if (err < 0)
+            return err;
+    }
+    memcpy(g->dump + g->dump_len, nlh, nlh->nlmsg_len);
+    g->dump_len += NLMSG_ALIGN(nlh->nlmsg_len);
+    g->stats->messages++;
+    return 0;
+}
+
+static uint32_t link_local(uint32_t i)
+{
+    return htonl(LINK_NET + i * 4 + 1);
+}
+
+static uint32_t link_peer(uint32_t i)
+{
+    return htonl(LINK_NET + i * 4 + 2);
+}
+
+static void link_msg(struct gen *g, uint32_t i, int type, unsigned int flags)
+{
+    struct ifinfomsg ifi = {
+        .ifi_family = AF_UNSPEC,
+        .ifi_type = ARPHRD_ETHER,
+        .ifi_index = i + 2,
+        .ifi_flags = flags,
+    };
+    unsigned char lladdr[6] = { 0x02, 0x00, i >> 24, i >> 16, i >> 8, i };
+    uint8_t operstate = flags & IFF_LOWER_UP ? IF_OPER_UP : IF_OPER_DOWN;
+    uint32_t mtu = 1500;
+    struct nlmsghdr *nlh;
+    char name[IFNAMSIZ];
+
+    snprintf(name, sizeof(name), "wl%u", i);
+    nlh = msg_start(g, type, 0, &ifi, sizeof(ifi));
+    put_attr(nlh, IFLA_IFNAME, name, strlen(name) + 1);
+    put_attr(nlh, IFLA_MTU, &mtu, sizeof(mtu));
+    put_attr(nlh, IFLA_OPERSTATE, &operstate, sizeof(operstate));
+    put_attr(nlh, IFLA_ADDRESS, lladdr, sizeof(lladdr));
+}
+
+static void addr_msg(struct gen *g, uint32_t i, int type)
+{
+    struct ifaddrmsg ifa = {
+        .ifa_family = AF_INET,
+        .ifa_prefixlen = 30,
+        .ifa_scope = RT_SCOPE_UNIVERSE,
+        .ifa_index = i + 2,
+    };
+    uint32_t local = link_local(i);
+    struct nlmsghdr *nlh;
+
+    nlh = msg_start(g, type, 0, &ifa, sizeof(ifa));
+    put_attr(nlh, IFA_LOCAL, &local, sizeof(local));
+    put_attr(nlh, IFA_ADDRESS, &local, sizeof(local));
+}
+
+static void route_msg(struct gen *g, uint32_t r, int type, int flags)
+{
+    const struct route *rt = &g->routes[r];
+    struct rtmsg rtm = {
+        .rtm_family = AF_INET,
+        .rtm_dst_len = rt->len,
+        .rtm_table = RT_TABLE_MAIN,
+        .rtm_protocol = RTPROT_BGP,
+        .rtm_scope = RT_SCOPE_UNIVERSE,
+        .rtm_type = RTN_UNICAST,
+    };
+    uint32_t table = RT_TABLE_MAIN, dst = htonl(rt->dst), gw, oif, link, n;
+    struct nlmsghdr *nlh;
+    struct rtattr *mp;
+
+    nlh = msg_start(g, type, flags, &rtm, sizeof(rtm));
+    put_attr(nlh, RTA_TABLE, &table, sizeof(table));
+    if (rt->len)
+        put_attr(nlh, RTA_DST, &dst, sizeof(dst));
+
+    link = (mix(r ^ g->w->seed) + rt->shift) % g->w->links;
+    if (g->ecmp == 1) {
+        gw = link_peer(link);
+        oif = link + 2;
+        put_attr(nlh, RTA_GATEWAY, &gw, sizeof(gw));
+        put_attr(nlh, RTA_OIF, &oif, sizeof(oif));
+        return;
+    }
+
+    mp = put_attr(nlh, RTA_MULTIPATH, NULL, 0);
+    for (n = 0; n < g->ecmp; n++, link = (link + 1) % g->w->links) {
+        struct rtnexthop *rtnh = (struct rtnexthop *)((char *)nlh + nlh->nlmsg_len);
+        struct rtattr *rta = RTNH_DATA(rtnh);
+
+        rtnh->rtnh_len = RTNH_LENGTH(RTA_SPACE(sizeof(gw)));
+        rtnh->rtnh_flags = 0;
+        rtnh->rtnh_hops = 0;
+        rtnh->rtnh_ifindex = link + 2;
+        rta->rta_type = RTA_GATEWAY;
+        rta->rta_len = RTA_LENGTH(sizeof(gw));
+        gw = link_peer(link);
+        memcpy(RTA_DATA(rta), &gw, sizeof(gw));
+        nlh->nlmsg_len += RTNH_ALIGN(rtnh->rtnh_len);
+    }
+    mp->rta_len = (char *)nlh + nlh->nlmsg_len - (char *)mp;
+}
+
+/* A host route over link i, announced just before the link goes down */
+static void down_route_msg(struct gen *g, uint32_t i)
+{
+    struct rtmsg rtm = {
+        .rtm_family = AF_INET,
+        .rtm_dst_len = 32,
+        .rtm_table = RT_TABLE_MAIN,
+        .rtm_protocol = RTPROT_BGP,
+        .rtm_scope = RT_SCOPE_UNIVERSE,
+        .rtm_type = RTN_UNICAST,
+    };
+    uint32_t table = RT_TABLE_MAIN, dst = htonl(DOWN_NET + i), gw = link_peer(i), oif = i + 2;
+    struct nlmsghdr *nlh;
+
+    nlh = msg_start(g, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, &rtm, sizeof(rtm));
+    put_attr(nlh, RTA_TABLE, &table, sizeof(table));
+    put_attr(nlh, RTA_DST, &dst, sizeof(dst));
+    put_attr(nlh, RTA_GATEWAY, &gw, sizeof(gw));
+    put_attr(nlh, RTA_OIF, &oif, sizeof(oif));
+}
+
+/*
+ * Unique prefixes without remembering them: the n-th prefix of a length
+ * is n run through a bijection of the length's address space. A length
+ * that is used up hands over to the next longer one.
+ */
+static void assign_prefixes(struct gen *g)
+{
+    uint32_t used[33] = { 0 }, total = 0, pick, r;
+    uint64_t net;
+    int len;
+
+    for (len = 0; len <= 32; len++)
+        total += prefix_weights[len];
+    for (r = 0; r < g->w->routes; r++) {
+        pick = rnd(g) % total;
+        for (len = 0; pick >= prefix_weights[len]; len++)
+            pick -= prefix_weights[len];
+        while (len < 32 && used[len] >= 1ULL << len)
+            len++;
+        net = ((uint64_t)used[len]++ * 2654435761u + mix(len ^ g->w->seed)) &
+              ((1ULL << len) - 1);
+        g->routes[r].dst = len ? net << (32 - len) : 0;
+        g->routes[r].len = len;
+    }
+}
+
+static int initial_dump(struct gen *g)
+{
+    struct {
+        struct nlmsghdr nlh;
+        int error;
+    } done = {
+        .nlh = {
+            .nlmsg_len = NLMSG_LENGTH(sizeof(int)),
+            .nlmsg_type = NLMSG_DONE,
+            .nlmsg_flags = NLM_F_MULTI,
+        },
+    };
+    uint32_t i;
+    int err;
+
+    for (i = 0; i < g->w->links; i++) {
+        link_msg(g, i, RTM_NEWLINK, LINK_UP);
+        err = dump(g);
+        if (err < 0)
+            return err;
+    }
+    for (i = 0; i < g->w->links; i++) {
+        addr_msg(g, i, RTM_NEWADDR);
+        err = dump(g);
+        if (err < 0)
+            return err;
+    }
+    for (i = 0; i < g->w->routes; i++) {
+        route_msg(g, i, RTM_NEWROUTE, 0);
+        err = dump(g);
+        if (err < 0)
+            return err;
+    }
+    err = dump_flush(g);
+    if (err < 0)
+        return err;
+    return deliver(g, &done, done.nlh.nlmsg_len, g->w->start_ns, 0);
+}
+
+static int announce(struct gen *g, uint32_t r, uint64_t ts)
+{
+    g->routes[r].down = 0;
+    route_msg(g, r, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL);
+    return notify(g, ts);
+}
+
+static int withdraw(struct gen *g, uint32_t r, uint64_t ts)
+{
+    g->routes[r].down = 1;
+    route_msg(g, r, RTM_DELROUTE, 0);
+    return notify(g, ts);
+}
+
+/* Everything that is announced goes away and comes back at once */
+static int reload(struct gen *g, uint64_t ts)
+{
+    uint32_t r;
+    int err;
+
+    for (r = 0; r < g->w->routes; r++) {
+        if (g->routes[r].down)
+            continue;
+        err = withdraw(g, r, ts);
+        if (err < 0)
+            return err;
+        g->routes[r].down = 2;
+    }
+    for (r = 0; r < g->w->routes; r++) {
+        if (g->routes[r].down != 2)
+            continue;
+        err = announce(g, r, ts);
+        if (err < 0)
+            return err;
+    }
+    return 0;
+}
+
+/*
+ * A route over a link and the link going down are read together, a tick
+ * each, so the route must reach the cache before the link's routes are
+ * flushed.
+ */
+static int down_links(struct gen *g, uint64_t ts)
+{
+    uint32_t i;
+    int err;
+
+    for (i = 0; i < g->w->link_downs; i++, ts += TICK_NS) {
+        down_route_msg(g, i);
+        err = notify(g, ts);
+        if (!err) {
+            link_msg(g, i, RTM_NEWLINK, LINK_DOWN);
+            err = notify(g, ts);
+        }
+        if (err < 0)
+            return err;
+    }
+    return 0;
+}
+
+/* Links go down, lose their address and are deleted, as ip link del does */
+static int delete_links(struct gen *g, uint64_t ts)
+{
+    uint32_t i, n;
+    int err;
+
+    for (n = 0; n < g->w->link_deletes; n++) {
+        i = g->w->links - 1 - n;
+        link_msg(g, i, RTM_NEWLINK, LINK_DOWN);
+        err = notify(g, ts);
+        if (!err) {
+            addr_msg(g, i, RTM_DELADDR);
+            err = notify(g, ts);
+        }
+        if (!err) {
+            link_msg(g, i, RTM_DELLINK, LINK_DOWN);
+            err = notify(g, ts);
+        }
+        if (err < 0)
+            return err;
+    }
+    return 0;
+}
+
+static int run(struct gen *g)
+{
+    const struct workload *w = g->w;
+    uint64_t start = w->start_ns + TICK_NS, dur = (uint64_t)w->duration_ms * 1000000;
+    uint64_t nflaps = (uint64_t)w->flap_rate * w->duration_ms / 1000, flaps = 0;
+    uint64_t next_flap, next_reload, next_back, ts = start;
+    uint32_t reloads = 0, r, tries;
+    struct pending *queue;
+    size_t head = 0, tail = 0;
+    int err = 0;
+
+    queue = malloc((nflaps ? nflaps : 1) * sizeof(*queue));
+    if (!queue)
+        return -ENOMEM;
+
+    for (;;) {
+        next_flap = flaps < nflaps ? start + flaps * 1000000000ULL / w->flap_rate : UINT64_MAX;
+        next_reload = reloads < w->reloads ? start + (reloads + 1) * dur / (w->reloads + 1) :
+                      UINT64_MAX;
+        next_back = head < tail ? queue[head].due : UINT64_MAX;
+        if (next_flap == UINT64_MAX && next_reload == UINT64_MAX && next_back == UINT64_MAX)
+            break;
+
+        if (next_back <= next_flap && next_back <= next_reload) {
+            ts = next_back;
+            err = announce(g, queue[head++].route, ts);
+        } else if (next_reload <= next_flap) {
+            ts = next_reload;
+            reloads++;
+            err = reload(g, ts);
+        } else {
+            ts = next_flap;
+            flaps++;
+            r = rnd(g) % w->routes;
+            for (tries = 0; tries < w->routes && g->routes[r].down; tries++)
+                r = (r + 1) % w->routes;
+            if (g->routes[r].down)
+                continue;
+            err = withdraw(g, r, ts);
+            g->routes[r].shift++;
+            queue[tail].due = ts + (uint64_t)w->flap_gap_ms * 1000000;
+            queue[tail++].route = r;
+        }
+        if (err < 0)
+            break;
+    }
+    free(queue);
+    if (err < 0)
+        return err;
+
+    if (ts < start + dur)
+        ts = start + dur;
+    err = down_links(g, ts + TICK_NS);
+    if (err < 0)
+        return err;
+    return delete_links(g, ts + (w->link_downs + 1) * TICK_NS);
+}
+
+int workload_run(const struct workload *w, workload_sink sink, void *arg,
+                 struct workload_stats *stats)
+{
+    struct gen *g;
+    int err;
+
+    if (w->routes > WORKLOAD_ROUTES_MAX || !w->links || w->links > WORKLOAD_LINKS_MAX ||
+        !w->ecmp || w->ecmp > WORKLOAD_ECMP_MAX || w->link_downs > WORKLOAD_DOWNS_MAX ||
+        w->link_downs + (uint64_t)w->link_deletes > w->links ||
+        !w->batch || (w->link_downs && w->batch < 2) || (w->flap_rate && !w->routes))
+        return -EINVAL;
+
+    g = calloc(1, sizeof(*g));
+    if (!g)
+        return -ENOMEM;
+    g->routes = calloc(w->routes ? w->routes : 1, sizeof(*g->routes));
+    if (!g->routes) {
+        free(g);
+        return -ENOMEM;
+    }
+    memset(stats, 0, sizeof(*stats));
+    g->w = w;
+    g->sink = sink;
+    g->arg = arg;
+    g->stats = stats;
+    g->ecmp = w->ecmp < w->links ? w->ecmp : w->links;
+    g->rng = w->seed;
+
+    assign_prefixes(g);
+    err = initial_dump(g);
+    if (!err)
+        err = run(g);
+
+    free(g->routes);
+    free(g);
+    return err;
+}
@@ -0,0 +1,75 @@
+/*
+ * Route monitor - synthetic rtnetlink workloads
+ * Copyright (c) 2025 Denis Kirjanov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WORKLOAD_ROUTES_MAX     (16 * 1024 * 1024)
+#define WORKLOAD_LINKS_MAX      (1024 * 1024)
+#define WORKLOAD_ECMP_MAX       64
+#define WORKLOAD_DOWNS_MAX      (128 * 1024)
+
+/*
+ * A dump of links, addresses and IPv4 routes as a router would have them,
+ * followed by notifications: route flaps at a steady rate, full table
+ * reloads spread over the run, links going down right after a route over
+ * them was announced and a bulk delete of links at the end.
+ *
+ * Link i has ifindex i + 2 and a /30 out of 100.64.0.0/10, nexthops are
+ * the far end of it. Route prefix lengths follow the shape of the IPv4
+ * default free zone. The routes announced over links going down are /32s
+ * out of 198.18.0.0/15.
+ */
+struct workload {
+    uint32_t routes;
+    uint32_t links;
+    uint32_t ecmp;              /* nexthops per route */
+    uint32_t flap_rate;         /* withdrawals per second */
+    uint32_t flap_gap_ms;       /* until a withdrawn route comes back */
+    uint32_t duration_ms;
+    uint32_t reloads;           /* withdraw and announce everything */
+    uint32_t link_downs;        /* links taken down at the end, from the first */
+    uint32_t link_deletes;      /* links removed at the end, from the last */
+    uint32_t batch;             /* most packets read at once */
+    uint64_t seed;
+    uint64_t start_ns;          /* time of the dump */
+};
+
+struct workload_stats {
+    uint64_t packets;
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t batches;
+};
+
+void workload_defaults(struct workload *w);
+
+/*
+ * Hands every packet to sink with the time it is due at and the number of
+ * the receive batch it belongs to, 0 for the dump. A negative return from
+ * sink stops the run and is returned.
+ */
+typedef int (*workload_sink)(void *arg, const void *buf, size_t len, uint64_t ts,
+                             uint64_t batch);
+
+int workload_run(const struct workload *w, workload_sink sink, void *arg,
+                 struct workload_stats *stats);
+
+#endif